@@ -54,6 +54,9 @@ function configureChannelUserDataPath() {
 
 configureChannelUserDataPath();
 
+// Lets the native paste helpers pick up user additions to their terminal registry
+process.env.OPENWHISPR_TERMINALS_FILE = path.join(app.getPath("userData"), "terminals.conf");
+
 // Fix transparent window flickering on Linux: --enable-transparent-visuals requires
 // the compositor to set up an ARGB visual before any windows are created.
 // --disable-gpu-compositing prevents GPU compositing conflicts with the compositor.
@@ -164,6 +167,7 @@ const UpdateManager = require("./src/updater");
 const GlobeKeyManager = require("./src/helpers/globeKeyManager");
 const DevServerManager = require("./src/helpers/devServerManager");
 const WindowsKeyManager = require("./src/helpers/windowsKeyManager");
+const LinuxKeyManager = require("./src/helpers/linuxKeyManager");
 const TextEditMonitor = require("./src/helpers/textEditMonitor");
 const WhisperCudaManager = require("./src/helpers/whisperCudaManager");
 const { i18nMain, changeLanguage } = require("./src/helpers/i18nMain");
@@ -181,6 +185,7 @@ let trayManager = null;
 let updateManager = null;
 let globeKeyManager = null;
 let windowsKeyManager = null;
+let linuxKeyManager = null;
 let textEditMonitor = null;
 let whisperCudaManager = null;
 let ipcHandlers = null;
@@ -248,6 +253,8 @@ function initializeCoreManagers() {
   parakeetManager = new ParakeetManager();
   updateManager = new UpdateManager();
   windowsKeyManager = new WindowsKeyManager();
+  linuxKeyManager = new LinuxKeyManager();
+  windowManager.linuxKeyManager = linuxKeyManager;
   textEditMonitor = new TextEditMonitor();
   windowManager.textEditMonitor = textEditMonitor;
 
@@ -261,6 +268,7 @@ function initializeCoreManagers() {
     windowManager,
     updateManager,
     windowsKeyManager,
+    linuxKeyManager,
     textEditMonitor,
     whisperCudaManager,
     getTrayManager: () => trayManager,
@@ -696,29 +704,32 @@ async function startApp() {
     });
   }
 
-  // Set up Windows Push-to-Talk handling
-  if (process.platform === "win32") {
-    debugLogger.debug("[Push-to-Talk] Windows Push-to-Talk setup starting");
+  // Whether the Windows/Linux native key listener must run for this hotkey and mode:
+  // push-to-talk needs key-up events, and right-side or modifier-only hotkeys
+  // cannot be registered as global shortcuts
+  const { isModifierOnlyHotkey } = require("./src/helpers/hotkeyManager");
 
-    const isValidHotkey = (hotkey) => hotkey && hotkey !== "GLOBE";
+  const isValidHotkey = (hotkey) => hotkey && hotkey !== "GLOBE";
 
-    const isRightSideMod = (hotkey) =>
-      /^Right(Control|Ctrl|Alt|Option|Shift|Super|Win|Meta|Command|Cmd)$/i.test(hotkey);
+  const isRightSideMod = (hotkey) =>
+    /^Right(Control|Ctrl|Alt|Option|Shift|Super|Win|Meta|Command|Cmd)$/i.test(hotkey);
 
-    const { isModifierOnlyHotkey } = require("./src/helpers/hotkeyManager");
+  const needsNativeListener = (hotkey, mode) => {
+    if (!isValidHotkey(hotkey)) return false;
+    if (mode === "push") return true;
+    return isRightSideMod(hotkey) || isModifierOnlyHotkey(hotkey);
+  };
 
-    const needsNativeListener = (hotkey, mode) => {
-      if (!isValidHotkey(hotkey)) return false;
-      if (mode === "push") return true;
-      return isRightSideMod(hotkey) || isModifierOnlyHotkey(hotkey);
-    };
+  // Set up Windows Push-to-Talk handling
+  if (process.platform === "win32") {
+    debugLogger.debug("[Push-to-Talk] Windows Push-to-Talk setup starting");
 
     windowsKeyManager.on("key-down", (_key) => {
       if (!isLiveWindow(windowManager.mainWindow)) return;
 
       const activationMode = windowManager.getActivationMode();
       if (activationMode === "push") {
-        windowManager.startWindowsPushToTalk();
+        windowManager.startNativePushToTalk();
       } else if (activationMode === "tap") {
         windowManager.showDictationPanel();
         windowManager.mainWindow.webContents.send("toggle-dictation");
@@ -730,7 +741,7 @@ async function startApp() {
 
       const activationMode = windowManager.getActivationMode();
       if (activationMode === "push") {
-        windowManager.handleWindowsPushKeyUp();
+        windowManager.handleNativePushKeyUp();
       }
     });
 
@@ -774,7 +785,7 @@ async function startApp() {
     setTimeout(startWindowsKeyListener, STARTUP_DELAY_MS);
 
     ipcMain.on("activation-mode-changed", (_event, mode) => {
-      windowManager.resetWindowsPushState();
+      windowManager.resetNativePushState();
       const currentHotkey = hotkeyManager.getCurrentHotkey();
       if (needsNativeListener(currentHotkey, mode)) {
         windowsKeyManager.start(currentHotkey);
@@ -785,7 +796,7 @@ async function startApp() {
 
     ipcMain.on("hotkey-changed", (_event, hotkey) => {
       if (!isLiveWindow(windowManager.mainWindow)) return;
-      windowManager.resetWindowsPushState();
+      windowManager.resetNativePushState();
       const activationMode = windowManager.getActivationMode();
       windowsKeyManager.stop();
       if (needsNativeListener(hotkey, activationMode)) {
@@ -793,6 +804,71 @@ async function startApp() {
       }
     });
   }
+
+  // Set up Linux Push-to-Talk handling (XInput2 on X11, evdev on Wayland, see LinuxKeyManager)
+  if (process.platform === "linux" && linuxKeyManager.isSupported) {
+    debugLogger.debug("[Push-to-Talk] Linux Push-to-Talk setup starting");
+
+    linuxKeyManager.on("key-down", () => {
+      if (!isLiveWindow(windowManager.mainWindow)) return;
+
+      const activationMode = windowManager.getActivationMode();
+      if (activationMode === "push") {
+        windowManager.startNativePushToTalk();
+      } else if (activationMode === "tap") {
+        if (textEditMonitor) textEditMonitor.captureTargetPid();
+        windowManager.showDictationPanel();
+        windowManager.mainWindow.webContents.send("toggle-dictation");
+      }
+    });
+
+    linuxKeyManager.on("key-up", () => {
+      if (!isLiveWindow(windowManager.mainWindow)) return;
+      if (windowManager.getActivationMode() === "push") {
+        windowManager.handleNativePushKeyUp();
+      }
+    });
+
+    linuxKeyManager.on("error", (error) => {
+      debugLogger.warn("[Push-to-Talk] Linux key listener error", { error: error.message });
+    });
+
+    linuxKeyManager.on("unavailable", () => {
+      debugLogger.debug(
+        "[Push-to-Talk] Linux key listener not available - falling back to toggle mode"
+      );
+    });
+
+    const startLinuxKeyListener = () => {
+      if (!isLiveWindow(windowManager.mainWindow)) return;
+      const currentHotkey = hotkeyManager.getCurrentHotkey();
+      if (needsNativeListener(currentHotkey, windowManager.getActivationMode())) {
+        linuxKeyManager.start(currentHotkey);
+      }
+    };
+
+    const STARTUP_DELAY_MS = 3000;
+    setTimeout(startLinuxKeyListener, STARTUP_DELAY_MS);
+
+    ipcMain.on("activation-mode-changed", (_event, mode) => {
+      windowManager.resetNativePushState();
+      const currentHotkey = hotkeyManager.getCurrentHotkey();
+      if (needsNativeListener(currentHotkey, mode)) {
+        linuxKeyManager.start(currentHotkey);
+      } else {
+        linuxKeyManager.stop();
+      }
+    });
+
+    ipcMain.on("hotkey-changed", (_event, hotkey) => {
+      if (!isLiveWindow(windowManager.mainWindow)) return;
+      windowManager.resetNativePushState();
+      linuxKeyManager.stop();
+      if (needsNativeListener(hotkey, windowManager.getActivationMode())) {
+        linuxKeyManager.start(hotkey);
+      }
+    });
+  }
 }
 
 // Listen for usage limit reached from dictation overlay, forward to control panel
@@ -925,12 +1001,18 @@ if (gotSingleInstanceLock) {
     if (windowsKeyManager) {
       windowsKeyManager.stop();
     }
+    if (linuxKeyManager) {
+      linuxKeyManager.stop();
+    }
     if (ipcHandlers) {
       ipcHandlers._cleanupTextEditMonitor();
     }
     if (textEditMonitor) {
       textEditMonitor.stopMonitoring();
     }
+    if (clipboardManager) {
+      clipboardManager.stopLinuxFastPasteServer();
+    }
     if (updateManager) {
       updateManager.cleanup();
     }
@@ -0,0 +1,381 @@
+/**
+ * Output writer and base64 shared by the native helpers
+ *
+ * linux-text-monitor and windows-text-monitor speak the same stdout protocol:
+ * "<TYPE>:<text>" lines, "<TYPE>_B64:<base64>" for values holding a newline,
+ * and with --framing=binary "<TYPE> <length>\n" headers followed by raw bytes
+ * (see the monitors' headers). HelperOutput produces all of it, so the
+ * protocol lives in one place. Other helpers use the buffer and base64 on
+ * their own, e.g. linux-fast-paste for its READ replies.
+ *
+ * Each message is assembled in a growable OutputBuffer that is reused for
+ * the life of the process, base64 included, and handed to stdio in one
+ * fwrite. In interactive mode, the default since OpenWhispr reads the pipe as
+ * the helper runs, every message is flushed once it is complete. When stdout
+ * is a regular file (output captured for a bench or a bug report) messages
+ * are only written once HELPER_OUTPUT_FLUSH_BYTES have piled up or on
+ * helper_output_flush().
+ *
+ * Base64 uses the SSE4.1 or AVX2 encoder when the CPU has it, picked on first
+ * use, and a scalar loop otherwise and for the last few bytes. The vector
+ * encoders follow Wojciech Mula's "Base64 encoding with SIMD instructions".
+ *
+ * Header only, like terminal-registry.h: include it and build as before.
+ */
+
+#ifndef OPENWHISPR_HELPER_OUTPUT_H
+#define OPENWHISPR_HELPER_OUTPUT_H
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define HELPER_OUTPUT_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define HELPER_OUTPUT_TARGET(isa)
+#else
+#define HELPER_OUTPUT_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+#ifdef _WIN32
+#include <io.h>
+#endif
+
+#define HELPER_OUTPUT_FLUSH_BYTES 65536
+
+/* ---- Growable buffer ---- */
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} OutputBuffer;
+
+/* Makes room for extra more bytes plus a terminating NUL */
+static inline int output_buffer_reserve(OutputBuffer *b, size_t extra) {
+    if (b->len + extra + 1 <= b->cap) return 0;
+    size_t cap = b->cap ? b->cap : 256;
+    while (cap < b->len + extra + 1) cap *= 2;
+    char *data = (char *)realloc(b->data, cap);
+    if (!data) return -1;
+    b->data = data;
+    b->cap = cap;
+    return 0;
+}
+
+static inline int output_buffer_append(OutputBuffer *b, const void *data, size_t len) {
+    if (output_buffer_reserve(b, len) != 0) return -1;
+    if (len) memcpy(b->data + b->len, data, len);
+    b->len += len;
+    b->data[b->len] = '\0';
+    return 0;
+}
+
+static inline int output_buffer_printf(OutputBuffer *b, const char *format, ...) {
+    char small[128];
+    va_list args;
+    va_start(args, format);
+    int needed = vsnprintf(small, sizeof(small), format, args);
+    va_end(args);
+    if (needed < 0) return -1;
+    if ((size_t)needed < sizeof(small)) return output_buffer_append(b, small, (size_t)needed);
+
+    if (output_buffer_reserve(b, (size_t)needed) != 0) return -1;
+    va_start(args, format);
+    vsnprintf(b->data + b->len, (size_t)needed + 1, format, args);
+    va_end(args);
+    b->len += (size_t)needed;
+    return 0;
+}
+
+static inline void output_buffer_free(OutputBuffer *b) {
+    free(b->data);
+    b->data = NULL;
+    b->len = b->cap = 0;
+}
+
+/* ---- Base64 ---- */
+
+static const char BASE64_TABLE[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* Encodes a whole input, padding included; returns the characters written */
+static inline size_t base64_encode_scalar(char *out, const unsigned char *data, size_t len) {
+    size_t j = 0;
+    size_t i = 0;
+    for (; i + 3 <= len; i += 3) {
+        unsigned int triple = ((unsigned int)data[i] << 16) | ((unsigned int)data[i + 1] << 8) |
+                              data[i + 2];
+        out[j++] = BASE64_TABLE[(triple >> 18) & 0x3F];
+        out[j++] = BASE64_TABLE[(triple >> 12) & 0x3F];
+        out[j++] = BASE64_TABLE[(triple >> 6) & 0x3F];
+        out[j++] = BASE64_TABLE[triple & 0x3F];
+    }
+    if (i < len) {
+        unsigned int triple = (unsigned int)data[i] << 16;
+        if (i + 1 < len) triple |= (unsigned int)data[i + 1] << 8;
+        out[j++] = BASE64_TABLE[(triple >> 18) & 0x3F];
+        out[j++] = BASE64_TABLE[(triple >> 12) & 0x3F];
+        out[j++] = i + 1 < len ? BASE64_TABLE[(triple >> 6) & 0x3F] : '=';
+        out[j++] = '=';
+    }
+    return j;
+}
+
+/*
+ * A vector encoder handles whole 12- or 24-byte groups while it can load a
+ * full register, and returns the input bytes consumed; the scalar loop
+ * finishes the rest.
+ */
+typedef size_t (*Base64BulkEncoder)(char *out, const unsigned char *data, size_t len);
+
+#ifdef HELPER_OUTPUT_X86
+
+/*
+ * Spreads each 3 input bytes of a lane over 4 bytes, isolates the four 6-bit
+ * indices with one multiply-high and one multiply-low, then maps them to
+ * ASCII by adding a per-range offset looked up with a byte shuffle.
+ */
+HELPER_OUTPUT_TARGET("sse4.1")
+static inline size_t base64_bulk_sse41(char *out, const unsigned char *data, size_t len) {
+    const __m128i spread = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    size_t done = 0;
+    while (len - done >= 16) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(data + done));
+        in = _mm_shuffle_epi8(in, spread);
+        __m128i hi = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)),
+                                     _mm_set1_epi32(0x04000040));
+        __m128i lo = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)),
+                                     _mm_set1_epi32(0x01000010));
+        __m128i indices = _mm_or_si128(hi, lo);
+
+        __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+        range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+        __m128i ascii = _mm_add_epi8(_mm_shuffle_epi8(offsets, range), indices);
+
+        _mm_storeu_si128((__m128i *)out, ascii);
+        out += 16;
+        done += 12;
+    }
+    return done;
+}
+
+/* The same per 128-bit lane, with the two lanes loaded 12 bytes apart */
+HELPER_OUTPUT_TARGET("avx2")
+static inline size_t base64_bulk_avx2(char *out, const unsigned char *data, size_t len) {
+    const __m256i spread = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                            1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i offsets = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0, 'a' - 26, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0);
+    size_t done = 0;
+    while (len - done >= 28) {
+        __m256i in = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(data + done))),
+            _mm_loadu_si128((const __m128i *)(data + done + 12)), 1);
+        in = _mm256_shuffle_epi8(in, spread);
+        __m256i hi = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)),
+                                        _mm256_set1_epi32(0x04000040));
+        __m256i lo = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)),
+                                        _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(hi, lo);
+
+        __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        range = _mm256_or_si256(range, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+        __m256i ascii = _mm256_add_epi8(_mm256_shuffle_epi8(offsets, range), indices);
+
+        _mm256_storeu_si256((__m256i *)out, ascii);
+        out += 32;
+        done += 24;
+    }
+    return done;
+}
+
+static inline int base64_cpu_has_avx2(void) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return 0;
+    __cpuid(info, 1);
+    int osxsave_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28));
+    if (!osxsave_avx || (_xgetbv(0) & 6) != 6) return 0;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static inline int base64_cpu_has_sse41(void) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 19)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+#endif /* HELPER_OUTPUT_X86 */
+
+static inline size_t base64_bulk_none(char *out, const unsigned char *data, size_t len) {
+    (void)out;
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+static Base64BulkEncoder base64_bulk;
+static const char *base64_bulk_name;
+
+static inline void base64_select_encoder(void) {
+    base64_bulk = base64_bulk_none;
+    base64_bulk_name = "scalar";
+#ifdef HELPER_OUTPUT_X86
+    if (base64_cpu_has_avx2()) {
+        base64_bulk = base64_bulk_avx2;
+        base64_bulk_name = "avx2";
+    } else if (base64_cpu_has_sse41()) {
+        base64_bulk = base64_bulk_sse41;
+        base64_bulk_name = "sse4.1";
+    }
+#endif
+}
+
+/* Appends the base64 of data to b */
+static inline int base64_append(OutputBuffer *b, const unsigned char *data, size_t len) {
+    if (!base64_bulk) base64_select_encoder();
+    if (output_buffer_reserve(b, 4 * ((len + 2) / 3)) != 0) return -1;
+
+    char *out = b->data + b->len;
+    size_t done = base64_bulk(out, data, len);
+    size_t written = done / 3 * 4;
+    written += base64_encode_scalar(out + written, data + done, len - done);
+    b->len += written;
+    b->data[b->len] = '\0';
+    return 0;
+}
+
+/* ---- Protocol writer ---- */
+
+typedef struct {
+    FILE *stream;
+    int binary_framing;  /* --framing=binary */
+    int interactive;     /* flush after every message */
+    OutputBuffer pending;
+} HelperOutput;
+
+static inline int helper_output_is_regular_file(FILE *stream) {
+#ifdef _WIN32
+    struct _stat st;
+    return _fstat(_fileno(stream), &st) == 0 && (st.st_mode & _S_IFREG);
+#else
+    struct stat st;
+    return fstat(fileno(stream), &st) == 0 && S_ISREG(st.st_mode);
+#endif
+}
+
+static inline void helper_output_flush(HelperOutput *out) {
+    if (out->pending.len) {
+        fwrite(out->pending.data, 1, out->pending.len, out->stream);
+        out->pending.len = 0;
+    }
+    fflush(out->stream);
+}
+
+/* Ends a message: written now when interactive, else once enough piled up */
+static inline void helper_output_end_message(HelperOutput *out) {
+    if (out->interactive || out->pending.len >= HELPER_OUTPUT_FLUSH_BYTES) {
+        helper_output_flush(out);
+    }
+}
+
+/* Sets the writer up on stream and announces binary framing if asked to */
+static inline void helper_output_init(HelperOutput *out, FILE *stream, int binary_framing) {
+    memset(out, 0, sizeof(*out));
+    out->stream = stream;
+    out->binary_framing = binary_framing;
+    out->interactive = !helper_output_is_regular_file(stream);
+    if (binary_framing) {
+        output_buffer_append(&out->pending, "FRAMING binary 1\n", 17);
+        helper_output_end_message(out);
+    }
+}
+
+static inline void helper_output_close(HelperOutput *out) {
+    helper_output_flush(out);
+    output_buffer_free(&out->pending);
+}
+
+/*
+ * One --framing=binary message: "<tag><type> <length>\n", then prefix and
+ * payload as is. tag is "" or "<id> ".
+ */
+static inline void helper_output_frame(HelperOutput *out, const char *tag, const char *type,
+                                const char *prefix, const char *payload, size_t len) {
+    size_t prefix_len = prefix ? strlen(prefix) : 0;
+    output_buffer_printf(&out->pending, "%s%s %lu\n", tag, type,
+                         (unsigned long)(prefix_len + len));
+    output_buffer_append(&out->pending, prefix, prefix_len);
+    output_buffer_append(&out->pending, payload, len);
+    helper_output_end_message(out);
+}
+
+/* A message without a value: NO_ELEMENT, NO_VALUE, READY */
+static inline void helper_output_status(HelperOutput *out, const char *tag, const char *status) {
+    if (out->binary_framing) {
+        helper_output_frame(out, tag, status, NULL, NULL, 0);
+        return;
+    }
+    output_buffer_printf(&out->pending, "%s%s\n", tag, status);
+    helper_output_end_message(out);
+}
+
+/* A text value, as "<name>:<text>", "<name>_B64:<base64>" or a frame */
+static inline void helper_output_value(HelperOutput *out, const char *tag, const char *name,
+                                const char *value, size_t len) {
+    if (out->binary_framing) {
+        helper_output_frame(out, tag, name, NULL, value, len);
+        return;
+    }
+
+    if (memchr(value, '\n', len) || memchr(value, '\r', len)) {
+        output_buffer_printf(&out->pending, "%s%s_B64:", tag, name);
+        base64_append(&out->pending, (const unsigned char *)value, len);
+    } else {
+        output_buffer_printf(&out->pending, "%s%s:", tag, name);
+        output_buffer_append(&out->pending, value, len);
+    }
+    output_buffer_append(&out->pending, "\n", 1);
+    helper_output_end_message(out);
+}
+
+/* An edit: replace deleted UTF-16 units at offset with inserted */
+static inline void helper_output_delta(HelperOutput *out, const char *tag, size_t offset,
+                                size_t deleted, const char *inserted, size_t len) {
+    char edit[48];
+    snprintf(edit, sizeof(edit), "%lu:%lu:", (unsigned long)offset, (unsigned long)deleted);
+    if (out->binary_framing) {
+        helper_output_frame(out, tag, "DELTA", edit, inserted, len);
+        return;
+    }
+
+    output_buffer_printf(&out->pending, "%sDELTA:%s", tag, edit);
+    base64_append(&out->pending, (const unsigned char *)inserted, len);
+    output_buffer_append(&out->pending, "\n", 1);
+    helper_output_end_message(out);
+}
+
+#endif
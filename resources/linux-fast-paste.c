@@ -1,3 +1,133 @@
+/**
+ * Linux Fast Paste for OpenWhispr
+ *
+ * Simulates the paste keystroke (Ctrl+V, or Ctrl+Shift+V for terminal
+ * emulators) using XTest on X11/XWayland, a Wayland virtual keyboard, or a
+ * uinput virtual keyboard.
+ *
+ * Usage:
+ *   linux-fast-paste [--window <id>] [--activate-timeout <ms>] [--terminal]
+ *                    [--uinput | --wayland]
+ *                    [--key-delay <ms>] [--settle <ms>] [--timing] [--trace]
+ *                    [--clipboard-stdin [--clipboard-timeout <ms>]]
+ *   linux-fast-paste --type [--window <id>] [--uinput | --wayland]
+ *                    [--key-delay <ms>] [--trace]   < text
+ *   linux-fast-paste --serve
+ *   linux-fast-paste --probe
+ *   linux-fast-paste --query-active
+ *
+ * --window activates the target window first and waits for the WM to confirm
+ * focus (FocusIn or _NET_ACTIVE_WINDOW), up to --activate-timeout (default
+ * 150 ms). The measured activation time is reported on stderr.
+ *
+ * Whether the target is a terminal comes from the shared registry in
+ * terminal-registry.h (WM_CLASS and executable name, plus the user's
+ * terminals.conf). Serve mode caches the verdict per window until the
+ * window is destroyed or its WM_CLASS changes.
+ *
+ * XTest key timing comes from a per-WM_CLASS settle profile (see
+ * settle_profiles); --key-delay and --settle override it and --timing prints
+ * a per-phase report on stderr.
+ *
+ * --trace prints one line of JSON on stderr after the paste, "trace {...}",
+ * with CLOCK_MONOTONIC timestamps in microseconds since t0_us (process start
+ * in one-shot mode, command receipt in serve mode) for each phase that ran:
+ * display_open, extension_query, device_ready (uinput/Wayland keyboard),
+ * activate, key_down (first press issued), key_up (last release issued),
+ * flush (events processed by the server or compositor) and teardown.
+ * t0_us is absolute so the caller can also measure process startup.
+ *
+ * --clipboard-stdin (XTest only) reads the text to paste from stdin and makes
+ * the helper the CLIPBOARD owner itself: it answers SelectionRequest for
+ * TARGETS/UTF8_STRING/STRING/TEXT, sends the keystroke, and releases the
+ * selection once the target has fetched the text (or after
+ * --clipboard-timeout, default 1000 ms). No clipboard tool is involved.
+ * The outcome is printed on stdout as "CONSUMED <ms>" (ms from keystroke to
+ * the first text transfer) or "TIMEOUT", so the caller can restore the
+ * previous clipboard right away instead of after a fixed delay.
+ *
+ * --type types the UTF-8 text read from stdin instead of pasting, so the
+ * clipboard is never touched. Newline and tab become Return and Tab; other
+ * control characters are dropped.
+ *  - XTest types keysyms the current layout has directly. Anything else is
+ *    bound to spare (unmapped) keycodes with XChangeKeyboardMapping for the
+ *    whole request, and the keycodes are unmapped again once clients have
+ *    had time to handle the last key. If the text needs more keysyms than
+ *    there are spare keycodes nothing is typed and the exit code is 10.
+ *  - uinput looks every keysym up in the X (or XWayland) keymap and types the
+ *    matching evdev code; if a character is not on the layout nothing is
+ *    typed and the exit code is 10, so the caller can paste instead.
+ *  - Wayland uploads a generated keymap holding exactly the keysyms needed,
+ *    types them, and restores the paste keymap before the next paste.
+ *
+ * --wayland talks zwp_virtual_keyboard_manager_v1 to the compositor directly
+ * (wlroots-based compositors such as sway, Hyprland and labwc). A minimal
+ * keymap is uploaded once, and each phase of the keystroke waits for a
+ * compositor roundtrip instead of sleeping. A headless sway
+ * (WLR_BACKENDS=headless sway) is enough to try it locally.
+ *
+ * --probe prints one line of JSON describing what the paste strategy depends
+ * on: session and compositor identity, XTest, uinput writability, the
+ * Wayland protocols on offer, which fallback tools are on PATH, whether
+ * ydotoold answers on its socket, and the active X11 window. cache.ttl_ms
+ * and cache.env tell the caller how long the result stays valid.
+ *
+ * --query-active prints the active X11 window as one line of JSON: id,
+ * WM_CLASS, _NET_WM_PID, executable name and whether it is a terminal, or
+ * null when there is none (e.g. a native Wayland window).
+ *
+ * When the server exits while it still owns the Wayland clipboard, a forked
+ * child keeps serving it until another client replaces the selection.
+ *
+ * Exit codes (one-shot mode):
+ *   1 - Cannot open X display
+ *   2 - XTest extension not available
+ *   3 - uinput unavailable (not compiled in, or /dev/uinput not openable)
+ *   4 - uinput device setup failed
+ *   5 - Could not take CLIPBOARD ownership
+ *   6 - Clipboard text exceeds the X request size (needs INCR)
+ *   7 - Wayland unavailable (not compiled in, or no compositor connection)
+ *   8 - Compositor does not offer (or refused) the virtual keyboard protocol
+ *   9 - Compositor does not offer wlr-data-control (serve mode COPY/READ)
+ *  10 - Text cannot be typed (not on the layout, or too few spare keycodes to bind)
+ *  11 - An earlier REVISE failed partway; its stream must restart with --begin
+ *
+ * Serve mode keeps the process resident so repeated pastes skip process
+ * startup, XOpenDisplay, the XTest query and keycode lookups, and the uinput
+ * virtual keyboard stays registered between pastes. Commands are
+ * read from stdin one per line; each takes the same flags as one-shot mode:
+ *
+ * Protocol (stdin):
+ *   PASTE [--window <id>] [--terminal] [--uinput | --wayland]
+ *   PASTE --clipboard-bytes <n> [flags]\n<n bytes of UTF-8 text>
+ *   TYPE --text-bytes <n> [flags]\n<n bytes of UTF-8 text>
+ *                         - Same as one-shot --type
+ *   REVISE [--begin] --text-bytes <n> [flags]\n<n bytes of UTF-8 text>
+ *                         - Edit the text earlier REVISEs typed into this
+ *                           text: BackSpace past the common prefix, then
+ *                           type the rest. --begin starts a new stream
+ *                           (and is required after a REVISE failed partway)
+ *   PREPARE [--uinput | --wayland] - Open the backend ahead of the first paste
+ *   COPY --clipboard-bytes <n>\n<n bytes of UTF-8 text>
+ *                         - Set the Wayland clipboard via wlr-data-control and
+ *                           serve it from this process until replaced
+ *   READ                  - Read the current Wayland clipboard as text
+ *   PROBE                 - Same JSON line as --probe
+ *   QUERY                 - Same JSON line as --query-active
+ *   PING
+ *   QUIT
+ *
+ * Protocol (stdout):
+ *   READY                 - Server is accepting commands
+ *   OK                    - Paste or text sent (or backend prepared)
+ *   CONSUMED <ms>         - Clipboard paste sent and the text was fetched
+ *   TIMEOUT               - Clipboard paste sent but nothing fetched the text
+ *   DATA <base64>         - Reply to READ
+ *   EMPTY                 - Reply to READ when the clipboard holds no text
+ *   ERR <code> <message>  - Paste failed (code matches the exit codes above)
+ *   PONG                  - Reply to PING
+ */
+
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,29 +138,252 @@
 #include <X11/Xutil.h>
 #include <X11/extensions/XTest.h>
 #include <X11/keysym.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 
 #ifdef HAVE_UINPUT
 #include <linux/uinput.h>
 #include <linux/input.h>
-#include <fcntl.h>
-#include <errno.h>
+#include <dirent.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef HAVE_WAYLAND
+#include <dirent.h>
+#include <linux/input-event-codes.h>
+#include <sys/mman.h>
+#include <wayland-client.h>
+#include <signal.h>
+#include "virtual-keyboard-unstable-v1-client-protocol.h"
+#include "wlr-data-control-unstable-v1-client-protocol.h"
 #endif
 
-static const char *terminal_classes[] = {
-    "konsole", "gnome-terminal", "terminal", "kitty", "alacritty",
-    "terminator", "xterm", "urxvt", "rxvt", "tilix", "terminology",
-    "wezterm", "foot", "st", "yakuake", "ghostty", "guake", "tilda",
-    "hyper", "tabby", "sakura", "warp", "termius", NULL
+#include "terminal-registry.h"
+#include "helper-output.h"
+
+#define MAX_COMMAND_ARGS 16
+#define UINPUT_READY_TIMEOUT_MS 50
+#define ACTIVATE_TIMEOUT_MS 150
+#define CLIPBOARD_TIMEOUT_MS 1000
+#define CLIPBOARD_LINGER_MS 50
+#define CLIPBOARD_READ_TIMEOUT_MS 500
+#define PROBE_CACHE_TTL_MS 30000
+#define UINPUT_TYPE_KEY_DELAY_MS 1
+#define XTEST_UNBIND_DELAY_MS 100
+#define WAYLAND_TYPE_KEYS_MAX 240
+
+#define WINDOW_VERDICT_CACHE_SIZE 32
+#define WINDOW_VERDICT_EVENTS (StructureNotifyMask | PropertyChangeMask)
+
+typedef struct {
+    Window target_window;
+    int activate_timeout_ms;
+    int key_delay_ms;   /* -1: use the settle profile */
+    int settle_ms;      /* -1: use the settle profile */
+    int force_terminal;
+    int use_uinput;
+    int use_wayland;
+    int timing;
+    int trace;
+    struct timespec started;    /* trace t0: process start or command receipt */
+    int clipboard_stdin;        /* one-shot: read the clipboard text from stdin */
+    long clipboard_bytes;       /* serve: length of the text following the command line */
+    int clipboard_timeout_ms;
+    const char *clipboard_data; /* when set, served as CLIPBOARD for this paste */
+    size_t clipboard_len;
+    int type_stdin;             /* one-shot: read text to type from stdin */
+    long text_bytes;            /* serve TYPE: length of the text following the command line */
+    const char *text;           /* when set, typed instead of pasted */
+    size_t text_len;
+    int revise_begin;           /* REVISE: forget what earlier revisions typed */
+} PasteRequest;
+
+/*
+ * Per-application injection timing, matched against WM_CLASS. Most X clients
+ * read the modifier state from the key event itself and need no gaps at all;
+ * these apps sample modifiers or the clipboard asynchronously and miss a
+ * paste whose events arrive in the same burst.
+ */
+typedef struct {
+    const char *wm_class;
+    int key_delay_ms;   /* server-side delay before the V press and release */
+    int settle_ms;      /* time to keep the app undisturbed after the paste */
+} SettleProfile;
+
+static const SettleProfile settle_profiles[] = {
+    { "jetbrains-",  10, 20 },
+    { "libreoffice", 10, 20 },
+    { "soffice",     10, 20 },
+    { "wine",        15, 30 },
+    { ".exe",        15, 30 },
+    { NULL, 0, 0 }
 };
 
-static int is_terminal(const char *wm_class) {
-    if (!wm_class) return 0;
-    for (int i = 0; terminal_classes[i]; i++) {
-        if (strcasestr(wm_class, terminal_classes[i]))
-            return 1;
+static const SettleProfile default_settle_profile = { "default", 0, 0 };
+
+/* Outcome of a paste that served CLIPBOARD itself */
+typedef struct {
+    int served_clipboard;
+    long consumed_ms;   /* keystroke to first text transfer; -1 if never fetched */
+} PasteResult;
+
+/*
+ * Terminal verdict and settle profile of a window. Serve mode caches them per
+ * window id and selects StructureNotify/PropertyChange on the window, so the
+ * entry is dropped on DestroyNotify or when WM_CLASS changes.
+ */
+typedef struct {
+    Window window;
+    int terminal;
+    const SettleProfile *profile;
+} WindowVerdict;
+
+/* X connection and keycodes, resolved once and reused across pastes in serve mode */
+typedef struct {
+    Display *dpy;
+    KeyCode ctrl;
+    KeyCode shift;
+    KeyCode v;
+    Window selection_window;    /* hidden window that owns CLIPBOARD while serving it */
+    Atom clipboard;
+    Atom targets;
+    Atom utf8_string;
+    Atom text;
+    Atom timestamp;
+    WindowVerdict verdicts[WINDOW_VERDICT_CACHE_SIZE];
+    int next_verdict;           /* round-robin eviction slot */
+} XPaster;
+
+/* Virtual keyboard kept registered across pastes in serve mode */
+typedef struct {
+    int fd;
+} UinputKeyboard;
+
+#ifdef HAVE_WAYLAND
+/* Selection data a reader's pipe had no room for yet; flushed from the event loop */
+typedef struct PendingSend {
+    int fd;
+    char *data;
+    size_t len;
+    size_t off;
+    struct PendingSend *next;
+} PendingSend;
+
+/* Compositor connection, virtual keyboard and data-control device, kept in serve mode */
+typedef struct {
+    struct wl_display *display;
+    struct wl_registry *registry;
+    struct wl_seat *seat;
+    struct zwp_virtual_keyboard_manager_v1 *keyboard_manager;
+    struct zwp_virtual_keyboard_v1 *keyboard;
+    struct zwlr_data_control_manager_v1 *data_control_manager;
+    struct zwlr_data_control_device_v1 *data_device;
+    struct zwlr_data_control_source_v1 *source;           /* our selection, while we own it */
+    struct zwlr_data_control_offer_v1 *selection_offer;   /* current selection, if any */
+    PendingSend *sends;
+    int typing_keymap;  /* --type replaced the paste keymap; re-upload it before a paste */
+} WaylandSession;
+#endif
+
+/* Text the REVISE commands of the current stream have typed so far */
+typedef struct {
+    char *text;
+    size_t len;
+    int desynced;  /* a revision failed after typing part of its edit; text is unknown */
+} RevisionState;
+
+typedef struct {
+    XPaster x;
+    UinputKeyboard uinput;
+#ifdef HAVE_WAYLAND
+    WaylandSession wayland;
+#endif
+    RevisionState revision;
+    OutputBuffer reply;  /* READ replies, reused between commands */
+} PasteContext;
+
+static long elapsed_ms_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 +
+           (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+static long elapsed_us_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000 +
+           (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+/* --trace phases, in the order a cold paste passes through them */
+typedef enum {
+    TRACE_DISPLAY_OPEN,
+    TRACE_EXTENSION_QUERY,
+    TRACE_DEVICE_READY,
+    TRACE_ACTIVATE,
+    TRACE_KEY_DOWN,
+    TRACE_KEY_UP,
+    TRACE_FLUSH,
+    TRACE_TEARDOWN,
+    TRACE_PHASE_COUNT
+} TracePhase;
+
+static const char *const trace_phase_names[TRACE_PHASE_COUNT] = {
+    "display_open", "extension_query", "device_ready", "activate",
+    "key_down", "key_up", "flush", "teardown",
+};
+
+/* Phases are marked deep inside the backends, so the trace of the paste in
+   flight is kept globally rather than threaded through every call */
+typedef struct {
+    int enabled;
+    const char *backend;
+    struct timespec t0;
+    long phase_us[TRACE_PHASE_COUNT];   /* -1: phase did not run */
+} PasteTrace;
+
+static PasteTrace paste_trace;
+
+static void trace_begin(const PasteRequest *req, const char *backend) {
+    paste_trace.enabled = req->trace;
+    paste_trace.backend = backend;
+    paste_trace.t0 = req->started;
+    for (int i = 0; i < TRACE_PHASE_COUNT; i++) paste_trace.phase_us[i] = -1;
+}
+
+static void trace_mark(TracePhase phase) {
+    if (paste_trace.enabled) paste_trace.phase_us[phase] = elapsed_us_since(&paste_trace.t0);
+}
+
+/* Prints the trace line for the paste just finished and disarms tracing */
+static void trace_report(int rc) {
+    if (!paste_trace.enabled) return;
+    paste_trace.enabled = 0;
+
+    long long t0_us = (long long)paste_trace.t0.tv_sec * 1000000 + paste_trace.t0.tv_nsec / 1000;
+    fprintf(stderr, "trace {\"backend\":\"%s\",\"rc\":%d,\"t0_us\":%lld", paste_trace.backend, rc,
+            t0_us);
+    for (int i = 0; i < TRACE_PHASE_COUNT; i++) {
+        if (paste_trace.phase_us[i] >= 0)
+            fprintf(stderr, ",\"%s\":%ld", trace_phase_names[i], paste_trace.phase_us[i]);
     }
-    return 0;
+    fprintf(stderr, ",\"total\":%ld}\n", elapsed_us_since(&paste_trace.t0));
+}
+
+/* Compiled from terminal_registry and the user's terminals.conf in main */
+static TerminalMatcher terminal_matcher;
+
+static int is_terminal_window(const char *res_class, const char *res_name, const char *exe) {
+    return terminal_matcher_match(&terminal_matcher, TERMINAL_MATCH_CLASS, res_class) ||
+           terminal_matcher_match(&terminal_matcher, TERMINAL_MATCH_CLASS, res_name) ||
+           terminal_matcher_match(&terminal_matcher, TERMINAL_MATCH_EXE, exe);
 }
 
 static Window get_active_window(Display *dpy) {
@@ -56,9 +409,188 @@ static Window get_active_window(Display *dpy) {
     return focused;
 }
 
-/* Send _NET_ACTIVE_WINDOW client message then fall back to XSetInputFocus */
-static void activate_window(Display *dpy, Window win) {
+/* Serve mode must survive requests for windows that have since been destroyed */
+static int ignore_x_error(Display *dpy, XErrorEvent *err) {
+    (void)dpy;
+    (void)err;
+    return 0;
+}
+
+/* True if the X input focus is on win or one of its descendants */
+static int focus_within(Display *dpy, Window win) {
+    Window focused;
+    int revert;
+    XGetInputFocus(dpy, &focused, &revert);
+
+    Window root = DefaultRootWindow(dpy);
+    while (focused != None && focused != PointerRoot && focused != root) {
+        if (focused == win) return 1;
+
+        Window parent, root_ret, *children = NULL;
+        unsigned int nchildren;
+        if (!XQueryTree(dpy, focused, &root_ret, &parent, &children, &nchildren))
+            return 0;
+        if (children) XFree(children);
+        focused = parent;
+    }
+    return 0;
+}
+
+static long get_window_pid(Display *dpy, Window win) {
+    Atom prop = XInternAtom(dpy, "_NET_WM_PID", True);
+    if (prop == None) return -1;
+
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems, bytes_after;
+    unsigned char *data = NULL;
+    long pid = -1;
+    if (XGetWindowProperty(dpy, win, prop, 0, 1, False, XA_CARDINAL, &actual_type,
+                           &actual_format, &nitems, &bytes_after, &data) == Success && data) {
+        if (nitems > 0) pid = (long)*(unsigned long *)data;
+        XFree(data);
+    }
+    return pid;
+}
+
+/* Basename of the process executable, falling back to comm for other users' processes */
+static int get_process_exe(long pid, char *out, size_t out_len) {
+    if (pid <= 0) return 0;
+
+    char path[64], target[4096];
+    snprintf(path, sizeof(path), "/proc/%ld/exe", pid);
+    ssize_t n = readlink(path, target, sizeof(target) - 1);
+    if (n > 0) {
+        target[n] = '\0';
+        const char *base = strrchr(target, '/');
+        base = base ? base + 1 : target;
+        size_t len = strlen(base);
+        if (len >= out_len) len = out_len - 1;
+        memcpy(out, base, len);
+        out[len] = '\0';
+        return 1;
+    }
+
+    snprintf(path, sizeof(path), "/proc/%ld/comm", pid);
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    int ok = fgets(out, (int)out_len, f) != NULL;
+    fclose(f);
+    if (ok) out[strcspn(out, "\n")] = '\0';
+    return ok;
+}
+
+static const SettleProfile *find_settle_profile(const char *res_class, const char *res_name) {
+    for (int i = 0; settle_profiles[i].wm_class; i++) {
+        if ((res_class && strcasestr(res_class, settle_profiles[i].wm_class)) ||
+            (res_name && strcasestr(res_name, settle_profiles[i].wm_class)))
+            return &settle_profiles[i];
+    }
+    return &default_settle_profile;
+}
+
+static void xpaster_resolve_keycodes(XPaster *xp) {
+    xp->ctrl = XKeysymToKeycode(xp->dpy, XK_Control_L);
+    xp->shift = XKeysymToKeycode(xp->dpy, XK_Shift_L);
+    xp->v = XKeysymToKeycode(xp->dpy, XK_v);
+}
+
+/* Drops the cached verdict for win, e.g. after DestroyNotify */
+static void xpaster_forget_window(XPaster *xp, Window win) {
+    for (int i = 0; i < WINDOW_VERDICT_CACHE_SIZE; i++) {
+        if (xp->verdicts[i].window == win) xp->verdicts[i].window = None;
+    }
+}
+
+static WindowVerdict *xpaster_cached_verdict(XPaster *xp, Window win) {
+    for (int i = 0; i < WINDOW_VERDICT_CACHE_SIZE; i++) {
+        if (xp->verdicts[i].window == win) return &xp->verdicts[i];
+    }
+    return NULL;
+}
+
+/*
+ * Looks up the terminal verdict and settle profile for win. A miss reads
+ * WM_CLASS, _NET_WM_PID and the executable name (three roundtrips plus
+ * /proc) and caches the result; later pastes into the same window skip all
+ * of that.
+ */
+static void xpaster_window_verdict(XPaster *xp, Window win, WindowVerdict *out) {
+    WindowVerdict *cached = xpaster_cached_verdict(xp, win);
+    if (cached) {
+        *out = *cached;
+        return;
+    }
+
+    Display *dpy = xp->dpy;
+    /* Select before reading so a WM_CLASS change racing the read still invalidates */
+    XSelectInput(dpy, win, WINDOW_VERDICT_EVENTS);
+
+    XClassHint hint = { NULL, NULL };
+    int have_class = XGetClassHint(dpy, win, &hint);
+    char exe[256];
+    int have_exe = get_process_exe(get_window_pid(dpy, win), exe, sizeof(exe));
+
+    out->window = win;
+    out->terminal = is_terminal_window(hint.res_class, hint.res_name, have_exe ? exe : NULL);
+    out->profile = find_settle_profile(hint.res_class, hint.res_name);
+    if (hint.res_name) XFree(hint.res_name);
+    if (hint.res_class) XFree(hint.res_class);
+
+    /* A window without WM_CLASS (or one already gone) is not worth a slot */
+    if (!have_class) {
+        XSelectInput(dpy, win, NoEventMask);
+        return;
+    }
+
+    WindowVerdict *slot = &xp->verdicts[xp->next_verdict];
+    xp->next_verdict = (xp->next_verdict + 1) % WINDOW_VERDICT_CACHE_SIZE;
+    if (slot->window != None) XSelectInput(dpy, slot->window, NoEventMask);
+    *slot = *out;
+}
+
+/* Handles the events every loop reading the connection must not drop */
+static void xpaster_handle_event(XPaster *xp, XEvent *ev) {
+    if (ev->type == MappingNotify) {
+        /* A resident connection must follow keyboard layout changes */
+        XRefreshKeyboardMapping(&ev->xmapping);
+        xpaster_resolve_keycodes(xp);
+    } else if (ev->type == DestroyNotify) {
+        xpaster_forget_window(xp, ev->xdestroywindow.window);
+    } else if (ev->type == PropertyNotify && ev->xproperty.atom == XA_WM_CLASS &&
+               xpaster_cached_verdict(xp, ev->xproperty.window)) {
+        XSelectInput(xp->dpy, ev->xproperty.window, NoEventMask);
+        xpaster_forget_window(xp, ev->xproperty.window);
+    }
+}
+
+/*
+ * Ask the WM to activate win via _NET_ACTIVE_WINDOW and return as soon as
+ * the focus is confirmed, either by FocusIn on the target or by the root's
+ * _NET_ACTIVE_WINDOW property changing to it. If neither arrives before
+ * timeout_ms the input focus is set directly, as a WM that ignores the
+ * request would otherwise leave the keystroke with the wrong window.
+ */
+static long activate_window(XPaster *xp, Window win, int timeout_ms) {
+    Display *dpy = xp->dpy;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (get_active_window(dpy) == win && focus_within(dpy, win)) {
+        fprintf(stderr, "activate 0x%lx: already focused (0 ms)\n", win);
+        return 0;
+    }
+
+    Window root = DefaultRootWindow(dpy);
     Atom net_active = XInternAtom(dpy, "_NET_ACTIVE_WINDOW", False);
+
+    XWindowAttributes root_attrs;
+    long root_mask = XGetWindowAttributes(dpy, root, &root_attrs) ? root_attrs.your_event_mask : 0;
+    /* Keep the verdict cache's selection on win while adding FocusChange */
+    long win_mask = xpaster_cached_verdict(xp, win) ? WINDOW_VERDICT_EVENTS : NoEventMask;
+    XSelectInput(dpy, root, root_mask | PropertyChangeMask);
+    XSelectInput(dpy, win, win_mask | FocusChangeMask);
+
     XEvent ev;
     memset(&ev, 0, sizeof(ev));
     ev.xclient.type         = ClientMessage;
@@ -69,166 +601,2267 @@ static void activate_window(Display *dpy, Window win) {
     ev.xclient.data.l[1]    = CurrentTime;
     ev.xclient.data.l[2]    = 0;
 
-    XSendEvent(dpy, DefaultRootWindow(dpy), False,
+    XSendEvent(dpy, root, False,
                SubstructureNotifyMask | SubstructureRedirectMask, &ev);
     XFlush(dpy);
 
-    /* Give the WM time to process the activation request */
-    usleep(50000);
+    const char *confirmed_by = NULL;
+    while (!confirmed_by) {
+        while (!confirmed_by && XPending(dpy)) {
+            XEvent event;
+            XNextEvent(dpy, &event);
+            if (event.type == FocusIn && event.xfocus.window == win &&
+                       event.xfocus.detail != NotifyPointer) {
+                confirmed_by = "focus-in";
+            } else if (event.type == PropertyNotify && event.xproperty.window == root &&
+                       event.xproperty.atom == net_active &&
+                       get_active_window(dpy) == win && focus_within(dpy, win)) {
+                confirmed_by = "net-active-window";
+            } else {
+                xpaster_handle_event(xp, &event);
+            }
+        }
+        if (confirmed_by) break;
+
+        long remaining = timeout_ms - elapsed_ms_since(&start);
+        if (remaining <= 0) break;
 
-    /* Fallback: also set X input focus directly */
-    XSetInputFocus(dpy, win, RevertToParent, CurrentTime);
-    XFlush(dpy);
-    usleep(20000);
+        struct pollfd pfd = { .fd = ConnectionNumber(dpy), .events = POLLIN };
+        poll(&pfd, 1, (int)remaining);
+    }
+
+    if (!confirmed_by) {
+        /* Fallback: set X input focus directly */
+        XSetInputFocus(dpy, win, RevertToParent, CurrentTime);
+        confirmed_by = "timeout, focus set directly";
+    }
+
+    XSelectInput(dpy, win, win_mask);
+    XSelectInput(dpy, root, root_mask);
+    XSync(dpy, False);
+
+    long elapsed = elapsed_ms_since(&start);
+    fprintf(stderr, "activate 0x%lx: %s (%ld ms)\n", win, confirmed_by, elapsed);
+    return elapsed;
 }
 
-#ifdef HAVE_UINPUT
-static void emit(int fd, int type, int code, int val) {
-    struct input_event ie;
-    memset(&ie, 0, sizeof(ie));
-    ie.type = type;
-    ie.code = code;
-    ie.value = val;
-    if (write(fd, &ie, sizeof(ie)) < 0) {
-        /* best-effort: logged by caller via exit code */
+/* Returns 0 on success, or the one-shot exit code on failure */
+static int xpaster_open(XPaster *xp) {
+    if (xp->dpy) return 0;
+
+    Display *dpy = XOpenDisplay(NULL);
+    if (!dpy) return 1;
+    trace_mark(TRACE_DISPLAY_OPEN);
+
+    int event_base, error_base, major, minor;
+    if (!XTestQueryExtension(dpy, &event_base, &error_base, &major, &minor)) {
+        XCloseDisplay(dpy);
+        return 2;
     }
+    trace_mark(TRACE_EXTENSION_QUERY);
+
+    XSetErrorHandler(ignore_x_error);
+    xp->dpy = dpy;
+    xpaster_resolve_keycodes(xp);
+    return 0;
 }
 
-static int paste_via_uinput(int use_shift) {
-    int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
-    if (fd < 0) {
-        fprintf(stderr, "Cannot open /dev/uinput: %s\n", strerror(errno));
-        return 3;
+static void xpaster_close(XPaster *xp) {
+    if (!xp->dpy) return;
+    if (xp->selection_window != None) {
+        XDestroyWindow(xp->dpy, xp->selection_window);
+        xp->selection_window = None;
     }
+    XCloseDisplay(xp->dpy);
+    xp->dpy = NULL;
+}
 
-    if (ioctl(fd, UI_SET_EVBIT, EV_KEY) < 0 ||
-        ioctl(fd, UI_SET_KEYBIT, KEY_LEFTCTRL) < 0 ||
-        ioctl(fd, UI_SET_KEYBIT, KEY_LEFTSHIFT) < 0 ||
-        ioctl(fd, UI_SET_KEYBIT, KEY_V) < 0) {
-        close(fd);
-        return 4;
+/* Drains events queued between commands: layout changes and verdict invalidations */
+static void xpaster_process_events(XPaster *xp) {
+    while (XPending(xp->dpy)) {
+        XEvent ev;
+        XNextEvent(xp->dpy, &ev);
+        xpaster_handle_event(xp, &ev);
     }
+}
 
-    struct uinput_setup usetup;
-    memset(&usetup, 0, sizeof(usetup));
-    usetup.id.bustype = BUS_USB;
-    usetup.id.vendor  = 0x1234;
-    usetup.id.product = 0x5678;
-    snprintf(usetup.name, UINPUT_MAX_NAME_SIZE, "openwhispr-paste");
+/*
+ * Gaps between key events use XTestFakeKeyEvent's delay argument, which the
+ * server honours before processing the event, and the closing XSync only
+ * returns once every event has been processed. Timing is therefore
+ * acknowledged by the server instead of guessed with client-side sleeps.
+ */
+static void inject_paste_keys(XPaster *xp, int use_shift, int key_delay_ms) {
+    Display *dpy = xp->dpy;
 
-    if (ioctl(fd, UI_DEV_SETUP, &usetup) < 0 ||
-        ioctl(fd, UI_DEV_CREATE) < 0) {
-        close(fd);
-        return 4;
+    XTestFakeKeyEvent(dpy, xp->ctrl, True, 0);
+    trace_mark(TRACE_KEY_DOWN);
+    if (use_shift)
+        XTestFakeKeyEvent(dpy, xp->shift, True, 0);
+
+    XTestFakeKeyEvent(dpy, xp->v, True, key_delay_ms);
+    XTestFakeKeyEvent(dpy, xp->v, False, key_delay_ms);
+
+    if (use_shift)
+        XTestFakeKeyEvent(dpy, xp->shift, False, 0);
+    XTestFakeKeyEvent(dpy, xp->ctrl, False, 0);
+    trace_mark(TRACE_KEY_UP);
+
+    XSync(dpy, False);
+    trace_mark(TRACE_FLUSH);
+}
+
+static void xpaster_init_selection(XPaster *xp) {
+    if (xp->selection_window != None) return;
+
+    Display *dpy = xp->dpy;
+    xp->selection_window = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy),
+                                               -10, -10, 1, 1, 0, 0, 0);
+    XSelectInput(dpy, xp->selection_window, PropertyChangeMask);
+    xp->clipboard = XInternAtom(dpy, "CLIPBOARD", False);
+    xp->targets = XInternAtom(dpy, "TARGETS", False);
+    xp->utf8_string = XInternAtom(dpy, "UTF8_STRING", False);
+    xp->text = XInternAtom(dpy, "TEXT", False);
+    xp->timestamp = XInternAtom(dpy, "TIMESTAMP", False);
+}
+
+/* ICCCM asks owners for a real server timestamp; a zero-length property
+   append produces a PropertyNotify that carries one. */
+static Time get_server_time(XPaster *xp) {
+    Display *dpy = xp->dpy;
+    unsigned char dummy = 0;
+    XChangeProperty(dpy, xp->selection_window, xp->timestamp, xp->timestamp, 8,
+                    PropModeAppend, &dummy, 0);
+
+    XEvent ev;
+    XWindowEvent(dpy, xp->selection_window, PropertyChangeMask, &ev);
+    return ev.xproperty.time;
+}
+
+/* Returns 0 on success, or a one-shot exit code */
+static int own_clipboard(XPaster *xp, size_t len, Time *owned_at) {
+    xpaster_init_selection(xp);
+
+    /* Larger payloads would need the INCR protocol; leave those to the caller */
+    long max_request = XExtendedMaxRequestSize(xp->dpy);
+    if (max_request == 0) max_request = XMaxRequestSize(xp->dpy);
+    if ((long)len > max_request * 4 - 1024) return 6;
+
+    *owned_at = get_server_time(xp);
+    XSetSelectionOwner(xp->dpy, xp->clipboard, xp->selection_window, *owned_at);
+    if (XGetSelectionOwner(xp->dpy, xp->clipboard) != xp->selection_window) return 5;
+    return 0;
+}
+
+/* Answers one SelectionRequest; returns 1 if the requestor received the text */
+static int answer_selection_request(XPaster *xp, const XSelectionRequestEvent *req,
+                                    const char *data, size_t len, Time owned_at) {
+    Display *dpy = xp->dpy;
+    /* Obsolete clients leave property unset and expect the target name */
+    Atom property = req->property != None ? req->property : req->target;
+    int served_data = 0;
+
+    XSelectionEvent reply;
+    memset(&reply, 0, sizeof(reply));
+    reply.type = SelectionNotify;
+    reply.display = dpy;
+    reply.requestor = req->requestor;
+    reply.selection = req->selection;
+    reply.target = req->target;
+    reply.time = req->time;
+    reply.property = None;
+
+    if (req->time != CurrentTime && req->time < owned_at) {
+        /* Request predates our ownership: refuse */
+    } else if (req->target == xp->targets) {
+        Atom supported[] = { xp->targets, xp->timestamp, xp->utf8_string, XA_STRING, xp->text };
+        XChangeProperty(dpy, req->requestor, property, XA_ATOM, 32, PropModeReplace,
+                        (unsigned char *)supported, sizeof(supported) / sizeof(supported[0]));
+        reply.property = property;
+    } else if (req->target == xp->timestamp) {
+        long stamp = (long)owned_at;
+        XChangeProperty(dpy, req->requestor, property, XA_INTEGER, 32, PropModeReplace,
+                        (unsigned char *)&stamp, 1);
+        reply.property = property;
+    } else if (req->target == xp->utf8_string || req->target == XA_STRING ||
+               req->target == xp->text) {
+        Atom type = req->target == XA_STRING ? XA_STRING : xp->utf8_string;
+        XChangeProperty(dpy, req->requestor, property, type, 8, PropModeReplace,
+                        (const unsigned char *)data, (int)len);
+        reply.property = property;
+        served_data = 1;
     }
 
-    /* Let the kernel register the virtual device */
-    usleep(50000);
+    XSendEvent(dpy, req->requestor, False, NoEventMask, (XEvent *)&reply);
+    XFlush(dpy);
+    return served_data;
+}
 
-    emit(fd, EV_KEY, KEY_LEFTCTRL, 1);
-    emit(fd, EV_SYN, SYN_REPORT, 0);
+/*
+ * Answers requests that are already queued before the keystroke goes out.
+ * These come from clipboard managers reacting to the ownership change, not
+ * from the paste, so they must not count as the target consuming the text.
+ */
+static void answer_early_requests(XPaster *xp, const char *data, size_t len, Time owned_at) {
+    Display *dpy = xp->dpy;
+    XSync(dpy, False);
+    while (XPending(dpy)) {
+        XEvent ev;
+        XNextEvent(dpy, &ev);
+        if (ev.type == SelectionRequest && ev.xselectionrequest.selection == xp->clipboard) {
+            answer_selection_request(xp, &ev.xselectionrequest, data, len, owned_at);
+        } else {
+            xpaster_handle_event(xp, &ev);
+        }
+    }
+}
 
-    if (use_shift) {
-        emit(fd, EV_KEY, KEY_LEFTSHIFT, 1);
-        emit(fd, EV_SYN, SYN_REPORT, 0);
+/*
+ * Serves CLIPBOARD after the paste keystroke until the text has been fetched.
+ * Apps commonly ask for TARGETS and then one or more text formats, so once
+ * the text has gone out we keep answering for CLIPBOARD_LINGER_MS of quiet.
+ * Returns the ms from keystroke to the first text transfer, or -1 if nothing
+ * fetched it before timeout_ms (or another client took the selection).
+ */
+static long serve_clipboard_until_fetched(XPaster *xp, const char *data, size_t len,
+                                          Time owned_at, int timeout_ms) {
+    Display *dpy = xp->dpy;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    long fetched_ms = -1;
+    long deadline_ms = timeout_ms;
+    int lost = 0;
+
+    while (!lost) {
+        while (XPending(dpy)) {
+            XEvent ev;
+            XNextEvent(dpy, &ev);
+            if (ev.type == SelectionRequest && ev.xselectionrequest.selection == xp->clipboard) {
+                if (answer_selection_request(xp, &ev.xselectionrequest, data, len, owned_at)) {
+                    long now_ms = elapsed_ms_since(&start);
+                    if (fetched_ms < 0) fetched_ms = now_ms;
+                    deadline_ms = now_ms + CLIPBOARD_LINGER_MS;
+                }
+            } else if (ev.type == SelectionClear && ev.xselectionclear.selection == xp->clipboard) {
+                lost = 1;
+            } else {
+                xpaster_handle_event(xp, &ev);
+            }
+        }
+        if (lost) break;
+
+        long remaining = deadline_ms - elapsed_ms_since(&start);
+        if (remaining <= 0) break;
+
+        struct pollfd pfd = { .fd = ConnectionNumber(dpy), .events = POLLIN };
+        poll(&pfd, 1, (int)remaining);
     }
 
-    usleep(8000);
+    if (!lost && XGetSelectionOwner(dpy, xp->clipboard) == xp->selection_window) {
+        XSetSelectionOwner(dpy, xp->clipboard, None, owned_at);
+    }
+    XSync(dpy, False);
+    return fetched_ms;
+}
 
-    emit(fd, EV_KEY, KEY_V, 1);
-    emit(fd, EV_SYN, SYN_REPORT, 0);
-    usleep(8000);
+static int paste_via_xtest(XPaster *xp, const PasteRequest *req, PasteResult *result) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
-    emit(fd, EV_KEY, KEY_V, 0);
-    emit(fd, EV_SYN, SYN_REPORT, 0);
+    int rc = xpaster_open(xp);
+    if (rc != 0) return rc;
 
-    usleep(8000);
+    Display *dpy = xp->dpy;
+    xpaster_process_events(xp);
 
-    if (use_shift) {
-        emit(fd, EV_KEY, KEY_LEFTSHIFT, 0);
-        emit(fd, EV_SYN, SYN_REPORT, 0);
+    long activate_ms = 0;
+    if (req->target_window != None) {
+        activate_ms = activate_window(xp, req->target_window, req->activate_timeout_ms);
+        trace_mark(TRACE_ACTIVATE);
     }
 
-    emit(fd, EV_KEY, KEY_LEFTCTRL, 0);
-    emit(fd, EV_SYN, SYN_REPORT, 0);
+    Window win = (req->target_window != None) ? req->target_window : get_active_window(dpy);
+
+    int use_shift = req->force_terminal;
+    const SettleProfile *profile = &default_settle_profile;
+    if (win != None && win != PointerRoot) {
+        WindowVerdict verdict;
+        xpaster_window_verdict(xp, win, &verdict);
+        if (!use_shift) use_shift = verdict.terminal;
+        profile = verdict.profile;
+    }
 
-    usleep(20000);
+    int key_delay_ms = req->key_delay_ms >= 0 ? req->key_delay_ms : profile->key_delay_ms;
+    int settle_ms = req->settle_ms >= 0 ? req->settle_ms : profile->settle_ms;
 
-    ioctl(fd, UI_DEV_DESTROY);
-    close(fd);
+    Time owned_at = CurrentTime;
+    if (req->clipboard_data) {
+        rc = own_clipboard(xp, req->clipboard_len, &owned_at);
+        if (rc != 0) return rc;
+        answer_early_requests(xp, req->clipboard_data, req->clipboard_len, owned_at);
+    }
+
+    long inject_start_ms = elapsed_ms_since(&start);
+    inject_paste_keys(xp, use_shift, key_delay_ms);
+    long inject_ms = elapsed_ms_since(&start) - inject_start_ms;
+
+    if (req->clipboard_data) {
+        result->served_clipboard = 1;
+        result->consumed_ms = serve_clipboard_until_fetched(xp, req->clipboard_data,
+                                                            req->clipboard_len, owned_at,
+                                                            req->clipboard_timeout_ms);
+    } else if (settle_ms > 0) {
+        usleep(settle_ms * 1000);
+    }
+
+    if (req->timing) {
+        fprintf(stderr,
+                "timing: profile=%s key_delay=%d settle=%d activate=%ld inject=%ld total=%ld ms\n",
+                profile->wm_class, key_delay_ms, settle_ms, activate_ms, inject_ms,
+                elapsed_ms_since(&start));
+    }
     return 0;
 }
-#endif
 
-int main(int argc, char *argv[]) {
-    int force_terminal = 0;
-    int use_uinput = 0;
-    Window target_window = None;
+/*
+ * Decodes UTF-8 text into the keysyms that type it: newline and tab become
+ * Return and Tab, other control characters and malformed bytes are dropped,
+ * Latin-1 uses the legacy keysyms and everything else Unicode keysyms.
+ * out needs room for len entries; returns the number written.
+ */
+static size_t text_to_keysyms(const char *text, size_t len, KeySym *out) {
+    const unsigned char *p = (const unsigned char *)text;
+    const unsigned char *end = p + len;
+    size_t count = 0;
 
-    for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "--terminal") == 0) {
-            force_terminal = 1;
-        } else if (strcmp(argv[i], "--uinput") == 0) {
-            use_uinput = 1;
-        } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
-            target_window = (Window)strtoul(argv[++i], NULL, 0);
+    while (p < end) {
+        unsigned long cp;
+        int extra;
+        if (*p < 0x80) {
+            cp = *p;
+            extra = 0;
+        } else if ((*p & 0xe0) == 0xc0) {
+            cp = *p & 0x1f;
+            extra = 1;
+        } else if ((*p & 0xf0) == 0xe0) {
+            cp = *p & 0x0f;
+            extra = 2;
+        } else if ((*p & 0xf8) == 0xf0) {
+            cp = *p & 0x07;
+            extra = 3;
+        } else {
+            p++;
+            continue;
+        }
+        if (end - p <= extra) break;
+
+        int valid = 1;
+        for (int i = 1; i <= extra && valid; i++) {
+            valid = (p[i] & 0xc0) == 0x80;
+            cp = (cp << 6) | (p[i] & 0x3f);
+        }
+        if (!valid) {
+            p++;
+            continue;
+        }
+        p += extra + 1;
+
+        if (cp == '\n') {
+            out[count++] = XK_Return;
+        } else if (cp == '\t') {
+            out[count++] = XK_Tab;
+        } else if (cp < 0x20 || (cp >= 0x7f && cp < 0xa0)) {
+            continue;
+        } else if (cp < 0x100) {
+            out[count++] = (KeySym)cp;
+        } else {
+            out[count++] = (KeySym)(0x01000000 | cp);
         }
     }
+    return count;
+}
 
-    if (use_uinput) {
-#ifdef HAVE_UINPUT
-        return paste_via_uinput(force_terminal);
-#else
-        fprintf(stderr, "uinput support not compiled in\n");
-        return 3;
-#endif
+/* Core keyboard mapping, read once per typing request */
+typedef struct {
+    int min_keycode;
+    int max_keycode;
+    int per_keycode;
+    KeySym *syms;
+} KeyboardMap;
+
+static int keyboard_map_load(Display *dpy, KeyboardMap *map) {
+    XDisplayKeycodes(dpy, &map->min_keycode, &map->max_keycode);
+    map->syms = XGetKeyboardMapping(dpy, (KeyCode)map->min_keycode,
+                                    map->max_keycode - map->min_keycode + 1, &map->per_keycode);
+    return map->syms ? 0 : -1;
+}
+
+/*
+ * Keycode that types ks in the first group without remapping, preferring the
+ * unshifted level, or 0 if the layout has none. *shift receives the level.
+ */
+static KeyCode keyboard_map_find(const KeyboardMap *map, KeySym ks, int *shift) {
+    int levels = map->per_keycode < 2 ? map->per_keycode : 2;
+    for (int level = 0; level < levels; level++) {
+        for (int kc = map->min_keycode; kc <= map->max_keycode; kc++) {
+            if (map->syms[(kc - map->min_keycode) * map->per_keycode + level] == ks) {
+                *shift = level;
+                return (KeyCode)kc;
+            }
+        }
     }
+    return 0;
+}
 
-    Display *dpy = XOpenDisplay(NULL);
-    if (!dpy) return 1;
+/* Keycodes with no keysym at all, in ascending order; out holds 256 entries */
+static int keyboard_map_spare(const KeyboardMap *map, KeyCode *out) {
+    int count = 0;
+    for (int kc = map->min_keycode; kc <= map->max_keycode; kc++) {
+        const KeySym *syms = &map->syms[(kc - map->min_keycode) * map->per_keycode];
+        int empty = 1;
+        for (int i = 0; i < map->per_keycode && empty; i++) empty = syms[i] == NoSymbol;
+        if (empty) out[count++] = (KeyCode)kc;
+    }
+    return count;
+}
 
-    int event_base, error_base, major, minor;
-    if (!XTestQueryExtension(dpy, &event_base, &error_base, &major, &minor)) {
-        XCloseDisplay(dpy);
-        return 2;
+/*
+ * Extends a typing batch from syms[start] for as long as the distinct keysyms
+ * it needs fit in max_slots, collecting them in slots. Keysyms with a fixed
+ * keycode (fixed[i] != 0) need no slot; fixed may be NULL. Returns the end of
+ * the batch.
+ */
+static size_t plan_type_batch(const KeySym *syms, const KeyCode *fixed, size_t start,
+                              size_t count, KeySym *slots, int max_slots, int *nslots) {
+    *nslots = 0;
+    size_t end = start;
+    for (; end < count; end++) {
+        if (fixed && fixed[end]) continue;
+        int slot = 0;
+        while (slot < *nslots && slots[slot] != syms[end]) slot++;
+        if (slot < *nslots) continue;
+        if (*nslots == max_slots) break;
+        slots[(*nslots)++] = syms[end];
+    }
+    return end;
+}
+
+static int type_slot(const KeySym *slots, int nslots, KeySym ks) {
+    for (int i = 0; i < nslots; i++) {
+        if (slots[i] == ks) return i;
     }
+    return -1;
+}
 
-    if (target_window != None) {
-        activate_window(dpy, target_window);
+/*
+ * Binds keycodes[i] to syms[i] on both shift levels (NoSymbol unbinds it),
+ * with one XChangeKeyboardMapping per run of adjacent keycodes, since every
+ * request makes each client refetch the mapping.
+ */
+static void bind_keycodes(Display *dpy, const KeyCode *keycodes, const KeySym *syms, int count) {
+    KeySym run[2 * 256];
+    int start = 0;
+    while (start < count) {
+        int end = start;
+        do {
+            run[2 * (end - start)] = syms[end];
+            run[2 * (end - start) + 1] = syms[end];
+            end++;
+        } while (end < count && keycodes[end] == keycodes[end - 1] + 1);
+        XChangeKeyboardMapping(dpy, keycodes[start], 2, run, end - start);
+        start = end;
     }
+}
 
-    Window win = (target_window != None) ? target_window : get_active_window(dpy);
+/*
+ * Types syms with XTest. Keysyms missing from the layout are bound to spare
+ * keycodes once for the whole request. Rebinding a keycode mid-request (or
+ * unbinding it right after the last key) races clients that only refetch the
+ * mapping when they look the key up: they would see the server's current
+ * mapping, not the one the event was sent under. Text that needs more spare
+ * keycodes than there are fails with 10 so the caller pastes it instead.
+ */
+static int type_via_xtest(XPaster *xp, const PasteRequest *req, const KeySym *syms,
+                          size_t count) {
+    int rc = xpaster_open(xp);
+    if (rc != 0) return rc;
 
-    int use_shift = force_terminal;
-    if (!use_shift && win != None) {
-        XClassHint hint;
-        if (XGetClassHint(dpy, win, &hint)) {
-            use_shift = is_terminal(hint.res_class) || is_terminal(hint.res_name);
-            XFree(hint.res_name);
-            XFree(hint.res_class);
-        }
+    Display *dpy = xp->dpy;
+    xpaster_process_events(xp);
+
+    if (req->target_window != None) {
+        activate_window(xp, req->target_window, req->activate_timeout_ms);
+        trace_mark(TRACE_ACTIVATE);
     }
 
-    KeyCode ctrl = XKeysymToKeycode(dpy, XK_Control_L);
-    KeyCode shift = XKeysymToKeycode(dpy, XK_Shift_L);
-    KeyCode v = XKeysymToKeycode(dpy, XK_v);
+    Window win = (req->target_window != None) ? req->target_window : get_active_window(dpy);
+    const SettleProfile *profile = &default_settle_profile;
+    if (win != None && win != PointerRoot) {
+        WindowVerdict verdict;
+        xpaster_window_verdict(xp, win, &verdict);
+        profile = verdict.profile;
+    }
+    int key_delay_ms = req->key_delay_ms >= 0 ? req->key_delay_ms : profile->key_delay_ms;
 
-    XTestFakeKeyEvent(dpy, ctrl, True, CurrentTime);
-    if (use_shift)
-        XTestFakeKeyEvent(dpy, shift, True, CurrentTime);
-    usleep(8000);
+    KeyboardMap map;
+    if (keyboard_map_load(dpy, &map) < 0) return 10;
 
-    XTestFakeKeyEvent(dpy, v, True, CurrentTime);
-    usleep(8000);
-    XTestFakeKeyEvent(dpy, v, False, CurrentTime);
+    KeyCode *keycodes = (KeyCode *)calloc(count ? count : 1, sizeof(KeyCode));
+    int *levels = (int *)calloc(count ? count : 1, sizeof(int));
+    KeyCode spare[256];
+    KeySym slots[256];
+    int nspare = keyboard_map_spare(&map, spare);
+    for (size_t i = 0; keycodes && levels && i < count; i++) {
+        keycodes[i] = keyboard_map_find(&map, syms[i], &levels[i]);
+    }
+    XFree(map.syms);
 
-    usleep(8000);
-    if (use_shift)
-        XTestFakeKeyEvent(dpy, shift, False, CurrentTime);
-    XTestFakeKeyEvent(dpy, ctrl, False, CurrentTime);
+    /* Every keysym the layout lacks needs a spare keycode of its own */
+    int nslots = 0;
+    if (!keycodes || !levels ||
+        plan_type_batch(syms, keycodes, 0, count, slots, nspare, &nslots) < count) {
+        free(keycodes);
+        free(levels);
+        return 10;
+    }
+    if (nslots > 0) bind_keycodes(dpy, spare, slots, nslots);
 
-    XFlush(dpy);
-    usleep(20000);
-    XCloseDisplay(dpy);
+    int shift_down = 0;
+    trace_mark(TRACE_KEY_DOWN);
+    for (size_t i = 0; i < count; i++) {
+        KeyCode kc = keycodes[i];
+        /* Bound keycodes carry the keysym on both levels, so shift does not matter */
+        int level = kc ? levels[i] : shift_down;
+        if (!kc) kc = spare[type_slot(slots, nslots, syms[i])];
+
+        if (level != shift_down) {
+            XTestFakeKeyEvent(dpy, xp->shift, level ? True : False, 0);
+            shift_down = level;
+        }
+        XTestFakeKeyEvent(dpy, kc, True, key_delay_ms);
+        XTestFakeKeyEvent(dpy, kc, False, 0);
+    }
+    if (shift_down) XTestFakeKeyEvent(dpy, xp->shift, False, 0);
+    trace_mark(TRACE_KEY_UP);
+    XSync(dpy, False);
+
+    if (nslots > 0) {
+        /* Clients look the last keys up after the server delivered them */
+        usleep(XTEST_UNBIND_DELAY_MS * 1000);
+        KeySym none[256];
+        for (int i = 0; i < nslots; i++) none[i] = NoSymbol;
+        bind_keycodes(dpy, spare, none, nslots);
+        XSync(dpy, False);
+    }
+    trace_mark(TRACE_FLUSH);
+
+    free(keycodes);
+    free(levels);
     return 0;
 }
+
+#ifdef HAVE_UINPUT
+static void emit(int fd, int type, int code, int val) {
+    struct input_event ie;
+    memset(&ie, 0, sizeof(ie));
+    ie.type = type;
+    ie.code = code;
+    ie.value = val;
+    if (write(fd, &ie, sizeof(ie)) < 0) {
+        /* best-effort: logged by caller via exit code */
+    }
+}
+
+/* Finds the evdev node name (e.g. "event7") the kernel assigned to our device */
+static int uinput_event_name(int fd, char *out, size_t out_len) {
+    char sysname[64];
+    if (ioctl(fd, UI_GET_SYSNAME(sizeof(sysname)), sysname) < 0) return -1;
+
+    char sys_path[128];
+    snprintf(sys_path, sizeof(sys_path), "/sys/devices/virtual/input/%s", sysname);
+    DIR *dir = opendir(sys_path);
+    if (!dir) return -1;
+
+    int found = -1;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t name_len = strlen(entry->d_name);
+        if (strncmp(entry->d_name, "event", 5) == 0 && name_len < out_len) {
+            memcpy(out, entry->d_name, name_len + 1);
+            found = 0;
+            break;
+        }
+    }
+    closedir(dir);
+    return found;
+}
+
+/* udev has processed the node once it is no longer devtmpfs's root:root 0600 */
+static int event_node_configured(const char *name) {
+    char node[64];
+    struct stat st;
+    snprintf(node, sizeof(node), "/dev/input/%s", name);
+    if (stat(node, &st) < 0) return 0;
+    return st.st_gid != 0 || (st.st_mode & 0777) != 0600;
+}
+
+/*
+ * Waits until udev has applied its rules to the new /dev/input/event* node.
+ * That is the point at which compositors (libinput listens to udev, not the
+ * kernel) learn about the device. The inotify watch is armed before
+ * UI_DEV_CREATE so the IN_ATTRIB from udev cannot be missed. Systems without
+ * udev never change the node, so the wait is bounded.
+ */
+static void wait_for_event_node(int inotify_fd, int uinput_fd) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    char name[32];
+    if (uinput_event_name(uinput_fd, name, sizeof(name)) < 0) {
+        usleep(UINPUT_READY_TIMEOUT_MS * 1000);
+        return;
+    }
+
+    int ready = event_node_configured(name);
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (!ready && inotify_fd >= 0) {
+        long remaining = UINPUT_READY_TIMEOUT_MS - elapsed_ms_since(&start);
+        if (remaining <= 0) break;
+
+        struct pollfd pfd = { .fd = inotify_fd, .events = POLLIN };
+        if (poll(&pfd, 1, (int)remaining) <= 0) break;
+
+        ssize_t len = read(inotify_fd, buf, sizeof(buf));
+        if (len <= 0) break;
+
+        for (char *ptr = buf; ptr < buf + len;) {
+            struct inotify_event *ev = (struct inotify_event *)ptr;
+            if (ev->len > 0 && strcmp(ev->name, name) == 0 && (ev->mask & IN_ATTRIB))
+                ready = 1;
+            ptr += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+
+    if (!ready && inotify_fd < 0) {
+        usleep(UINPUT_READY_TIMEOUT_MS * 1000);
+    }
+
+    fprintf(stderr, "uinput device %s %s after %ld ms\n", name,
+            ready ? "ready" : "assumed ready", elapsed_ms_since(&start));
+}
+
+/* Returns 0 on success, or the one-shot exit code on failure */
+static int uinput_keyboard_open(UinputKeyboard *kb) {
+    if (kb->fd >= 0) return 0;
+
+    int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open /dev/uinput: %s\n", strerror(errno));
+        return 3;
+    }
+
+    /* Every code an X keycode (8..255) can stand for, so --type can reach any key */
+    int keys_ok = ioctl(fd, UI_SET_EVBIT, EV_KEY) == 0;
+    for (int code = 1; keys_ok && code <= 255 - 8; code++)
+        keys_ok = ioctl(fd, UI_SET_KEYBIT, code) == 0;
+    if (!keys_ok) {
+        close(fd);
+        return 4;
+    }
+
+    struct uinput_setup usetup;
+    memset(&usetup, 0, sizeof(usetup));
+    usetup.id.bustype = BUS_USB;
+    usetup.id.vendor  = 0x1234;
+    usetup.id.product = 0x5678;
+    /* linux-key-listener skips the device by this name; keep them in step */
+    snprintf(usetup.name, UINPUT_MAX_NAME_SIZE, "openwhispr-paste");
+
+    int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd >= 0 &&
+        inotify_add_watch(inotify_fd, "/dev/input", IN_CREATE | IN_ATTRIB) < 0) {
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+
+    if (ioctl(fd, UI_DEV_SETUP, &usetup) < 0 ||
+        ioctl(fd, UI_DEV_CREATE) < 0) {
+        if (inotify_fd >= 0) close(inotify_fd);
+        close(fd);
+        return 4;
+    }
+
+    wait_for_event_node(inotify_fd, fd);
+    if (inotify_fd >= 0) close(inotify_fd);
+    trace_mark(TRACE_DEVICE_READY);
+
+    kb->fd = fd;
+    return 0;
+}
+
+static void uinput_keyboard_close(UinputKeyboard *kb) {
+    if (kb->fd < 0) return;
+    ioctl(kb->fd, UI_DEV_DESTROY);
+    close(kb->fd);
+    kb->fd = -1;
+}
+
+/* Creates the virtual keyboard on first use; it stays registered until closed */
+static int paste_via_uinput(UinputKeyboard *kb, int use_shift) {
+    int rc = uinput_keyboard_open(kb);
+    if (rc != 0) return rc;
+
+    int fd = kb->fd;
+
+    emit(fd, EV_KEY, KEY_LEFTCTRL, 1);
+    emit(fd, EV_SYN, SYN_REPORT, 0);
+    trace_mark(TRACE_KEY_DOWN);
+
+    if (use_shift) {
+        emit(fd, EV_KEY, KEY_LEFTSHIFT, 1);
+        emit(fd, EV_SYN, SYN_REPORT, 0);
+    }
+
+    /*
+     * No pauses between the reports: the device is registered before the
+     * first paste, and the compositor reads each SYN_REPORT frame from the
+     * event node in order, so modifiers are always down before the V.
+     */
+    emit(fd, EV_KEY, KEY_V, 1);
+    emit(fd, EV_SYN, SYN_REPORT, 0);
+
+    emit(fd, EV_KEY, KEY_V, 0);
+    emit(fd, EV_SYN, SYN_REPORT, 0);
+
+    if (use_shift) {
+        emit(fd, EV_KEY, KEY_LEFTSHIFT, 0);
+        emit(fd, EV_SYN, SYN_REPORT, 0);
+    }
+
+    emit(fd, EV_KEY, KEY_LEFTCTRL, 0);
+    trace_mark(TRACE_KEY_UP);
+    /* uinput writes are synchronous; the final report hands the events to evdev */
+    emit(fd, EV_SYN, SYN_REPORT, 0);
+    trace_mark(TRACE_FLUSH);
+    return 0;
+}
+
+/*
+ * Types syms through the virtual keyboard. Which evdev code yields which
+ * keysym is up to the compositor's layout, which the X (or XWayland) keymap
+ * mirrors: X keycodes are evdev codes + 8. Nothing is typed unless every
+ * keysym is on the layout, since uinput cannot bind new ones.
+ */
+static int type_via_uinput(PasteContext *ctx, const PasteRequest *req, const KeySym *syms,
+                           size_t count) {
+    int rc = xpaster_open(&ctx->x);
+    if (rc != 0) return rc;
+
+    KeyboardMap map;
+    if (keyboard_map_load(ctx->x.dpy, &map) < 0) return 10;
+
+    KeyCode *keycodes = (KeyCode *)calloc(count ? count : 1, sizeof(KeyCode));
+    int *levels = (int *)calloc(count ? count : 1, sizeof(int));
+    int typeable = keycodes && levels;
+    for (size_t i = 0; typeable && i < count; i++) {
+        keycodes[i] = keyboard_map_find(&map, syms[i], &levels[i]);
+        typeable = keycodes[i] > 8;
+    }
+    XFree(map.syms);
+
+    rc = typeable ? uinput_keyboard_open(&ctx->uinput) : 10;
+    if (rc != 0) {
+        free(keycodes);
+        free(levels);
+        return rc;
+    }
+
+    int fd = ctx->uinput.fd;
+    int key_delay_us = (req->key_delay_ms >= 0 ? req->key_delay_ms : UINPUT_TYPE_KEY_DELAY_MS) *
+                       1000;
+    int shift_down = 0;
+    trace_mark(TRACE_KEY_DOWN);
+    for (size_t i = 0; i < count; i++) {
+        if (levels[i] != shift_down) {
+            shift_down = levels[i];
+            emit(fd, EV_KEY, KEY_LEFTSHIFT, shift_down);
+            emit(fd, EV_SYN, SYN_REPORT, 0);
+        }
+        emit(fd, EV_KEY, keycodes[i] - 8, 1);
+        emit(fd, EV_SYN, SYN_REPORT, 0);
+        emit(fd, EV_KEY, keycodes[i] - 8, 0);
+        emit(fd, EV_SYN, SYN_REPORT, 0);
+        if (key_delay_us > 0) usleep(key_delay_us);
+    }
+    if (shift_down) {
+        emit(fd, EV_KEY, KEY_LEFTSHIFT, 0);
+        emit(fd, EV_SYN, SYN_REPORT, 0);
+    }
+    trace_mark(TRACE_KEY_UP);
+    trace_mark(TRACE_FLUSH);
+
+    free(keycodes);
+    free(levels);
+    return 0;
+}
+#endif
+
+#ifdef HAVE_WAYLAND
+/* Just the keys the paste needs, at their evdev keycodes + 8 */
+static const char wayland_keymap[] =
+    "xkb_keymap {\n"
+    "  xkb_keycodes \"openwhispr\" {\n"
+    "    minimum = 8;\n"
+    "    maximum = 255;\n"
+    "    <LCTL> = 37;\n"
+    "    <LFSH> = 50;\n"
+    "    <AB04> = 55;\n"
+    "  };\n"
+    "  xkb_types \"openwhispr\" { include \"complete\" };\n"
+    "  xkb_compatibility \"openwhispr\" { include \"complete\" };\n"
+    "  xkb_symbols \"openwhispr\" {\n"
+    "    key <LCTL> { [ Control_L ] };\n"
+    "    key <LFSH> { [ Shift_L ] };\n"
+    "    key <AB04> { [ v, V ] };\n"
+    "    modifier_map Control { <LCTL> };\n"
+    "    modifier_map Shift { <LFSH> };\n"
+    "  };\n"
+    "};\n";
+
+/* Modifier masks in the keymap above (standard xkb modifier order) */
+#define WAYLAND_MOD_SHIFT   (1u << 0)
+#define WAYLAND_MOD_CONTROL (1u << 2)
+
+/* Text types we offer as a source, and accept as a reader, in order of preference */
+static const char *const text_mime_types[] = {
+    "text/plain;charset=utf-8", "text/plain", "UTF8_STRING", "TEXT", "STRING", NULL
+};
+
+/* Best text type an offer advertises, attached to the offer as user data */
+typedef struct {
+    int text_rank;  /* index into text_mime_types; -1 until one is seen */
+} OfferInfo;
+
+/* Text served for one of our data sources, attached to it as user data */
+typedef struct {
+    WaylandSession *ws;
+    char *text;
+    size_t len;
+} ClipboardSource;
+
+static void registry_global(void *data, struct wl_registry *registry, uint32_t name,
+                            const char *interface, uint32_t version) {
+    WaylandSession *ws = (WaylandSession *)data;
+    (void)version;
+    if (strcmp(interface, wl_seat_interface.name) == 0 && !ws->seat) {
+        ws->seat = wl_registry_bind(registry, name, &wl_seat_interface, 1);
+    } else if (strcmp(interface, zwp_virtual_keyboard_manager_v1_interface.name) == 0) {
+        ws->keyboard_manager = wl_registry_bind(registry, name,
+                                                &zwp_virtual_keyboard_manager_v1_interface, 1);
+    } else if (strcmp(interface, zwlr_data_control_manager_v1_interface.name) == 0) {
+        ws->data_control_manager = wl_registry_bind(registry, name,
+                                                    &zwlr_data_control_manager_v1_interface, 1);
+    }
+}
+
+static void registry_global_remove(void *data, struct wl_registry *registry, uint32_t name) {
+    (void)data;
+    (void)registry;
+    (void)name;
+}
+
+static const struct wl_registry_listener registry_listener = {
+    registry_global,
+    registry_global_remove,
+};
+
+static void offer_offer(void *data, struct zwlr_data_control_offer_v1 *offer,
+                        const char *mime_type) {
+    OfferInfo *info = (OfferInfo *)data;
+    (void)offer;
+    if (!info) return;
+    for (int i = 0; text_mime_types[i]; i++) {
+        if (strcmp(mime_type, text_mime_types[i]) == 0) {
+            if (info->text_rank < 0 || i < info->text_rank) info->text_rank = i;
+            return;
+        }
+    }
+}
+
+static const struct zwlr_data_control_offer_v1_listener offer_listener = {
+    offer_offer,
+};
+
+static void destroy_offer(struct zwlr_data_control_offer_v1 *offer) {
+    if (!offer) return;
+    free(zwlr_data_control_offer_v1_get_user_data(offer));
+    zwlr_data_control_offer_v1_destroy(offer);
+}
+
+static void device_data_offer(void *data, struct zwlr_data_control_device_v1 *device,
+                              struct zwlr_data_control_offer_v1 *offer) {
+    (void)data;
+    (void)device;
+    OfferInfo *info = (OfferInfo *)malloc(sizeof(OfferInfo));
+    if (info) info->text_rank = -1;
+    zwlr_data_control_offer_v1_add_listener(offer, &offer_listener, info);
+}
+
+static void device_selection(void *data, struct zwlr_data_control_device_v1 *device,
+                             struct zwlr_data_control_offer_v1 *offer) {
+    WaylandSession *ws = (WaylandSession *)data;
+    (void)device;
+    destroy_offer(ws->selection_offer);
+    ws->selection_offer = offer;
+}
+
+static void device_finished(void *data, struct zwlr_data_control_device_v1 *device) {
+    WaylandSession *ws = (WaylandSession *)data;
+    /* The seat went away; the device is reopened on next use */
+    destroy_offer(ws->selection_offer);
+    ws->selection_offer = NULL;
+    zwlr_data_control_device_v1_destroy(device);
+    ws->data_device = NULL;
+}
+
+static void device_primary_selection(void *data, struct zwlr_data_control_device_v1 *device,
+                                     struct zwlr_data_control_offer_v1 *offer) {
+    /* Only sent from version 2; we bind version 1 */
+    (void)data;
+    (void)device;
+    destroy_offer(offer);
+}
+
+static const struct zwlr_data_control_device_v1_listener device_listener = {
+    device_data_offer,
+    device_selection,
+    device_finished,
+    device_primary_selection,
+};
+
+/* Writes what a non-blocking pipe takes; returns 1 once done (all sent or reader gone) */
+static int send_some(int fd, const char *data, size_t len, size_t *off) {
+    while (*off < len) {
+        ssize_t n = write(fd, data + *off, len - *off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno != EAGAIN && errno != EWOULDBLOCK;
+        }
+        *off += (size_t)n;
+    }
+    return 1;
+}
+
+static void source_send(void *data, struct zwlr_data_control_source_v1 *source,
+                        const char *mime_type, int32_t fd) {
+    ClipboardSource *cs = (ClipboardSource *)data;
+    (void)source;
+    (void)mime_type;
+
+    /* A reader that is slow to drain its pipe must not stall the server */
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    size_t off = 0;
+    if (!send_some(fd, cs->text, cs->len, &off)) {
+        /* The source may be replaced before the reader catches up, so keep a copy */
+        PendingSend *ps = (PendingSend *)malloc(sizeof(PendingSend));
+        char *rest = ps ? (char *)malloc(cs->len - off) : NULL;
+        if (rest) {
+            memcpy(rest, cs->text + off, cs->len - off);
+            ps->fd = fd;
+            ps->data = rest;
+            ps->len = cs->len - off;
+            ps->off = 0;
+            ps->next = cs->ws->sends;
+            cs->ws->sends = ps;
+            return;
+        }
+        free(ps);
+    }
+    close(fd);
+}
+
+static void wayland_flush_sends(WaylandSession *ws) {
+    PendingSend **link = &ws->sends;
+    while (*link) {
+        PendingSend *ps = *link;
+        if (send_some(ps->fd, ps->data, ps->len, &ps->off)) {
+            *link = ps->next;
+            close(ps->fd);
+            free(ps->data);
+            free(ps);
+        } else {
+            link = &ps->next;
+        }
+    }
+}
+
+static void clipboard_source_destroy(struct zwlr_data_control_source_v1 *source) {
+    ClipboardSource *cs = (ClipboardSource *)zwlr_data_control_source_v1_get_user_data(source);
+    if (cs->ws->source == source) cs->ws->source = NULL;
+    free(cs->text);
+    free(cs);
+    zwlr_data_control_source_v1_destroy(source);
+}
+
+static void source_cancelled(void *data, struct zwlr_data_control_source_v1 *source) {
+    (void)data;
+    clipboard_source_destroy(source);
+}
+
+static const struct zwlr_data_control_source_v1_listener source_listener = {
+    source_send,
+    source_cancelled,
+};
+
+static void wayland_session_close(WaylandSession *ws) {
+    while (ws->sends) {
+        PendingSend *ps = ws->sends;
+        ws->sends = ps->next;
+        close(ps->fd);
+        free(ps->data);
+        free(ps);
+    }
+    if (ws->source) clipboard_source_destroy(ws->source);
+    destroy_offer(ws->selection_offer);
+    if (ws->data_device) zwlr_data_control_device_v1_destroy(ws->data_device);
+    if (ws->data_control_manager) zwlr_data_control_manager_v1_destroy(ws->data_control_manager);
+    if (ws->keyboard) zwp_virtual_keyboard_v1_destroy(ws->keyboard);
+    if (ws->keyboard_manager) zwp_virtual_keyboard_manager_v1_destroy(ws->keyboard_manager);
+    if (ws->seat) wl_seat_destroy(ws->seat);
+    if (ws->registry) wl_registry_destroy(ws->registry);
+    if (ws->display) wl_display_disconnect(ws->display);
+    memset(ws, 0, sizeof(*ws));
+}
+
+/* Connects and binds the globals on first use; returns 0 or a one-shot exit code */
+static int wayland_connect(WaylandSession *ws) {
+    if (ws->display) return 0;
+
+    ws->display = wl_display_connect(NULL);
+    if (!ws->display) return 7;
+    trace_mark(TRACE_DISPLAY_OPEN);
+
+    ws->registry = wl_display_get_registry(ws->display);
+    wl_registry_add_listener(ws->registry, &registry_listener, ws);
+    if (wl_display_roundtrip(ws->display) < 0 || !ws->seat) {
+        wayland_session_close(ws);
+        return 7;
+    }
+    trace_mark(TRACE_EXTENSION_QUERY);
+    return 0;
+}
+
+/* A failed roundtrip means a protocol error; the connection is unusable after one */
+static int wayland_roundtrip(WaylandSession *ws) {
+    if (wl_display_roundtrip(ws->display) >= 0) return 0;
+    wayland_session_close(ws);
+    return -1;
+}
+
+/* size includes the terminating NUL, as the protocol expects */
+static int upload_wayland_keymap(WaylandSession *ws, const char *keymap, size_t size) {
+    int fd = memfd_create("openwhispr-keymap", MFD_CLOEXEC);
+    if (fd < 0) return -1;
+
+    if (write(fd, keymap, size) != (ssize_t)size) {
+        close(fd);
+        return -1;
+    }
+    zwp_virtual_keyboard_v1_keymap(ws->keyboard, WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1, fd,
+                                   (uint32_t)size);
+    close(fd);
+    return 0;
+}
+
+/* Creates the virtual keyboard and uploads the keymap on first use */
+static int wayland_keyboard_open(WaylandSession *ws) {
+    int rc = wayland_connect(ws);
+    if (rc != 0) return rc;
+    if (ws->keyboard) return 0;
+    if (!ws->keyboard_manager) return 8;
+
+    ws->keyboard = zwp_virtual_keyboard_manager_v1_create_virtual_keyboard(ws->keyboard_manager,
+                                                                           ws->seat);
+    /* Compositors that restrict the protocol raise unauthorized here, not at the first key */
+    if (upload_wayland_keymap(ws, wayland_keymap, sizeof(wayland_keymap)) < 0) {
+        wayland_session_close(ws);
+        return 8;
+    }
+    if (wayland_roundtrip(ws) < 0) return 8;
+    trace_mark(TRACE_DEVICE_READY);
+    return 0;
+}
+
+static uint32_t wayland_time_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+/*
+ * Each roundtrip returns once the compositor has processed everything sent
+ * before it, so the modifiers are applied before V arrives and V is released
+ * before the modifiers are, without guessing at sleeps.
+ */
+static int paste_via_wayland(WaylandSession *ws, int use_shift) {
+    int rc = wayland_keyboard_open(ws);
+    if (rc != 0) return rc;
+
+    if (ws->typing_keymap) {
+        if (upload_wayland_keymap(ws, wayland_keymap, sizeof(wayland_keymap)) < 0) return 8;
+        ws->typing_keymap = 0;
+    }
+
+    struct zwp_virtual_keyboard_v1 *kb = ws->keyboard;
+    uint32_t mods = WAYLAND_MOD_CONTROL | (use_shift ? WAYLAND_MOD_SHIFT : 0);
+
+    zwp_virtual_keyboard_v1_key(kb, wayland_time_ms(), KEY_LEFTCTRL,
+                                WL_KEYBOARD_KEY_STATE_PRESSED);
+    trace_mark(TRACE_KEY_DOWN);
+    if (use_shift)
+        zwp_virtual_keyboard_v1_key(kb, wayland_time_ms(), KEY_LEFTSHIFT,
+                                    WL_KEYBOARD_KEY_STATE_PRESSED);
+    zwp_virtual_keyboard_v1_modifiers(kb, mods, 0, 0, 0);
+    if (wayland_roundtrip(ws) < 0) return 8;
+
+    zwp_virtual_keyboard_v1_key(kb, wayland_time_ms(), KEY_V, WL_KEYBOARD_KEY_STATE_PRESSED);
+    zwp_virtual_keyboard_v1_key(kb, wayland_time_ms(), KEY_V, WL_KEYBOARD_KEY_STATE_RELEASED);
+    if (wayland_roundtrip(ws) < 0) return 8;
+
+    if (use_shift)
+        zwp_virtual_keyboard_v1_key(kb, wayland_time_ms(), KEY_LEFTSHIFT,
+                                    WL_KEYBOARD_KEY_STATE_RELEASED);
+    zwp_virtual_keyboard_v1_key(kb, wayland_time_ms(), KEY_LEFTCTRL,
+                                WL_KEYBOARD_KEY_STATE_RELEASED);
+    zwp_virtual_keyboard_v1_modifiers(kb, 0, 0, 0, 0);
+    trace_mark(TRACE_KEY_UP);
+    if (wayland_roundtrip(ws) < 0) return 8;
+    trace_mark(TRACE_FLUSH);
+    return 0;
+}
+
+/*
+ * Builds a keymap with one single-level key per keysym, at evdev codes 1..n.
+ * Returns a malloc'd string (size includes the NUL) or NULL.
+ */
+static char *build_typing_keymap(const KeySym *keys, int nkeys, size_t *size) {
+    char *text = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream(&text, &len);
+    if (!out) return NULL;
+
+    fputs("xkb_keymap {\n"
+          "  xkb_keycodes \"openwhispr-type\" {\n"
+          "    minimum = 8;\n"
+          "    maximum = 255;\n", out);
+    for (int i = 0; i < nkeys; i++) fprintf(out, "    <K%d> = %d;\n", i + 1, i + 1 + 8);
+    fputs("  };\n"
+          "  xkb_types \"openwhispr-type\" { include \"complete\" };\n"
+          "  xkb_compatibility \"openwhispr-type\" { include \"complete\" };\n"
+          "  xkb_symbols \"openwhispr-type\" {\n", out);
+    for (int i = 0; i < nkeys; i++) {
+        const char *name = XKeysymToString(keys[i]);
+        if (name) {
+            fprintf(out, "    key <K%d> { [ %s ] };\n", i + 1, name);
+        } else {
+            fprintf(out, "    key <K%d> { [ 0x%08lx ] };\n", i + 1, (unsigned long)keys[i]);
+        }
+    }
+    fputs("  };\n"
+          "};\n", out);
+
+    if (fclose(out) != 0) {
+        free(text);
+        return NULL;
+    }
+    *size = len + 1;
+    return text;
+}
+
+/*
+ * Types syms by uploading a keymap that holds exactly the keysyms needed
+ * (in chunks of WAYLAND_TYPE_KEYS_MAX distinct ones), so no layout or
+ * modifier is involved. The paste keymap comes back on the next paste.
+ * *partial is set when a failure comes after key events were sent.
+ */
+static int type_via_wayland(WaylandSession *ws, const KeySym *syms, size_t count,
+                            int *partial) {
+    int rc = wayland_keyboard_open(ws);
+    if (rc != 0) return rc;
+
+    struct zwp_virtual_keyboard_v1 *kb = ws->keyboard;
+    KeySym keys[WAYLAND_TYPE_KEYS_MAX];
+    size_t start = 0;
+    trace_mark(TRACE_KEY_DOWN);
+    while (start < count) {
+        int nkeys;
+        size_t end = plan_type_batch(syms, NULL, start, count, keys, WAYLAND_TYPE_KEYS_MAX,
+                                     &nkeys);
+        size_t size;
+        char *keymap = build_typing_keymap(keys, nkeys, &size);
+        if (!keymap) return 8;
+        rc = upload_wayland_keymap(ws, keymap, size);
+        free(keymap);
+        if (rc < 0) return 8;
+        ws->typing_keymap = 1;
+        zwp_virtual_keyboard_v1_modifiers(kb, 0, 0, 0, 0);
+        /* The compositor must have compiled the keymap before the first key */
+        if (wayland_roundtrip(ws) < 0) return 8;
+
+        for (size_t i = start; i < end; i++) {
+            uint32_t code = (uint32_t)type_slot(keys, nkeys, syms[i]) + 1;
+            zwp_virtual_keyboard_v1_key(kb, wayland_time_ms(), code,
+                                        WL_KEYBOARD_KEY_STATE_PRESSED);
+            zwp_virtual_keyboard_v1_key(kb, wayland_time_ms(), code,
+                                        WL_KEYBOARD_KEY_STATE_RELEASED);
+        }
+        *partial = 1;
+        start = end;
+    }
+    trace_mark(TRACE_KEY_UP);
+    if (wayland_roundtrip(ws) < 0) return 8;
+    trace_mark(TRACE_FLUSH);
+    return 0;
+}
+
+/* Opens the data-control device on first use; the first selection event arrives here */
+static int wayland_clipboard_open(WaylandSession *ws) {
+    int rc = wayland_connect(ws);
+    if (rc != 0) return rc;
+    if (ws->data_device) return 0;
+    if (!ws->data_control_manager) return 9;
+
+    ws->data_device = zwlr_data_control_manager_v1_get_data_device(ws->data_control_manager,
+                                                                    ws->seat);
+    zwlr_data_control_device_v1_add_listener(ws->data_device, &device_listener, ws);
+    return wayland_roundtrip(ws) < 0 ? 9 : 0;
+}
+
+/* Makes us the selection owner; the text is served until another client replaces it */
+static int wayland_set_clipboard(WaylandSession *ws, const char *text, size_t len) {
+    int rc = wayland_clipboard_open(ws);
+    if (rc != 0) return rc;
+
+    ClipboardSource *cs = (ClipboardSource *)malloc(sizeof(ClipboardSource));
+    char *copy = (char *)malloc(len ? len : 1);
+    if (!cs || !copy) {
+        free(cs);
+        free(copy);
+        return 9;
+    }
+    memcpy(copy, text, len);
+    cs->ws = ws;
+    cs->text = copy;
+    cs->len = len;
+
+    struct zwlr_data_control_source_v1 *source =
+        zwlr_data_control_manager_v1_create_data_source(ws->data_control_manager);
+    zwlr_data_control_source_v1_add_listener(source, &source_listener, cs);
+    for (int i = 0; text_mime_types[i]; i++)
+        zwlr_data_control_source_v1_offer(source, text_mime_types[i]);
+
+    /* The previous source, if ours, is cancelled by the compositor and freed then */
+    zwlr_data_control_device_v1_set_selection(ws->data_device, source);
+    ws->source = source;
+    return wayland_roundtrip(ws) < 0 ? 9 : 0;
+}
+
+/*
+ * Reads the current selection as text. Our own selection is answered from
+ * memory, since waiting on a pipe we are also supposed to fill would stall.
+ * *out is NULL when there is no text selection.
+ */
+static int wayland_read_clipboard(WaylandSession *ws, char **out, size_t *out_len) {
+    *out = NULL;
+    *out_len = 0;
+
+    int rc = wayland_clipboard_open(ws);
+    if (rc != 0) return rc;
+    if (wayland_roundtrip(ws) < 0) return 9;
+
+    if (ws->source) {
+        ClipboardSource *cs =
+            (ClipboardSource *)zwlr_data_control_source_v1_get_user_data(ws->source);
+        *out = (char *)malloc(cs->len + 1);
+        if (!*out) return 0;
+        memcpy(*out, cs->text, cs->len);
+        (*out)[cs->len] = '\0';
+        *out_len = cs->len;
+        return 0;
+    }
+
+    OfferInfo *info = ws->selection_offer
+                          ? (OfferInfo *)zwlr_data_control_offer_v1_get_user_data(
+                                ws->selection_offer)
+                          : NULL;
+    if (!info || info->text_rank < 0) return 0;
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) < 0) return 0;
+    zwlr_data_control_offer_v1_receive(ws->selection_offer, text_mime_types[info->text_rank],
+                                       fds[1]);
+    close(fds[1]);
+    wl_display_flush(ws->display);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t cap = 4096, len = 0;
+    char *buf = (char *)malloc(cap + 1);
+    while (buf) {
+        long remaining = CLIPBOARD_READ_TIMEOUT_MS - elapsed_ms_since(&start);
+        struct pollfd pfd = { .fd = fds[0], .events = POLLIN };
+        if (remaining <= 0 || poll(&pfd, 1, (int)remaining) <= 0) break;
+
+        ssize_t n = read(fds[0], buf + len, cap - len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        len += (size_t)n;
+        if (len == cap) {
+            char *grown = (char *)realloc(buf, cap * 2 + 1);
+            if (!grown) break;
+            buf = grown;
+            cap *= 2;
+        }
+    }
+    close(fds[0]);
+
+    if (buf) {
+        buf[len] = '\0';
+        *out = buf;
+        *out_len = len;
+    }
+    return 0;
+}
+
+/*
+ * Waits for fd (if not -1) to become readable while answering selection
+ * requests and flushing pending selection data. Returns 1 once fd is
+ * readable, 0 after handling Wayland work, and -1 when there is nothing
+ * left to wait for (fd is then readable or the caller should block on it).
+ */
+static int wayland_session_poll(WaylandSession *ws, int fd) {
+    if (!ws->display) return -1;
+    wl_display_dispatch_pending(ws->display);
+    wl_display_flush(ws->display);
+
+    size_t nsends = 0;
+    for (PendingSend *ps = ws->sends; ps; ps = ps->next) nsends++;
+    struct pollfd pfds[2 + nsends];
+    pfds[0] = (struct pollfd){ .fd = fd, .events = POLLIN };
+    pfds[1] = (struct pollfd){ .fd = wl_display_get_fd(ws->display), .events = POLLIN };
+    size_t i = 2;
+    for (PendingSend *ps = ws->sends; ps; ps = ps->next) {
+        pfds[i++] = (struct pollfd){ .fd = ps->fd, .events = POLLOUT };
+    }
+
+    if (poll(pfds, 2 + nsends, -1) < 0) return errno == EINTR ? 0 : -1;
+    if (nsends) wayland_flush_sends(ws);
+    if (pfds[1].revents && wl_display_dispatch(ws->display) < 0) wayland_session_close(ws);
+    return fd != -1 && pfds[0].revents ? 1 : 0;
+}
+
+static int wayland_fd_needed(const WaylandSession *ws, int fd) {
+    if (fd <= STDERR_FILENO || fd == wl_display_get_fd(ws->display)) return 1;
+    for (const PendingSend *ps = ws->sends; ps; ps = ps->next) {
+        if (ps->fd == fd) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Closes every descriptor the clipboard child inherited but does not need,
+ * such as the uinput keyboard and the X connection, so they go away with
+ * the server instead of living as long as the selection does
+ */
+static void wayland_close_other_fds(const WaylandSession *ws) {
+    int fds[256];
+    int count;
+    /* Closed after the directory, in rounds should there be more than fit */
+    do {
+        DIR *dir = opendir("/proc/self/fd");
+        if (!dir) return;
+        count = 0;
+        struct dirent *entry;
+        while (count < (int)(sizeof(fds) / sizeof(fds[0])) && (entry = readdir(dir))) {
+            if (entry->d_name[0] < '0' || entry->d_name[0] > '9') continue;
+            int fd = atoi(entry->d_name);
+            if (fd != dirfd(dir) && !wayland_fd_needed(ws, fd)) fds[count++] = fd;
+        }
+        closedir(dir);
+        for (int i = 0; i < count; i++) close(fds[i]);
+    } while (count == (int)(sizeof(fds) / sizeof(fds[0])));
+}
+
+/*
+ * Keeps serving our selection after the server exits, the way wl-copy's
+ * background process does, so the clipboard survives the app quitting.
+ * Returns 1 in the parent once a child has taken the connection over.
+ */
+static int wayland_clipboard_detach(WaylandSession *ws) {
+    if (!ws->source && !ws->sends) return 0;
+
+    pid_t pid = fork();
+    if (pid < 0) return 0;
+    if (pid > 0) return 1;
+
+    setsid();
+    int devnull = open("/dev/null", O_RDWR);
+    if (devnull >= 0) {
+        dup2(devnull, STDIN_FILENO);
+        dup2(devnull, STDOUT_FILENO);
+        dup2(devnull, STDERR_FILENO);
+        if (devnull > STDERR_FILENO) close(devnull);
+    }
+    wayland_close_other_fds(ws);
+    while ((ws->source || ws->sends) && wayland_session_poll(ws, -1) >= 0) {
+    }
+    _exit(0);
+}
+#endif
+
+/* Parses paste flags; unknown flags are ignored like in one-shot mode */
+static void parse_paste_args(int argc, char *argv[], PasteRequest *req) {
+    memset(req, 0, sizeof(*req));
+    req->target_window = None;
+    req->activate_timeout_ms = ACTIVATE_TIMEOUT_MS;
+    req->key_delay_ms = -1;
+    req->settle_ms = -1;
+    req->clipboard_timeout_ms = CLIPBOARD_TIMEOUT_MS;
+
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--terminal") == 0) {
+            req->force_terminal = 1;
+        } else if (strcmp(argv[i], "--uinput") == 0) {
+            req->use_uinput = 1;
+        } else if (strcmp(argv[i], "--wayland") == 0) {
+            req->use_wayland = 1;
+        } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            req->target_window = (Window)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--activate-timeout") == 0 && i + 1 < argc) {
+            req->activate_timeout_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--key-delay") == 0 && i + 1 < argc) {
+            req->key_delay_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--settle") == 0 && i + 1 < argc) {
+            req->settle_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--timing") == 0) {
+            req->timing = 1;
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            req->trace = 1;
+        } else if (strcmp(argv[i], "--clipboard-stdin") == 0) {
+            req->clipboard_stdin = 1;
+        } else if (strcmp(argv[i], "--clipboard-bytes") == 0 && i + 1 < argc) {
+            req->clipboard_bytes = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--clipboard-timeout") == 0 && i + 1 < argc) {
+            req->clipboard_timeout_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--type") == 0) {
+            req->type_stdin = 1;
+        } else if (strcmp(argv[i], "--text-bytes") == 0 && i + 1 < argc) {
+            req->text_bytes = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--begin") == 0) {
+            req->revise_begin = 1;
+        }
+    }
+}
+
+/*
+ * Types syms with the requested backend. XTest and uinput check everything
+ * before the first key, so only Wayland can fail with *partial set, meaning
+ * some of the keys may have been typed.
+ */
+static int type_keysyms(PasteContext *ctx, const PasteRequest *req, const KeySym *syms,
+                        size_t count, int *partial) {
+    int rc;
+    *partial = 0;
+    if (req->use_uinput) {
+        trace_begin(req, "uinput");
+#ifdef HAVE_UINPUT
+        rc = type_via_uinput(ctx, req, syms, count);
+#else
+        fprintf(stderr, "uinput support not compiled in\n");
+        rc = 3;
+#endif
+    } else if (req->use_wayland) {
+        trace_begin(req, "wayland");
+#ifdef HAVE_WAYLAND
+        rc = type_via_wayland(&ctx->wayland, syms, count, partial);
+#else
+        fprintf(stderr, "Wayland support not compiled in\n");
+        rc = 7;
+#endif
+    } else {
+        trace_begin(req, "xtest");
+        rc = type_via_xtest(&ctx->x, req, syms, count);
+    }
+    return rc;
+}
+
+/* Types req->text instead of pasting it */
+static int run_type(PasteContext *ctx, const PasteRequest *req) {
+    KeySym *syms = (KeySym *)malloc((req->text_len ? req->text_len : 1) * sizeof(KeySym));
+    if (!syms) return 10;
+    size_t count = text_to_keysyms(req->text, req->text_len, syms);
+    int partial;
+    int rc = type_keysyms(ctx, req, syms, count, &partial);
+    free(syms);
+    return rc;
+}
+
+static int is_utf8_continuation(unsigned char c) {
+    return (c & 0xc0) == 0x80;
+}
+
+/*
+ * Brings the text earlier REVISE commands typed to req->text with the
+ * smallest edit: BackSpace over everything after the common prefix, then
+ * the rest of the new text, sent as one run of key events. The cost follows
+ * the size of the edit, not the length of the transcript. A revision that
+ * fails before its first key leaves the typed text as it was, so it can be
+ * retried. One that fails partway leaves the field in an unknown state; the
+ * stream then refuses further revisions (11) until the next --begin.
+ */
+static int run_revise(PasteContext *ctx, const PasteRequest *req) {
+    RevisionState *rs = &ctx->revision;
+    if (req->revise_begin) {
+        free(rs->text);
+        rs->text = NULL;
+        rs->len = 0;
+        rs->desynced = 0;
+    }
+    if (rs->desynced) return 11;
+
+    const char *target = req->text;
+    size_t prefix = 0;
+    while (prefix < rs->len && prefix < req->text_len && rs->text[prefix] == target[prefix])
+        prefix++;
+    /* A character that only partly matches is erased and retyped whole */
+    while (prefix > 0 &&
+           ((prefix < rs->len && is_utf8_continuation((unsigned char)rs->text[prefix])) ||
+            (prefix < req->text_len && is_utf8_continuation((unsigned char)target[prefix]))))
+        prefix--;
+
+    size_t old_tail = rs->len - prefix;
+    size_t new_tail = req->text_len - prefix;
+    KeySym *syms = (KeySym *)malloc((old_tail + new_tail + 1) * sizeof(KeySym));
+    if (!syms) return 10;
+
+    /* One BackSpace per key the old tail was typed with */
+    size_t erase = text_to_keysyms(rs->text + prefix, old_tail, syms);
+    for (size_t i = 0; i < erase; i++) syms[i] = XK_BackSpace;
+    size_t count = erase + text_to_keysyms(target + prefix, new_tail, syms + erase);
+
+    int partial = 0;
+    int rc = count > 0 ? type_keysyms(ctx, req, syms, count, &partial) : 0;
+    free(syms);
+    if (rc != 0) {
+        rs->desynced = partial;
+        return rc;
+    }
+
+    char *copy = (char *)realloc(rs->text, req->text_len ? req->text_len : 1);
+    if (!copy) return 10;
+    memcpy(copy, target, req->text_len);
+    rs->text = copy;
+    rs->len = req->text_len;
+    return 0;
+}
+
+static int run_paste(PasteContext *ctx, const PasteRequest *req, PasteResult *result) {
+    memset(result, 0, sizeof(*result));
+    result->consumed_ms = -1;
+
+    if (req->text) return run_type(ctx, req);
+
+    if (req->use_uinput) {
+        trace_begin(req, "uinput");
+#ifdef HAVE_UINPUT
+        return paste_via_uinput(&ctx->uinput, req->force_terminal);
+#else
+        fprintf(stderr, "uinput support not compiled in\n");
+        return 3;
+#endif
+    }
+    if (req->use_wayland) {
+        trace_begin(req, "wayland");
+#ifdef HAVE_WAYLAND
+        return paste_via_wayland(&ctx->wayland, req->force_terminal);
+#else
+        fprintf(stderr, "Wayland support not compiled in\n");
+        return 7;
+#endif
+    }
+    trace_begin(req, "xtest");
+    return paste_via_xtest(&ctx->x, req, result);
+}
+
+/* Prints the clipboard outcome line; false if the paste did not serve CLIPBOARD */
+static int print_clipboard_result(const PasteResult *result) {
+    if (!result->served_clipboard) return 0;
+    if (result->consumed_ms >= 0) {
+        printf("CONSUMED %ld\n", result->consumed_ms);
+    } else {
+        printf("TIMEOUT\n");
+    }
+    return 1;
+}
+
+/* Opens the requested backend ahead of the first paste */
+static int prepare_backend(PasteContext *ctx, const PasteRequest *req) {
+    if (req->use_uinput) {
+#ifdef HAVE_UINPUT
+        return uinput_keyboard_open(&ctx->uinput);
+#else
+        return 3;
+#endif
+    }
+    if (req->use_wayland) {
+#ifdef HAVE_WAYLAND
+        return wayland_keyboard_open(&ctx->wayland);
+#else
+        return 7;
+#endif
+    }
+    return xpaster_open(&ctx->x);
+}
+
+static void paste_context_close(PasteContext *ctx, int drain_uinput) {
+#ifdef HAVE_UINPUT
+    if (ctx->uinput.fd >= 0 && drain_uinput) {
+        /* Destroying the device discards events readers have not consumed yet */
+        usleep(20000);
+    }
+    uinput_keyboard_close(&ctx->uinput);
+#else
+    (void)drain_uinput;
+#endif
+#ifdef HAVE_WAYLAND
+    wayland_session_close(&ctx->wayland);
+#endif
+    xpaster_close(&ctx->x);
+    free(ctx->revision.text);
+    ctx->revision.text = NULL;
+    ctx->revision.len = 0;
+    output_buffer_free(&ctx->reply);
+    trace_mark(TRACE_TEARDOWN);
+}
+
+static const char *paste_error_message(int code) {
+    switch (code) {
+        case 1: return "cannot open display";
+        case 2: return "XTest extension not available";
+        case 3: return "uinput unavailable";
+        case 4: return "uinput device setup failed";
+        case 5: return "cannot own CLIPBOARD";
+        case 6: return "clipboard text too large";
+        case 7: return "Wayland unavailable";
+        case 8: return "virtual keyboard protocol unavailable";
+        case 9: return "data-control protocol unavailable";
+        case 10: return "text cannot be typed";
+        case 11: return "revision state lost, restart with --begin";
+        default: return "paste failed";
+    }
+}
+
+/* Writes s as a JSON string literal (or null) */
+static void json_string(FILE *out, const char *s) {
+    if (!s) {
+        fputs("null", out);
+        return;
+    }
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(out, "\\%c", *p);
+        } else if (*p < 0x20) {
+            fprintf(out, "\\u%04x", *p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static int command_in_path(const char *name) {
+    const char *path = getenv("PATH");
+    if (!path) return 0;
+
+    char candidate[4096];
+    const char *dir = path;
+    while (*dir) {
+        const char *end = strchr(dir, ':');
+        size_t dir_len = end ? (size_t)(end - dir) : strlen(dir);
+        if (dir_len > 0 &&
+            snprintf(candidate, sizeof(candidate), "%.*s/%s", (int)dir_len, dir, name) <
+                (int)sizeof(candidate) &&
+            access(candidate, X_OK) == 0) {
+            return 1;
+        }
+        if (!end) break;
+        dir = end + 1;
+    }
+    return 0;
+}
+
+/* A socket file outlives a crashed daemon; only a successful connect proves it is alive */
+static int unix_socket_alive(const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) return 0;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    /* ydotoold 1.x listens on a datagram socket, 0.1.x on a stream socket */
+    int types[] = { SOCK_DGRAM, SOCK_STREAM };
+    for (int i = 0; i < 2; i++) {
+        int fd = socket(AF_UNIX, types[i] | SOCK_CLOEXEC, 0);
+        if (fd < 0) continue;
+        int ok = connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+        close(fd);
+        if (ok) return 1;
+    }
+    return 0;
+}
+
+/* First ydotool socket that exists, in the order ydotool itself looks */
+static const char *find_ydotool_socket(char *buf, size_t buf_len) {
+    const char *env = getenv("YDOTOOL_SOCKET");
+    if (env && access(env, F_OK) == 0) return env;
+
+    snprintf(buf, buf_len, "/run/user/%u/.ydotool_socket", (unsigned)getuid());
+    if (access(buf, F_OK) == 0) return buf;
+    if (access("/tmp/.ydotool_socket", F_OK) == 0) return "/tmp/.ydotool_socket";
+    return NULL;
+}
+
+/* Names the compositor by the process on the other end of its Wayland socket */
+static int wayland_compositor_name(char *out, size_t out_len) {
+    const char *display = getenv("WAYLAND_DISPLAY");
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    if (!display) return 0;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    int n = display[0] == '/'
+                ? snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", display)
+                : snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/%s",
+                           runtime ? runtime : "", display);
+    if (n < 0 || n >= (int)sizeof(addr.sun_path)) return 0;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return 0;
+
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
+    int ok = connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+             getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) == 0;
+    close(fd);
+    if (!ok) return 0;
+
+    char comm_path[64];
+    snprintf(comm_path, sizeof(comm_path), "/proc/%d/comm", (int)cred.pid);
+    FILE *f = fopen(comm_path, "r");
+    if (!f) return 0;
+    ok = fgets(out, (int)out_len, f) != NULL;
+    fclose(f);
+    if (ok) out[strcspn(out, "\n")] = '\0';
+    return ok;
+}
+
+/* Reads a UTF8_STRING/STRING property; caller frees with XFree */
+static char *get_text_property(Display *dpy, Window win, const char *name) {
+    Atom prop = XInternAtom(dpy, name, True);
+    if (prop == None) return NULL;
+
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems, bytes_after;
+    unsigned char *data = NULL;
+    if (XGetWindowProperty(dpy, win, prop, 0, 1024, False, AnyPropertyType, &actual_type,
+                           &actual_format, &nitems, &bytes_after, &data) != Success) {
+        return NULL;
+    }
+    if (data && (actual_format != 8 || nitems == 0)) {
+        XFree(data);
+        return NULL;
+    }
+    return (char *)data;
+}
+
+static Window get_window_property(Display *dpy, Window win, const char *name) {
+    Atom prop = XInternAtom(dpy, name, True);
+    if (prop == None) return None;
+
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems, bytes_after;
+    unsigned char *data = NULL;
+    Window result = None;
+    if (XGetWindowProperty(dpy, win, prop, 0, 1, False, XA_WINDOW, &actual_type,
+                           &actual_format, &nitems, &bytes_after, &data) == Success && data) {
+        if (nitems > 0) result = *(Window *)data;
+        XFree(data);
+    }
+    return result;
+}
+
+/*
+ * Prints the active window as JSON: id, WM_CLASS (class and instance),
+ * _NET_WM_PID, executable name and the terminal verdict the paste would
+ * use, or null without an X11 display or active window.
+ */
+static void print_active_window(FILE *out, Display *dpy) {
+    Window win = dpy ? get_active_window(dpy) : None;
+    if (win == None || win == PointerRoot) {
+        fputs("null", out);
+        return;
+    }
+
+    XClassHint hint = { NULL, NULL };
+    XGetClassHint(dpy, win, &hint);
+    long pid = get_window_pid(dpy, win);
+    char exe[256];
+    int have_exe = get_process_exe(pid, exe, sizeof(exe));
+    int terminal = is_terminal_window(hint.res_class, hint.res_name, have_exe ? exe : NULL);
+
+    fprintf(out, "{\"id\":%lu,\"class\":", (unsigned long)win);
+    json_string(out, hint.res_class);
+    fputs(",\"instance\":", out);
+    json_string(out, hint.res_name);
+    fprintf(out, ",\"pid\":%ld,\"exe\":", pid);
+    json_string(out, have_exe ? exe : NULL);
+    fprintf(out, ",\"terminal\":%s}", terminal ? "true" : "false");
+
+    if (hint.res_name) XFree(hint.res_name);
+    if (hint.res_class) XFree(hint.res_class);
+}
+
+/* Replies to --query-active / QUERY with one JSON line */
+static void print_query_active(PasteContext *ctx) {
+    Display *dpy = NULL;
+    Display *own = NULL;
+    if (xpaster_open(&ctx->x) == 0) {
+        dpy = ctx->x.dpy;
+        xpaster_process_events(&ctx->x);
+    } else {
+        /* The window query only needs the display, not XTest */
+        own = XOpenDisplay(NULL);
+        if (own) XSetErrorHandler(ignore_x_error);
+        dpy = own;
+    }
+
+    print_active_window(stdout, dpy);
+    fputc('\n', stdout);
+    if (own) XCloseDisplay(own);
+}
+
+/* Name of the X11 window manager (Mutter, KWin, ...) from _NET_SUPPORTING_WM_CHECK */
+static char *get_wm_name(Display *dpy) {
+    Window check = get_window_property(dpy, DefaultRootWindow(dpy), "_NET_SUPPORTING_WM_CHECK");
+    if (check == None) return NULL;
+    char *name = get_text_property(dpy, check, "_NET_WM_NAME");
+    return name ? name : get_text_property(dpy, check, "WM_NAME");
+}
+
+/*
+ * Prints everything the paste strategy depends on as a single-line JSON
+ * document, so the caller can decide once instead of spawning a check per
+ * tool on every paste. Everything except active_window stays valid for
+ * cache.ttl_ms or until the cache.env key changes.
+ */
+static void print_probe(PasteContext *ctx) {
+    FILE *out = stdout;
+    const char *session_type = getenv("XDG_SESSION_TYPE");
+    const char *desktop = getenv("XDG_CURRENT_DESKTOP");
+    const char *x_display = getenv("DISPLAY");
+    const char *wl_display = getenv("WAYLAND_DISPLAY");
+
+    int xtest_rc = xpaster_open(&ctx->x);
+    Display *dpy = NULL;
+    Display *own = NULL;
+    if (xtest_rc == 0) {
+        dpy = ctx->x.dpy;
+        xpaster_process_events(&ctx->x);
+    } else {
+        /* The window manager and active window still need reporting without XTest */
+        own = XOpenDisplay(NULL);
+        if (own) XSetErrorHandler(ignore_x_error);
+        dpy = own;
+    }
+
+    char compositor[256];
+    int have_compositor = wayland_compositor_name(compositor, sizeof(compositor));
+
+    fputs("{\"version\":1", out);
+
+    fputs(",\"session\":{\"type\":", out);
+    json_string(out, session_type);
+    fputs(",\"desktop\":", out);
+    json_string(out, desktop);
+    fprintf(out, ",\"x11\":%s,\"wayland\":%s,\"xwayland\":%s}",
+            x_display ? "true" : "false", wl_display ? "true" : "false",
+            x_display && wl_display ? "true" : "false");
+
+    fputs(",\"compositor\":", out);
+    json_string(out, have_compositor ? compositor : NULL);
+    fputs(",\"wm\":", out);
+    char *wm_name = dpy ? get_wm_name(dpy) : NULL;
+    json_string(out, wm_name);
+    if (wm_name) XFree(wm_name);
+
+    fprintf(out, ",\"xtest\":%s", xtest_rc == 0 ? "true" : "false");
+
+#ifdef HAVE_UINPUT
+    int uinput_compiled = 1;
+#else
+    int uinput_compiled = 0;
+#endif
+    fprintf(out, ",\"uinput\":{\"compiled\":%s,\"writable\":%s}",
+            uinput_compiled ? "true" : "false",
+            access("/dev/uinput", W_OK) == 0 ? "true" : "false");
+
+#ifdef HAVE_WAYLAND
+    int have_wayland = wl_display && wayland_connect(&ctx->wayland) == 0;
+    fprintf(out, ",\"wayland_protocols\":{\"compiled\":true,\"virtual_keyboard\":%s,"
+                 "\"data_control\":%s}",
+            have_wayland && ctx->wayland.keyboard_manager ? "true" : "false",
+            have_wayland && ctx->wayland.data_control_manager ? "true" : "false");
+#else
+    fputs(",\"wayland_protocols\":{\"compiled\":false,\"virtual_keyboard\":false,"
+          "\"data_control\":false}", out);
+#endif
+
+    static const char *const tools[] = {
+        "xdotool", "wtype", "ydotool", "wl-copy", "kdotool", "qdbus", "qdbus6", NULL
+    };
+    fputs(",\"tools\":{", out);
+    for (int i = 0; tools[i]; i++) {
+        fprintf(out, "%s\"%s\":%s", i ? "," : "", tools[i],
+                command_in_path(tools[i]) ? "true" : "false");
+    }
+    fputc('}', out);
+
+    char socket_buf[128];
+    const char *ydotool_socket = find_ydotool_socket(socket_buf, sizeof(socket_buf));
+    fputs(",\"ydotool\":{\"socket\":", out);
+    json_string(out, ydotool_socket);
+    fprintf(out, ",\"alive\":%s}",
+            ydotool_socket && unix_socket_alive(ydotool_socket) ? "true" : "false");
+
+    fputs(",\"active_window\":", out);
+    print_active_window(out, dpy);
+
+    fprintf(out, ",\"cache\":{\"ttl_ms\":%d,\"env\":", PROBE_CACHE_TTL_MS);
+    char env_key[1024];
+    snprintf(env_key, sizeof(env_key), "%s|%s|%s|%s", x_display ? x_display : "",
+             wl_display ? wl_display : "", session_type ? session_type : "",
+             desktop ? desktop : "");
+    json_string(out, env_key);
+    fputs("}}\n", out);
+    if (own) XCloseDisplay(own);
+}
+
+
+/* Reads stdin to EOF for one-shot --clipboard-stdin */
+static char *read_all(FILE *in, size_t *out_len) {
+    size_t cap = 4096, len = 0;
+    char *buf = (char *)malloc(cap);
+    if (!buf) return NULL;
+
+    size_t n;
+    while ((n = fread(buf + len, 1, cap - len, in)) > 0) {
+        len += n;
+        if (len == cap) {
+            char *grown = (char *)realloc(buf, cap * 2);
+            if (!grown) {
+                free(buf);
+                return NULL;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+    }
+
+    *out_len = len;
+    return buf;
+}
+
+static int copy_to_clipboard(PasteContext *ctx, const char *text, size_t len) {
+#ifdef HAVE_WAYLAND
+    return wayland_set_clipboard(&ctx->wayland, text, len);
+#else
+    (void)ctx;
+    (void)text;
+    (void)len;
+    return 7;
+#endif
+}
+
+/* Replies to READ with DATA <base64>, EMPTY or ERR */
+static void print_clipboard_contents(PasteContext *ctx) {
+#ifdef HAVE_WAYLAND
+    char *text = NULL;
+    size_t len = 0;
+    int rc = wayland_read_clipboard(&ctx->wayland, &text, &len);
+    if (rc != 0) {
+        printf("ERR %d %s\n", rc, paste_error_message(rc));
+        return;
+    }
+    if (!text) {
+        printf("EMPTY\n");
+        return;
+    }
+
+    OutputBuffer *reply = &ctx->reply;
+    reply->len = 0;
+    int ok = output_buffer_append(reply, "DATA ", 5) == 0 &&
+             base64_append(reply, (const unsigned char *)text, len) == 0 &&
+             output_buffer_append(reply, "\n", 1) == 0;
+    free(text);
+    if (ok) {
+        fwrite(reply->data, 1, reply->len, stdout);
+    } else {
+        printf("ERR 0 out of memory\n");
+    }
+#else
+    (void)ctx;
+    printf("ERR 7 %s\n", paste_error_message(7));
+#endif
+}
+
+/*
+ * Serve-mode stdin, read with read() in chunks so that poll() sees every
+ * byte we have not consumed yet; stdio would buffer them out of its sight.
+ */
+typedef struct {
+    char *data;
+    size_t start;  /* first unconsumed byte */
+    size_t len;
+    size_t cap;
+} CommandInput;
+
+/* Blocks until stdin is readable, answering Wayland selection requests meanwhile */
+static void wait_for_input(PasteContext *ctx) {
+#ifdef HAVE_WAYLAND
+    while (wayland_session_poll(&ctx->wayland, STDIN_FILENO) == 0) {
+    }
+#else
+    (void)ctx;
+#endif
+}
+
+/* Returns the next command line, valid until the next call; NULL on EOF */
+static char *next_command(PasteContext *ctx, CommandInput *in) {
+    for (;;) {
+        char *line = in->data + in->start;
+        char *newline = in->len > in->start ? memchr(line, '\n', in->len - in->start) : NULL;
+        if (newline) {
+            if (newline > line && newline[-1] == '\r') newline[-1] = '\0';
+            *newline = '\0';
+            in->start = (size_t)(newline - in->data) + 1;
+            return line;
+        }
+
+        /* Keep the partial line and make room for the rest */
+        if (in->start) {
+            memmove(in->data, line, in->len - in->start);
+            in->len -= in->start;
+            in->start = 0;
+        }
+        if (in->len == in->cap) {
+            size_t cap = in->cap ? in->cap * 2 : 4096;
+            char *grown = (char *)realloc(in->data, cap);
+            if (!grown) return NULL;
+            in->data = grown;
+            in->cap = cap;
+        }
+
+        wait_for_input(ctx);
+        ssize_t n = read(STDIN_FILENO, in->data + in->len, in->cap - in->len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return NULL;
+        in->len += (size_t)n;
+    }
+}
+
+/* Reads exactly len bytes of length-framed payload; NULL on EOF or OOM */
+static char *read_payload(PasteContext *ctx, CommandInput *in, size_t len) {
+    char *buf = (char *)malloc(len + 1);
+    if (!buf) return NULL;
+
+    size_t have = in->len - in->start;
+    if (have > len) have = len;
+    if (have) memcpy(buf, in->data + in->start, have);
+    in->start += have;
+    while (have < len) {
+        wait_for_input(ctx);
+        ssize_t n = read(STDIN_FILENO, buf + have, len - have);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            free(buf);
+            return NULL;
+        }
+        have += (size_t)n;
+    }
+    buf[len] = '\0';
+    return buf;
+}
+
+static int serve(PasteContext *ctx) {
+    CommandInput in = { 0 };
+    char *line;
+
+#ifdef HAVE_WAYLAND
+    /* A reader closing its pipe early must not kill the server */
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    printf("READY\n");
+    fflush(stdout);
+
+    while ((line = next_command(ctx, &in)) != NULL) {
+        char *args[MAX_COMMAND_ARGS];
+        int nargs = 0;
+        char *save = NULL;
+        for (char *tok = strtok_r(line, " \t", &save);
+             tok && nargs < MAX_COMMAND_ARGS;
+             tok = strtok_r(NULL, " \t", &save)) {
+            args[nargs++] = tok;
+        }
+        if (nargs == 0) continue;
+
+        struct timespec received;
+        clock_gettime(CLOCK_MONOTONIC, &received);
+
+        if (strcmp(args[0], "QUIT") == 0) {
+            break;
+        } else if (strcmp(args[0], "PING") == 0) {
+            printf("PONG\n");
+        } else if (strcmp(args[0], "QUERY") == 0) {
+            print_query_active(ctx);
+        } else if (strcmp(args[0], "PROBE") == 0) {
+            print_probe(ctx);
+        } else if (strcmp(args[0], "READ") == 0) {
+            print_clipboard_contents(ctx);
+        } else if (strcmp(args[0], "COPY") == 0) {
+            PasteRequest req;
+            parse_paste_args(nargs - 1, args + 1, &req);
+
+            size_t text_len = req.clipboard_bytes > 0 ? (size_t)req.clipboard_bytes : 0;
+            char *payload = text_len ? read_payload(ctx, &in, text_len) : NULL;
+            if (text_len && !payload) break;
+
+            int rc = copy_to_clipboard(ctx, payload ? payload : "", text_len);
+            free(payload);
+            if (rc == 0) {
+                printf("OK\n");
+            } else {
+                printf("ERR %d %s\n", rc, paste_error_message(rc));
+            }
+        } else if (strcmp(args[0], "TYPE") == 0 || strcmp(args[0], "REVISE") == 0) {
+            PasteRequest req;
+            parse_paste_args(nargs - 1, args + 1, &req);
+            req.started = received;
+
+            size_t text_len = req.text_bytes > 0 ? (size_t)req.text_bytes : 0;
+            char *payload = text_len ? read_payload(ctx, &in, text_len) : NULL;
+            if (text_len && !payload) break;
+            req.text = payload ? payload : "";
+            req.text_len = text_len;
+
+            PasteResult result;
+            int rc = args[0][0] == 'T' ? run_paste(ctx, &req, &result) : run_revise(ctx, &req);
+            free(payload);
+            trace_report(rc);
+            if (rc == 0) {
+                printf("OK\n");
+            } else {
+                printf("ERR %d %s\n", rc, paste_error_message(rc));
+            }
+        } else if (strcmp(args[0], "PASTE") == 0 || strcmp(args[0], "PREPARE") == 0) {
+            PasteRequest req;
+            parse_paste_args(nargs - 1, args + 1, &req);
+            req.started = received;
+
+            char *payload = NULL;
+            if (req.clipboard_bytes > 0) {
+                payload = read_payload(ctx, &in, (size_t)req.clipboard_bytes);
+                if (!payload) break;
+                req.clipboard_data = payload;
+                req.clipboard_len = (size_t)req.clipboard_bytes;
+            }
+
+            PasteResult result = { 0, -1 };
+            int rc = args[0][1] == 'A' ? run_paste(ctx, &req, &result)
+                                       : prepare_backend(ctx, &req);
+            free(payload);
+            trace_report(rc);
+            if (rc == 0) {
+                if (!print_clipboard_result(&result)) printf("OK\n");
+            } else {
+                printf("ERR %d %s\n", rc, paste_error_message(rc));
+            }
+        } else {
+            printf("ERR 0 unknown command %s\n", args[0]);
+        }
+        fflush(stdout);
+    }
+
+    free(in.data);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    PasteContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.uinput.fd = -1;
+    terminal_matcher_init(&terminal_matcher, TERMINAL_PLATFORM_LINUX);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--query-active") == 0) {
+            print_query_active(&ctx);
+            paste_context_close(&ctx, 0);
+            return 0;
+        }
+        if (strcmp(argv[i], "--probe") == 0) {
+            print_probe(&ctx);
+            paste_context_close(&ctx, 0);
+            return 0;
+        }
+        if (strcmp(argv[i], "--serve") == 0) {
+            int rc = serve(&ctx);
+#ifdef HAVE_WAYLAND
+            /* The forked child owns the Wayland connection now; only drop our copy */
+            if (wayland_clipboard_detach(&ctx.wayland))
+                memset(&ctx.wayland, 0, sizeof(ctx.wayland));
+#endif
+            paste_context_close(&ctx, 0);
+            return rc;
+        }
+    }
+
+    PasteRequest req;
+    parse_paste_args(argc - 1, argv + 1, &req);
+    req.started = started;
+
+    char *payload = NULL;
+    if (req.type_stdin) {
+        payload = read_all(stdin, &req.text_len);
+        req.text = payload ? payload : "";
+    } else if (req.clipboard_stdin) {
+        payload = read_all(stdin, &req.clipboard_len);
+        req.clipboard_data = payload;
+    }
+
+    PasteResult result;
+    int rc = run_paste(&ctx, &req, &result);
+    if (rc == 0) print_clipboard_result(&result);
+    paste_context_close(&ctx, 1);
+    trace_report(rc);
+    free(payload);
+    return rc;
+}
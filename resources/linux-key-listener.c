@@ -0,0 +1,699 @@
+/**
+ * Linux Key Listener for Push-to-Talk
+ *
+ * Reports presses and releases of a hotkey on X11 from XInput2 raw key
+ * events (XI_RawKeyPress/XI_RawKeyRelease on the root window), so both the
+ * key down and the key up are seen without grabbing or polling the keyboard.
+ * Raw events reach clients that speak XI 2.1 even while another client holds
+ * a grab, e.g. the globalShortcut registration of the same accelerator.
+ *
+ * --evdev reads the kernel's input devices instead, for Wayland sessions
+ * where no X server sees global key events. Every /dev/input/event* device
+ * that has one of the hotkey's keys is watched through one epoll set, and an
+ * inotify watch on /dev/input adds keyboards plugged in later. Reading the
+ * devices needs membership of the input group (or an equivalent ACL).
+ * linux-fast-paste's own virtual keyboard is skipped, so the keys a paste
+ * or live typing injects can never trigger the hotkey.
+ *
+ * Usage:
+ *   linux-key-listener [--evdev] <hotkey>
+ *
+ * The hotkey uses the same syntax as windows-key-listener.c: an optional list
+ * of modifiers (CommandOrControl/Control/Ctrl, Alt/Option, Shift,
+ * Super/Meta/Win/Command/Cmd) and a main key joined with '+', e.g. "F8",
+ * "`", "RightControl", "Control+Shift+Space" or "Control+Super". Main keys
+ * are matched on the unshifted keysym of the active layout; names the
+ * Windows listener does not know are tried as X keysym names ("Menu").
+ * evdev has no layout, so --evdev matches main keys on their US QWERTY
+ * position and only knows the names the Windows listener knows.
+ *
+ * Output (stdout, one line each):
+ *   READY     - Listening
+ *   KEY_DOWN  - Hotkey pressed (main key down with all modifiers held, or in
+ *               modifier-only mode, the last required modifier pressed)
+ *   KEY_UP    - Main key or a required modifier released
+ *
+ * Exits 1 on an invalid hotkey, when XInput 2.1 is unavailable or, with
+ * --evdev, when no input device can be read, and when the parent process dies.
+ *
+ * Compile with: gcc -O2 linux-key-listener.c -o linux-key-listener -lX11 -lXi
+ * Add -DHAVE_EVDEV for --evdev (needs linux/input.h).
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XInput2.h>
+#include <X11/keysym.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/prctl.h>
+#include <unistd.h>
+
+#ifdef HAVE_EVDEV
+#include <linux/input.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#endif
+
+/* Covers X keycodes (8-255) and evdev key codes (up to KEY_MAX) */
+#define KEYCODES 768
+#define EVDEV_DEVICES_MAX 64
+#define EVDEV_EVENTS_PER_READ 64
+/* The uinput keyboard linux-fast-paste creates (uinput_keyboard_open) */
+#define PASTE_DEVICE_NAME "openwhispr-paste"
+
+/*
+ * Physical modifier keys, one bit each in Hotkey.mods_held. A modifier class
+ * (as in Hotkey.required) is the pair of its left and right bits.
+ */
+#define MODKEY_CTRL_L  (1u << 0)
+#define MODKEY_CTRL_R  (1u << 1)
+#define MODKEY_ALT_L   (1u << 2)
+#define MODKEY_ALT_R   (1u << 3)
+#define MODKEY_SHIFT_L (1u << 4)
+#define MODKEY_SHIFT_R (1u << 5)
+#define MODKEY_SUPER_L (1u << 6)
+#define MODKEY_SUPER_R (1u << 7)
+#define MOD_CTRL  (MODKEY_CTRL_L | MODKEY_CTRL_R)
+#define MOD_ALT   (MODKEY_ALT_L | MODKEY_ALT_R)
+#define MOD_SHIFT (MODKEY_SHIFT_L | MODKEY_SHIFT_R)
+#define MOD_SUPER (MODKEY_SUPER_L | MODKEY_SUPER_R)
+
+/* Key codes are X keycodes, or evdev codes with --evdev */
+typedef struct {
+    KeySym target;              /* NoSymbol in modifier-only mode */
+    unsigned required;
+    int modifiers_only;
+    int is_down;
+    unsigned mods_held;         /* MODKEY_* bits of the modifiers held down */
+    uint64_t held[KEYCODES / 64];
+    unsigned char key_mod[KEYCODES];    /* MODKEY_* bit of each key code */
+    unsigned char key_target[KEYCODES]; /* Key code produces the main key */
+} Hotkey;
+
+typedef struct {
+    const char *name;
+    KeySym sym;
+} NamedKey;
+
+static const NamedKey named_keys[] = {
+    { "Pause", XK_Pause },
+    { "ScrollLock", XK_Scroll_Lock },
+    { "Insert", XK_Insert },
+    { "Home", XK_Home },
+    { "End", XK_End },
+    { "PageUp", XK_Prior },
+    { "PageDown", XK_Next },
+    { "Space", XK_space },
+    { "Escape", XK_Escape },
+    { "Esc", XK_Escape },
+    { "Tab", XK_Tab },
+    { "CapsLock", XK_Caps_Lock },
+    { "NumLock", XK_Num_Lock },
+    { "RightAlt", XK_Alt_R },
+    { "RightOption", XK_Alt_R },
+    { "RightControl", XK_Control_R },
+    { "RightCtrl", XK_Control_R },
+    { "RightShift", XK_Shift_R },
+    { "RightSuper", XK_Super_R },
+    { "RightWin", XK_Super_R },
+    { "RightMeta", XK_Super_R },
+    { "RightCommand", XK_Super_R },
+    { "RightCmd", XK_Super_R },
+    { "`", XK_grave },
+    { "Backquote", XK_grave },
+    { "-", XK_minus },
+    { "Minus", XK_minus },
+    { "=", XK_equal },
+    { "Equal", XK_equal },
+    { "[", XK_bracketleft },
+    { "]", XK_bracketright },
+    { "\\", XK_backslash },
+    { ";", XK_semicolon },
+    { "'", XK_apostrophe },
+    { ",", XK_comma },
+    { ".", XK_period },
+    { "/", XK_slash },
+};
+
+static KeySym parse_key_name(const char *name) {
+    if ((name[0] == 'F' || name[0] == 'f') && name[1] >= '1' && name[1] <= '9') {
+        char *end;
+        long n = strtol(name + 1, &end, 10);
+        if (*end == '\0' && n >= 1 && n <= 24) return XK_F1 + (KeySym)(n - 1);
+    }
+    for (size_t i = 0; i < sizeof(named_keys) / sizeof(named_keys[0]); i++) {
+        if (strcasecmp(name, named_keys[i].name) == 0) return named_keys[i].sym;
+    }
+    if (strlen(name) == 1) {
+        char c = name[0];
+        if (c >= 'A' && c <= 'Z') return (KeySym)(c - 'A' + 'a');
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) return (KeySym)c;
+    }
+    return XStringToKeysym(name);
+}
+
+static unsigned parse_modifier_name(const char *name) {
+    if (strcasecmp(name, "CommandOrControl") == 0 || strcasecmp(name, "Control") == 0 ||
+        strcasecmp(name, "Ctrl") == 0 || strcasecmp(name, "CmdOrCtrl") == 0) {
+        return MOD_CTRL;
+    }
+    if (strcasecmp(name, "Alt") == 0 || strcasecmp(name, "Option") == 0) return MOD_ALT;
+    if (strcasecmp(name, "Shift") == 0) return MOD_SHIFT;
+    if (strcasecmp(name, "Super") == 0 || strcasecmp(name, "Meta") == 0 ||
+        strcasecmp(name, "Win") == 0 || strcasecmp(name, "Command") == 0 ||
+        strcasecmp(name, "Cmd") == 0) {
+        return MOD_SUPER;
+    }
+    return 0;
+}
+
+/* Parses "Control+Shift+Space" style hotkeys; returns 0 if it names no key */
+static int parse_hotkey(Hotkey *hk, const char *spec) {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", spec);
+
+    char *save = NULL;
+    for (char *token = strtok_r(buffer, "+", &save); token; token = strtok_r(NULL, "+", &save)) {
+        while (*token == ' ') token++;
+        char *end = token + strlen(token);
+        while (end > token && end[-1] == ' ') *--end = '\0';
+        if (*token == '\0') continue;
+
+        unsigned mod = parse_modifier_name(token);
+        if (mod) {
+            hk->required |= mod;
+        } else if ((hk->target = parse_key_name(token)) == NoSymbol) {
+            return 0;
+        }
+    }
+    hk->modifiers_only = hk->target == NoSymbol && hk->required != 0;
+    return hk->target != NoSymbol || hk->modifiers_only;
+}
+
+static unsigned keysym_modifier(KeySym sym) {
+    switch (sym) {
+    case XK_Control_L:
+        return MODKEY_CTRL_L;
+    case XK_Control_R:
+        return MODKEY_CTRL_R;
+    case XK_Alt_L:
+    case XK_Meta_L:
+        return MODKEY_ALT_L;
+    case XK_Alt_R:
+    case XK_Meta_R:
+        return MODKEY_ALT_R;
+    case XK_Shift_L:
+        return MODKEY_SHIFT_L;
+    case XK_Shift_R:
+        return MODKEY_SHIFT_R;
+    case XK_Super_L:
+        return MODKEY_SUPER_L;
+    case XK_Super_R:
+        return MODKEY_SUPER_R;
+    default:
+        return 0;
+    }
+}
+
+static int keysym_is_target(const Hotkey *hk, KeySym sym) {
+    if (sym == hk->target) return 1;
+    /* Layouts with AltGr put ISO_Level3_Shift on the right Alt key */
+    return hk->target == XK_Alt_R && sym == XK_ISO_Level3_Shift;
+}
+
+/*
+ * Classifies every keycode by its first keysym. Runs at startup and on every
+ * MappingNotify, which linux-fast-paste --type triggers when it borrows spare
+ * keycodes.
+ */
+static void load_keymap(Display *dpy, Hotkey *hk) {
+    memset(hk->key_mod, 0, sizeof(hk->key_mod));
+    memset(hk->key_target, 0, sizeof(hk->key_target));
+
+    int min_keycode, max_keycode, per_keycode;
+    XDisplayKeycodes(dpy, &min_keycode, &max_keycode);
+    KeySym *syms = XGetKeyboardMapping(dpy, (KeyCode)min_keycode,
+                                       max_keycode - min_keycode + 1, &per_keycode);
+    if (!syms) return;
+    for (int kc = min_keycode; kc <= max_keycode && kc < KEYCODES; kc++) {
+        KeySym sym = syms[(kc - min_keycode) * per_keycode];
+        hk->key_mod[kc] = (unsigned char)keysym_modifier(sym);
+        hk->key_target[kc] = !hk->modifiers_only && keysym_is_target(hk, sym);
+    }
+    XFree(syms);
+}
+
+static int key_held(const Hotkey *hk, int code) {
+    return (hk->held[code / 64] >> (code % 64)) & 1;
+}
+
+static void set_key_held(Hotkey *hk, int code, int pressed) {
+    if (pressed) {
+        hk->held[code / 64] |= UINT64_C(1) << (code % 64);
+        hk->mods_held |= hk->key_mod[code];
+    } else {
+        hk->held[code / 64] &= ~(UINT64_C(1) << (code % 64));
+        hk->mods_held &= ~(unsigned)hk->key_mod[code];
+    }
+}
+
+/* Every required class has its left or right key down */
+static int modifiers_satisfied(const Hotkey *hk) {
+    static const unsigned classes[] = { MOD_CTRL, MOD_ALT, MOD_SHIFT, MOD_SUPER };
+    for (size_t i = 0; i < sizeof(classes) / sizeof(classes[0]); i++) {
+        if ((hk->required & classes[i]) && !(hk->mods_held & classes[i])) return 0;
+    }
+    return 1;
+}
+
+static void emit(const char *line) {
+    puts(line);
+    fflush(stdout);
+}
+
+static void handle_key(Hotkey *hk, int keycode, int pressed) {
+    if (keycode < 0 || keycode >= KEYCODES || key_held(hk, keycode) == pressed) return;
+    set_key_held(hk, keycode, pressed);
+
+    int modifiers_ok = modifiers_satisfied(hk);
+
+    if (hk->is_down && !pressed && (hk->key_mod[keycode] & hk->required)) {
+        hk->is_down = 0;
+        emit("KEY_UP");
+        return;
+    }
+
+    if (hk->modifiers_only) {
+        if (pressed && !hk->is_down && modifiers_ok) {
+            hk->is_down = 1;
+            emit("KEY_DOWN");
+        }
+        return;
+    }
+
+    if (!hk->key_target[keycode]) return;
+    if (pressed && !hk->is_down && modifiers_ok) {
+        hk->is_down = 1;
+        emit("KEY_DOWN");
+    } else if (!pressed && hk->is_down) {
+        hk->is_down = 0;
+        emit("KEY_UP");
+    }
+}
+
+/* Seeds the held keys, so a modifier already down at startup counts */
+static void load_held_keys(Display *dpy, Hotkey *hk) {
+    char keys[32];
+    XQueryKeymap(dpy, keys);
+    for (int kc = 0; kc < 256; kc++) {
+        set_key_held(hk, kc, (keys[kc / 8] >> (kc % 8)) & 1);
+    }
+}
+
+static int select_raw_key_events(Display *dpy, int *xi_opcode) {
+    int event, error;
+    if (!XQueryExtension(dpy, "XInputExtension", xi_opcode, &event, &error)) {
+        fprintf(stderr, "Error: X server has no XInput extension\n");
+        return 0;
+    }
+    int major = 2, minor = 1;
+    if (XIQueryVersion(dpy, &major, &minor) != Success) {
+        fprintf(stderr, "Error: XInput 2.1 not supported (server has %d.%d)\n", major, minor);
+        return 0;
+    }
+
+    unsigned char mask_bits[XIMaskLen(XI_LASTEVENT)];
+    memset(mask_bits, 0, sizeof(mask_bits));
+    XISetMask(mask_bits, XI_RawKeyPress);
+    XISetMask(mask_bits, XI_RawKeyRelease);
+    XIEventMask mask = { XIAllMasterDevices, sizeof(mask_bits), mask_bits };
+    XISelectEvents(dpy, DefaultRootWindow(dpy), &mask, 1);
+    XSync(dpy, False);
+    return 1;
+}
+
+static void print_listening(const Hotkey *hk, const char *spec, const char *key) {
+    fprintf(stderr,
+            "Listening for: %s (key=%s, Ctrl=%d, Alt=%d, Shift=%d, Super=%d, ModOnly=%d)\n",
+            spec, key, !!(hk->required & MOD_CTRL), !!(hk->required & MOD_ALT),
+            !!(hk->required & MOD_SHIFT), !!(hk->required & MOD_SUPER), hk->modifiers_only);
+}
+
+static int run_xinput(Hotkey *hk, const char *spec) {
+    Display *dpy = XOpenDisplay(NULL);
+    if (!dpy) {
+        fprintf(stderr, "Error: Cannot open X display\n");
+        return 1;
+    }
+    int xi_opcode;
+    if (!select_raw_key_events(dpy, &xi_opcode)) {
+        XCloseDisplay(dpy);
+        return 1;
+    }
+    load_keymap(dpy, hk);
+    load_held_keys(dpy, hk);
+
+    const char *target_name = hk->target != NoSymbol ? XKeysymToString(hk->target) : NULL;
+    print_listening(hk, spec, target_name ? target_name : "none");
+    emit("READY");
+
+    for (;;) {
+        XEvent ev;
+        XNextEvent(dpy, &ev);
+
+        if (ev.type == MappingNotify) {
+            XRefreshKeyboardMapping(&ev.xmapping);
+            if (ev.xmapping.request == MappingKeyboard) load_keymap(dpy, hk);
+            continue;
+        }
+        if (ev.type != GenericEvent || ev.xcookie.extension != xi_opcode ||
+            !XGetEventData(dpy, &ev.xcookie)) {
+            continue;
+        }
+
+        XIRawEvent *raw = ev.xcookie.data;
+        if ((ev.xcookie.evtype == XI_RawKeyPress && !(raw->flags & XIKeyRepeat)) ||
+            ev.xcookie.evtype == XI_RawKeyRelease) {
+            handle_key(hk, raw->detail, ev.xcookie.evtype == XI_RawKeyPress);
+        }
+        XFreeEventData(dpy, &ev.xcookie);
+    }
+}
+
+#ifdef HAVE_EVDEV
+typedef struct {
+    KeySym sym;
+    unsigned short code;
+} EvdevKey;
+
+/* Keys of the hotkey syntax at their US QWERTY position */
+static const EvdevKey evdev_keys[] = {
+    { XK_Pause, KEY_PAUSE }, { XK_Scroll_Lock, KEY_SCROLLLOCK }, { XK_Insert, KEY_INSERT },
+    { XK_Home, KEY_HOME }, { XK_End, KEY_END }, { XK_Prior, KEY_PAGEUP },
+    { XK_Next, KEY_PAGEDOWN }, { XK_space, KEY_SPACE }, { XK_Escape, KEY_ESC },
+    { XK_Tab, KEY_TAB }, { XK_Caps_Lock, KEY_CAPSLOCK }, { XK_Num_Lock, KEY_NUMLOCK },
+    { XK_Alt_R, KEY_RIGHTALT }, { XK_Control_R, KEY_RIGHTCTRL }, { XK_Shift_R, KEY_RIGHTSHIFT },
+    { XK_Super_R, KEY_RIGHTMETA }, { XK_grave, KEY_GRAVE }, { XK_minus, KEY_MINUS },
+    { XK_equal, KEY_EQUAL }, { XK_bracketleft, KEY_LEFTBRACE },
+    { XK_bracketright, KEY_RIGHTBRACE }, { XK_backslash, KEY_BACKSLASH },
+    { XK_semicolon, KEY_SEMICOLON }, { XK_apostrophe, KEY_APOSTROPHE }, { XK_comma, KEY_COMMA },
+    { XK_period, KEY_DOT }, { XK_slash, KEY_SLASH },
+};
+
+static const unsigned short evdev_letters[26] = {
+    KEY_A, KEY_B, KEY_C, KEY_D, KEY_E, KEY_F, KEY_G, KEY_H, KEY_I, KEY_J, KEY_K, KEY_L, KEY_M,
+    KEY_N, KEY_O, KEY_P, KEY_Q, KEY_R, KEY_S, KEY_T, KEY_U, KEY_V, KEY_W, KEY_X, KEY_Y, KEY_Z,
+};
+
+/* Returns 0 for keysyms without a fixed key */
+static int keysym_to_evdev(KeySym sym) {
+    if (sym >= XK_a && sym <= XK_z) return evdev_letters[sym - XK_a];
+    if (sym == XK_0) return KEY_0;
+    if (sym >= XK_1 && sym <= XK_9) return KEY_1 + (int)(sym - XK_1);
+    if (sym >= XK_F1 && sym <= XK_F10) return KEY_F1 + (int)(sym - XK_F1);
+    if (sym == XK_F11) return KEY_F11;
+    if (sym == XK_F12) return KEY_F12;
+    if (sym >= XK_F13 && sym <= XK_F24) return KEY_F13 + (int)(sym - XK_F13);
+    for (size_t i = 0; i < sizeof(evdev_keys) / sizeof(evdev_keys[0]); i++) {
+        if (evdev_keys[i].sym == sym) return evdev_keys[i].code;
+    }
+    return 0;
+}
+
+typedef struct {
+    int fd;
+    int dropped;                /* SYN_DROPPED seen, resync at the next SYN_REPORT */
+    char name[32];              /* eventN */
+} EvdevDevice;
+
+typedef struct {
+    Hotkey *hk;
+    int epoll_fd;
+    int inotify_fd;
+    int target_code;
+    EvdevDevice devices[EVDEV_DEVICES_MAX];
+    int ndevices;
+    int denied;                 /* Devices skipped for lack of permission */
+} EvdevListener;
+
+static void load_evdev_keymap(Hotkey *hk, int target_code) {
+    static const struct {
+        unsigned short code;
+        unsigned char bit;
+    } modifier_keys[] = {
+        { KEY_LEFTCTRL, MODKEY_CTRL_L }, { KEY_RIGHTCTRL, MODKEY_CTRL_R },
+        { KEY_LEFTALT, MODKEY_ALT_L }, { KEY_RIGHTALT, MODKEY_ALT_R },
+        { KEY_LEFTSHIFT, MODKEY_SHIFT_L }, { KEY_RIGHTSHIFT, MODKEY_SHIFT_R },
+        { KEY_LEFTMETA, MODKEY_SUPER_L }, { KEY_RIGHTMETA, MODKEY_SUPER_R },
+    };
+    memset(hk->key_mod, 0, sizeof(hk->key_mod));
+    memset(hk->key_target, 0, sizeof(hk->key_target));
+    for (size_t i = 0; i < sizeof(modifier_keys) / sizeof(modifier_keys[0]); i++) {
+        hk->key_mod[modifier_keys[i].code] = modifier_keys[i].bit;
+    }
+    if (target_code) hk->key_target[target_code] = 1;
+}
+
+/*
+ * A device matters if it has the main key or one of the required modifiers,
+ * unless it is our own paste keyboard
+ */
+static int evdev_device_relevant(const EvdevListener *l, int fd) {
+    char device_name[128] = "";
+    ioctl(fd, EVIOCGNAME(sizeof(device_name)), device_name);
+    if (strcmp(device_name, PASTE_DEVICE_NAME) == 0) return 0;
+
+    unsigned char bits[KEY_MAX / 8 + 1];
+    memset(bits, 0, sizeof(bits));
+    if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(bits)), bits) < 0) return 0;
+    for (int code = 0; code <= KEY_MAX; code++) {
+        if (!((bits[code / 8] >> (code % 8)) & 1)) continue;
+        if (code == l->target_code || (l->hk->key_mod[code] & l->hk->required)) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Rebuilds the held keys from every open device's current key state. Runs at
+ * startup, after SYN_DROPPED and when a device goes away, so a key released
+ * while its events were lost (or its keyboard unplugged) cannot stay down.
+ */
+static void evdev_resync(EvdevListener *l) {
+    Hotkey *hk = l->hk;
+    memset(hk->held, 0, sizeof(hk->held));
+    hk->mods_held = 0;
+    for (int i = 0; i < l->ndevices; i++) {
+        unsigned char bits[KEY_MAX / 8 + 1];
+        memset(bits, 0, sizeof(bits));
+        if (ioctl(l->devices[i].fd, EVIOCGKEY(sizeof(bits)), bits) < 0) continue;
+        for (int code = 0; code <= KEY_MAX && code < KEYCODES; code++) {
+            if ((bits[code / 8] >> (code % 8)) & 1) set_key_held(hk, code, 1);
+        }
+    }
+
+    int still_down = modifiers_satisfied(hk) &&
+                     (hk->modifiers_only || key_held(hk, l->target_code));
+    if (hk->is_down && !still_down) {
+        hk->is_down = 0;
+        emit("KEY_UP");
+    }
+}
+
+static void evdev_add_device(EvdevListener *l, const char *name) {
+    if (strncmp(name, "event", 5) != 0 || l->ndevices >= EVDEV_DEVICES_MAX) return;
+    for (int i = 0; i < l->ndevices; i++) {
+        if (strcmp(l->devices[i].name, name) == 0) return;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/dev/input/%s", name);
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == EACCES || errno == EPERM) l->denied++;
+        return;
+    }
+    if (!evdev_device_relevant(l, fd)) {
+        close(fd);
+        return;
+    }
+
+    EvdevDevice *dev = &l->devices[l->ndevices];
+    dev->fd = fd;
+    dev->dropped = 0;
+    snprintf(dev->name, sizeof(dev->name), "%s", name);
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+    if (epoll_ctl(l->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        close(fd);
+        return;
+    }
+    l->ndevices++;
+
+    char device_name[128] = "";
+    ioctl(fd, EVIOCGNAME(sizeof(device_name)), device_name);
+    fprintf(stderr, "Added %s (%s)\n", path, device_name);
+}
+
+static void evdev_remove_device(EvdevListener *l, int index) {
+    fprintf(stderr, "Removed /dev/input/%s\n", l->devices[index].name);
+    epoll_ctl(l->epoll_fd, EPOLL_CTL_DEL, l->devices[index].fd, NULL);
+    close(l->devices[index].fd);
+    l->devices[index] = l->devices[--l->ndevices];
+    evdev_resync(l);
+}
+
+static void evdev_read_device(EvdevListener *l, int index) {
+    EvdevDevice *dev = &l->devices[index];
+    struct input_event events[EVDEV_EVENTS_PER_READ];
+    for (;;) {
+        ssize_t n = read(dev->fd, events, sizeof(events));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN) evdev_remove_device(l, index);
+            return;
+        }
+        if (n == 0) return;
+
+        for (size_t i = 0; i < (size_t)n / sizeof(events[0]); i++) {
+            const struct input_event *ev = &events[i];
+            if (ev->type == EV_SYN && ev->code == SYN_DROPPED) {
+                dev->dropped = 1;
+            } else if (dev->dropped) {
+                if (ev->type == EV_SYN && ev->code == SYN_REPORT) {
+                    dev->dropped = 0;
+                    evdev_resync(l);
+                }
+            } else if (ev->type == EV_KEY && ev->value != 2) {
+                handle_key(l->hk, ev->code, ev->value != 0);
+            }
+        }
+    }
+}
+
+static void evdev_read_inotify(EvdevListener *l) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n;
+    while ((n = read(l->inotify_fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + n;) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            /* udev fixes the node's permissions after creating it: IN_ATTRIB */
+            if (ev->len > 0 && (ev->mask & (IN_CREATE | IN_ATTRIB))) {
+                evdev_add_device(l, ev->name);
+            }
+            p += sizeof(*ev) + ev->len;
+        }
+    }
+}
+
+static int run_evdev(Hotkey *hk, const char *spec) {
+    EvdevListener l;
+    memset(&l, 0, sizeof(l));
+    l.hk = hk;
+    l.target_code = hk->modifiers_only ? 0 : keysym_to_evdev(hk->target);
+    if (!hk->modifiers_only && !l.target_code) {
+        fprintf(stderr, "Error: '%s' has no fixed key for --evdev\n", spec);
+        return 1;
+    }
+    load_evdev_keymap(hk, l.target_code);
+
+    l.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    l.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (l.epoll_fd < 0 || l.inotify_fd < 0) {
+        perror("Error: epoll/inotify");
+        return 1;
+    }
+    /* Watch before scanning, so a keyboard appearing in between is not missed */
+    if (inotify_add_watch(l.inotify_fd, "/dev/input", IN_CREATE | IN_ATTRIB) < 0) {
+        perror("Error: Cannot watch /dev/input");
+        return 1;
+    }
+    struct epoll_event watch = { .events = EPOLLIN, .data.fd = l.inotify_fd };
+    epoll_ctl(l.epoll_fd, EPOLL_CTL_ADD, l.inotify_fd, &watch);
+
+    DIR *dir = opendir("/dev/input");
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir))) evdev_add_device(&l, entry->d_name);
+        closedir(dir);
+    }
+    if (l.ndevices == 0 && l.denied > 0) {
+        fprintf(stderr, "Error: Cannot read /dev/input/event* (not in the input group?)\n");
+        return 1;
+    }
+    evdev_resync(&l);
+
+    char key[16];
+    snprintf(key, sizeof(key), "%d", l.target_code);
+    print_listening(hk, spec, hk->modifiers_only ? "none" : key);
+    emit("READY");
+
+    for (;;) {
+        struct epoll_event ready[8];
+        int n = epoll_wait(l.epoll_fd, ready, 8, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Error: epoll_wait");
+            return 1;
+        }
+        for (int i = 0; i < n; i++) {
+            if (ready[i].data.fd == l.inotify_fd) {
+                evdev_read_inotify(&l);
+                continue;
+            }
+            /* An earlier event in this batch may have removed or moved devices */
+            for (int d = 0; d < l.ndevices; d++) {
+                if (l.devices[d].fd == ready[i].data.fd) {
+                    evdev_read_device(&l, d);
+                    break;
+                }
+            }
+        }
+    }
+}
+#endif
+
+int main(int argc, char *argv[]) {
+    int use_evdev = argc > 1 && strcmp(argv[1], "--evdev") == 0;
+    const char *spec = argc > 1 + use_evdev ? argv[1 + use_evdev] : NULL;
+
+    if (!spec) {
+        fprintf(stderr, "Usage: %s [--evdev] <key>\n", argv[0]);
+        fprintf(stderr, "Examples:\n");
+        fprintf(stderr, "  %s `                        (backtick)\n", argv[0]);
+        fprintf(stderr, "  %s F8                       (function key F1-F24)\n", argv[0]);
+        fprintf(stderr, "  %s RightControl             (right-side modifier)\n", argv[0]);
+        fprintf(stderr, "  %s Ctrl+Shift+Space         (multiple modifiers)\n", argv[0]);
+        fprintf(stderr, "  %s Control+Super            (modifiers only)\n", argv[0]);
+        return 1;
+    }
+
+    /* Electron kills us on stop; this covers the app crashing */
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() == 1) return 1;
+
+    Hotkey hk;
+    memset(&hk, 0, sizeof(hk));
+    if (!parse_hotkey(&hk, spec)) {
+        fprintf(stderr, "Error: Invalid key '%s'\n", spec);
+        return 1;
+    }
+
+    if (use_evdev) {
+#ifdef HAVE_EVDEV
+        return run_evdev(&hk, spec);
+#else
+        fprintf(stderr, "Error: Built without evdev support\n");
+        return 1;
+#endif
+    }
+    return run_xinput(&hk, spec);
+}
@@ -5,6 +5,32 @@
  * Outputs "CHANGED:<value>" to stdout when the text changes.
  * Exits after a timeout or on receiving a termination signal.
  *
+ * The field is re-read only when it reports object:text-changed or
+ * object:text-caret-moved, with a burst of events coalesced into one read.
+ * Until the field sends its first event it is also polled every
+ * POLL_INTERVAL_MS, for apps that never send text events. A poll first
+ * compares the character count and caret offset, and fetches the text only
+ * when either moved or on every FULL_CHECK_EVERY-th poll, so an idle field
+ * costs two small calls per tick. Fetched text is compared by length and a
+ * 64-bit hash; the previous text itself is only kept for --delta.
+ *
+ * The focused field is looked up in the application owning <pid> first (the
+ * active window's process), then in the others. Each application is asked
+ * through its Collection interface for a focused editable object, one
+ * server-side search instead of a D-Bus round-trip per node; applications
+ * without Collection are walked, skipping subtrees that are not showing.
+ * The lookup time is reported on stderr.
+ *
+ * Only a window of the field is read: the pasted text, which ends at the
+ * caret when monitoring starts, plus WINDOW_MARGIN_CHARS on either side.
+ * Insertions and deletions reported by text-changed events shift the window
+ * so it stays on the same text, so read cost does not grow with the
+ * document. Without a caret offset the first MAX_OUTPUT_CHARS are read.
+ *
+ * Usage:
+ *   linux-text-monitor [--delta] [--framing=binary] [pid]
+ *   linux-text-monitor --daemon [--delta] [--framing=binary]
+ *
  * Protocol (stdout):
  *   INITIAL_VALUE:<text>  - Initial text field value
  *   INITIAL_VALUE_B64:<base64> - Initial text field value (multiline)
@@ -13,91 +39,240 @@
  *   NO_ELEMENT            - Could not get focused element
  *   NO_VALUE              - Focused element has no text value
  *
+ * With --delta, changes after the initial value are sent as edits to the
+ * previous value instead of full snapshots:
+ *   DELTA:<offset>:<deleted>:<base64> - Replace <deleted> units at <offset>
+ *                                       with the decoded text. Offsets count
+ *                                       UTF-16 code units, like JS strings
+ *
+ * With --framing=binary the first line is "FRAMING binary 1" and every
+ * message after it is a header line followed by raw bytes, so values need no
+ * base64 and may hold newlines:
+ *   <TYPE> <length>\n<length bytes>
+ * TYPE is INITIAL_VALUE, CHANGED, DELTA (payload "<offset>:<deleted>:" and
+ * the inserted text), NO_ELEMENT, NO_VALUE or READY; the last three carry
+ * no bytes.
+ *
  * Input (stdin):
- *   First line: original pasted text (informational)
+ *   Original pasted text, up to EOF (its length places the window)
+ *
+ * With --daemon the monitor stays resident and keeps its AT-SPI connection
+ * and a PID -> application cache between pastes. Text events are only
+ * listened for while a session runs, since they wake the monitor for every
+ * keystroke on the desktop. It
+ * prints READY, then reads commands from stdin, one per line, and exits at
+ * EOF. Every output line or frame header is prefixed with "<id> ". One
+ * session runs at a time; START ends the previous one, as does its
+ * TIMEOUT_SECONDS expiry:
+ *   START <id> <base64 original> [pid] - Monitor the focused field
+ *   STOP <id>                          - End the session if it is current
  *
  * Compile:
  *   gcc -O2 linux-text-monitor.c -o linux-text-monitor $(pkg-config --cflags --libs atspi-2)
  */
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
-#include <time.h>
-#include <unistd.h>
+#include <sys/prctl.h>
 #include <atspi/atspi.h>
+#include <glib-unix.h>
+
+#include "helper-output.h"
 
 #define TIMEOUT_SECONDS 30
 #define POLL_INTERVAL_MS 500
+#define EVENT_COALESCE_MS 20
+#define FULL_CHECK_EVERY 4
 #define MAX_OUTPUT_CHARS 10240
+#define WINDOW_MARGIN_CHARS 1024
+
+static HelperOutput output;
+
+static const char *const TEXT_EVENTS[] = {
+    "object:text-changed:insert",
+    "object:text-changed:delete",
+    "object:text-caret-moved",
+};
+#define TEXT_EVENT_COUNT (sizeof(TEXT_EVENTS) / sizeof(TEXT_EVENTS[0]))
+
+typedef struct Monitor Monitor;
+
+typedef struct {
+    Monitor *monitor;
+    char *id;          /* --daemon session id, NULL otherwise */
+    char tag[40];      /* "<id> " prefix for output lines */
+    AtspiAccessible *focused;
+    AtspiText *text_iface;
+    char *last_value;  /* Only kept for --delta */
+    size_t last_len;
+    uint64_t last_hash;
+    gint last_count;   /* Character count and caret offset at the last check */
+    gint last_caret;
+    guint unchanged_checks;
+    gboolean text_changed; /* A text-changed event arrived since the last read */
+    guint poll_id;     /* Fallback poll, until the field sends an event */
+    guint reread_id;   /* Pending coalesced re-read */
+    guint timeout_id;
+    gint window_start; /* Character range read from the field */
+    gint window_end;
+} Session;
+
+struct Monitor {
+    GMainLoop *loop;
+    gboolean delta;    /* --delta */
+    gboolean daemon;   /* --daemon */
+    GHashTable *apps;  /* PID -> application, kept across --daemon sessions */
+    Session *session;  /* The session being monitored, or NULL */
+    AtspiEventListener *listener; /* Text events, registered while a session runs */
+};
+
+static void print_text_output(const char *tag, const char *name, const char *value) {
+    if (!value) return;
 
-static volatile sig_atomic_t running = 1;
-static const char BASE64_TABLE[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t len = strlen(value);
+    helper_output_value(&output, tag, name, value, len < MAX_OUTPUT_CHARS ? len : MAX_OUTPUT_CHARS);
+}
 
-static void signal_handler(int sig) {
-    (void)sig;
-    running = 0;
+static void print_status(const char *tag, const char *status) {
+    helper_output_status(&output, tag, status);
 }
 
-static char *base64_encode(const unsigned char *data, size_t len) {
-    size_t out_len = 4 * ((len + 2) / 3);
-    char *out = (char *)malloc(out_len + 1);
-    if (!out) return NULL;
+static int is_utf8_continuation(char c) {
+    return ((unsigned char)c & 0xC0) == 0x80;
+}
 
-    size_t i = 0, j = 0;
-    while (i < len) {
-        unsigned int octet_a = i < len ? data[i++] : 0;
-        unsigned int octet_b = i < len ? data[i++] : 0;
-        unsigned int octet_c = i < len ? data[i++] : 0;
-        unsigned int triple = (octet_a << 16) | (octet_b << 8) | octet_c;
+/* UTF-16 code units in a UTF-8 run, the unit JavaScript string offsets use */
+static size_t utf16_length(const char *s, size_t len) {
+    size_t units = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (!is_utf8_continuation((char)c)) units += c >= 0xF0 ? 2 : 1;
+    }
+    return units;
+}
+
+/*
+ * Prints the edit turning old_value into new_value: everything between
+ * their common prefix and common suffix, cut at character boundaries.
+ */
+static void print_delta(const char *tag, const char *old_value, const char *new_value) {
+    size_t old_len = strlen(old_value);
+    size_t new_len = strlen(new_value);
 
-        out[j++] = BASE64_TABLE[(triple >> 18) & 0x3F];
-        out[j++] = BASE64_TABLE[(triple >> 12) & 0x3F];
-        out[j++] = BASE64_TABLE[(triple >> 6) & 0x3F];
-        out[j++] = BASE64_TABLE[triple & 0x3F];
+    size_t prefix = 0;
+    while (prefix < old_len && prefix < new_len && old_value[prefix] == new_value[prefix]) {
+        prefix++;
+    }
+    while (prefix > 0 && (is_utf8_continuation(old_value[prefix]) ||
+                          is_utf8_continuation(new_value[prefix]))) {
+        prefix--;
     }
 
-    if (len % 3 == 1) {
-        out[out_len - 1] = '=';
-        out[out_len - 2] = '=';
-    } else if (len % 3 == 2) {
-        out[out_len - 1] = '=';
+    size_t max_suffix = (old_len < new_len ? old_len : new_len) - prefix;
+    size_t suffix = 0;
+    while (suffix < max_suffix &&
+           old_value[old_len - 1 - suffix] == new_value[new_len - 1 - suffix]) {
+        suffix++;
+    }
+    while (suffix > 0 && is_utf8_continuation(new_value[new_len - suffix])) {
+        suffix--;
     }
 
-    out[out_len] = '\0';
-    return out;
+    helper_output_delta(&output, tag, utf16_length(old_value, prefix),
+                        utf16_length(old_value + prefix, old_len - suffix - prefix),
+                        new_value + prefix, new_len - suffix - prefix);
 }
 
-static void print_text_output(const char *name, const char *value) {
-    if (!value) return;
+#define HASH_PRIME1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME3 0x165667B19E3779F9ULL
+#define HASH_PRIME4 0x85EBCA77C2B2AE63ULL
+#define HASH_PRIME5 0x27D4EB2F165667C5ULL
 
-    size_t len = strlen(value);
-    size_t limit = len < MAX_OUTPUT_CHARS ? len : MAX_OUTPUT_CHARS;
-
-    if (memchr(value, '\n', limit) || memchr(value, '\r', limit)) {
-        char *encoded = base64_encode((const unsigned char *)value, limit);
-        if (!encoded) return;
-        printf("%s_B64:%s\n", name, encoded);
-        fflush(stdout);
-        free(encoded);
-        return;
+static uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t read64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t hash_round(uint64_t acc, uint64_t input) {
+    return rotl64(acc + input * HASH_PRIME2, 31) * HASH_PRIME1;
+}
+
+static uint64_t hash_merge(uint64_t acc, uint64_t lane) {
+    return (acc ^ hash_round(0, lane)) * HASH_PRIME1 + HASH_PRIME4;
+}
+
+/*
+ * XXH64 (seed 0, little-endian reads). Four independent lanes over 32-byte
+ * stripes keep the multiplies in flight together, so a 10 KB window hashes
+ * in about a microsecond.
+ */
+static uint64_t hash_text(const char *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    const unsigned char *end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+        uint64_t v1 = HASH_PRIME1 + HASH_PRIME2, v2 = HASH_PRIME2, v3 = 0, v4 = 0 - HASH_PRIME1;
+        do {
+            v1 = hash_round(v1, read64(p));
+            v2 = hash_round(v2, read64(p + 8));
+            v3 = hash_round(v3, read64(p + 16));
+            v4 = hash_round(v4, read64(p + 24));
+            p += 32;
+        } while (end - p >= 32);
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = hash_merge(h, v1);
+        h = hash_merge(h, v2);
+        h = hash_merge(h, v3);
+        h = hash_merge(h, v4);
+    } else {
+        h = HASH_PRIME5;
+    }
+
+    h += len;
+    for (; end - p >= 8; p += 8) {
+        h = rotl64(h ^ hash_round(0, read64(p)), 27) * HASH_PRIME1 + HASH_PRIME4;
+    }
+    if (end - p >= 4) {
+        uint32_t k;
+        memcpy(&k, p, sizeof(k));
+        h = rotl64(h ^ (uint64_t)k * HASH_PRIME1, 23) * HASH_PRIME2 + HASH_PRIME3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h = rotl64(h ^ *p * HASH_PRIME5, 11) * HASH_PRIME1;
     }
 
-    printf("%s:%.*s\n", name, (int)limit, value);
-    fflush(stdout);
+    h ^= h >> 33;
+    h *= HASH_PRIME2;
+    h ^= h >> 29;
+    h *= HASH_PRIME3;
+    h ^= h >> 32;
+    return h;
 }
 
-static AtspiAccessible *find_focused(AtspiAccessible *accessible) {
+/* Tree-walk twin of focused_editable_rule, for applications without Collection */
+static AtspiAccessible *find_focused(AtspiAccessible *accessible, int depth) {
     GError *error = NULL;
 
     AtspiStateSet *states = atspi_accessible_get_state_set(accessible);
     if (states) {
-        if (atspi_state_set_contains(states, ATSPI_STATE_FOCUSED)) {
-            g_object_unref(states);
-            return g_object_ref(accessible);
-        }
+        gboolean focused = atspi_state_set_contains(states, ATSPI_STATE_FOCUSED) &&
+                           atspi_state_set_contains(states, ATSPI_STATE_EDITABLE);
+        /* Applications have no SHOWING state; below them a hidden subtree holds no focus */
+        gboolean hidden = depth > 0 && !atspi_state_set_contains(states, ATSPI_STATE_SHOWING);
         g_object_unref(states);
+        if (focused) return g_object_ref(accessible);
+        if (hidden) return NULL;
     }
 
     int count = atspi_accessible_get_child_count(accessible, &error);
@@ -115,7 +290,7 @@ static AtspiAccessible *find_focused(AtspiAccessible *accessible) {
         }
         if (!child) continue;
 
-        AtspiAccessible *result = find_focused(child);
+        AtspiAccessible *result = find_focused(child, depth + 1);
         g_object_unref(child);
         if (result) return result;
     }
@@ -123,53 +298,85 @@ static AtspiAccessible *find_focused(AtspiAccessible *accessible) {
     return NULL;
 }
 
-static char *read_text_value(AtspiText *text_iface) {
-    GError *error = NULL;
-
-    int char_count = atspi_text_get_character_count(text_iface, &error);
-    if (error) {
-        g_error_free(error);
-        return NULL;
-    }
-    if (char_count <= 0) return NULL;
+static AtspiMatchRule *focused_editable_rule(void) {
+    GArray *wanted = g_array_new(FALSE, FALSE, sizeof(AtspiStateType));
+    AtspiStateType state = ATSPI_STATE_FOCUSED;
+    g_array_append_val(wanted, state);
+    state = ATSPI_STATE_EDITABLE;
+    g_array_append_val(wanted, state);
+
+    AtspiStateSet *states = atspi_state_set_new(wanted);
+    g_array_free(wanted, TRUE);
+
+    AtspiMatchRule *rule = atspi_match_rule_new(
+        states, ATSPI_Collection_MATCH_ALL, NULL, ATSPI_Collection_MATCH_ALL, NULL,
+        ATSPI_Collection_MATCH_ALL, NULL, ATSPI_Collection_MATCH_ALL, FALSE);
+    g_object_unref(states);
+    return rule;
+}
 
-    int limit = char_count < MAX_OUTPUT_CHARS ? char_count : MAX_OUTPUT_CHARS;
-    char *value = atspi_text_get_text(text_iface, 0, limit, &error);
-    if (error) {
+/*
+ * Returns the focused editable object of one application, or NULL. *method
+ * says how it was searched.
+ */
+static AtspiAccessible *find_focused_in_app(AtspiAccessible *app, AtspiMatchRule *rule,
+                                            const char **method) {
+    AtspiCollection *collection = rule ? atspi_accessible_get_collection_iface(app) : NULL;
+    if (collection) {
+        GError *error = NULL;
+        GArray *matches = atspi_collection_get_matches(
+            collection, rule, ATSPI_Collection_SORT_ORDER_CANONICAL, 1, TRUE, &error);
+        g_object_unref(collection);
+
+        if (!error) {
+            *method = "collection";
+            AtspiAccessible *found = NULL;
+            if (matches && matches->len > 0) {
+                found = g_array_index(matches, AtspiAccessible *, 0);
+                for (guint i = 1; i < matches->len; i++) {
+                    g_object_unref(g_array_index(matches, AtspiAccessible *, i));
+                }
+            }
+            if (matches) g_array_free(matches, TRUE);
+            return found;
+        }
         g_error_free(error);
-        return NULL;
     }
 
-    return value;
+    *method = "tree walk";
+    return find_focused(app, 0);
 }
 
-int main(void) {
-    signal(SIGTERM, signal_handler);
-    signal(SIGINT, signal_handler);
-
-    /* Read original text from stdin (consume but don't use) */
-    char stdin_buf[4096];
-    if (fgets(stdin_buf, sizeof(stdin_buf), stdin)) {
-        /* consumed */
-    }
+/*
+ * Searches the application owning target_pid first, then the rest. When
+ * apps is given, the application is looked up there first and every
+ * application whose PID gets queried is added to it.
+ */
+static AtspiAccessible *find_focused_element(long target_pid, GHashTable *apps,
+                                             const char **method) {
+    AtspiMatchRule *rule = focused_editable_rule();
+    AtspiAccessible *focused = NULL;
 
-    int init_result = atspi_init();
-    if (init_result != 0 && init_result != 1) {
-        printf("NO_ELEMENT\n");
-        fflush(stdout);
-        return 1;
+    AtspiAccessible *cached =
+        apps && target_pid > 0 ? g_hash_table_lookup(apps, GINT_TO_POINTER(target_pid)) : NULL;
+    AtspiAccessible *searched = NULL;  /* Already searched in vain; not searched again */
+    if (cached) {
+        focused = find_focused_in_app(cached, rule, method);
+        /* The application may have gone, or its PID been reused; look it up again */
+        if (!focused) {
+            searched = g_object_ref(cached);
+            g_hash_table_remove(apps, GINT_TO_POINTER(target_pid));
+        }
     }
 
-    GError *error = NULL;
-    AtspiAccessible *desktop = atspi_get_desktop(0);
+    AtspiAccessible *desktop = focused ? NULL : atspi_get_desktop(0);
     if (!desktop) {
-        printf("NO_ELEMENT\n");
-        fflush(stdout);
-        return 1;
+        if (searched) g_object_unref(searched);
+        if (rule) g_object_unref(rule);
+        return focused;
     }
 
-    /* Search for focused element across all applications */
-    AtspiAccessible *focused = NULL;
+    GError *error = NULL;
     int app_count = atspi_accessible_get_child_count(desktop, &error);
     if (error) {
         g_error_free(error);
@@ -177,7 +384,33 @@ int main(void) {
         app_count = 0;
     }
 
+    int target_index = -1;
+
+    if (target_pid > 0) {
+        for (int i = 0; i < app_count && target_index < 0; i++) {
+            AtspiAccessible *app = atspi_accessible_get_child_at_index(desktop, i, &error);
+            if (error) {
+                g_error_free(error);
+                error = NULL;
+                continue;
+            }
+            if (!app) continue;
+
+            long pid = (long)atspi_accessible_get_process_id(app, NULL);
+            if (apps && pid > 0) {
+                g_hash_table_insert(apps, GINT_TO_POINTER(pid), g_object_ref(app));
+            }
+            if (pid == target_pid) {
+                target_index = i;
+                if (app != searched) focused = find_focused_in_app(app, rule, method);
+            }
+            g_object_unref(app);
+        }
+    }
+
     for (int i = 0; i < app_count && !focused; i++) {
+        if (i == target_index) continue;
+
         AtspiAccessible *app = atspi_accessible_get_child_at_index(desktop, i, &error);
         if (error) {
             g_error_free(error);
@@ -186,67 +419,429 @@ int main(void) {
         }
         if (!app) continue;
 
-        focused = find_focused(app);
+        if (app != searched) focused = find_focused_in_app(app, rule, method);
         g_object_unref(app);
     }
 
+    if (searched) g_object_unref(searched);
+    if (rule) g_object_unref(rule);
     g_object_unref(desktop);
+    return focused;
+}
 
-    if (!focused) {
-        printf("NO_ELEMENT\n");
-        fflush(stdout);
-        return 1;
+/* Returns -1 on error */
+static gint get_character_count(AtspiText *text_iface) {
+    GError *error = NULL;
+    gint count = atspi_text_get_character_count(text_iface, &error);
+    if (error) {
+        g_error_free(error);
+        return -1;
     }
+    return count;
+}
 
-    /* Get the Text interface */
-    AtspiText *text_iface = atspi_accessible_get_text_iface(focused);
-    if (!text_iface) {
-        printf("NO_VALUE\n");
-        fflush(stdout);
-        g_object_unref(focused);
-        return 0;
+/* Returns -1 on error or without a caret */
+static gint get_caret_offset(AtspiText *text_iface) {
+    GError *error = NULL;
+    gint caret = atspi_text_get_caret_offset(text_iface, &error);
+    if (error) {
+        g_error_free(error);
+        return -1;
     }
+    return caret;
+}
 
-    /* Read initial value */
-    char *last_value = read_text_value(text_iface);
-    if (!last_value) {
-        printf("NO_VALUE\n");
-        fflush(stdout);
-        g_object_unref(text_iface);
-        g_object_unref(focused);
-        return 0;
+static char *read_text_value(AtspiText *text_iface, gint char_count, gint start, gint end) {
+    GError *error = NULL;
+    if (char_count <= 0) return NULL;
+
+    end = MIN(MIN(end, char_count), start + MAX_OUTPUT_CHARS);
+    start = MIN(start, end);
+    char *value = atspi_text_get_text(text_iface, start, end, &error);
+    if (error) {
+        g_error_free(error);
+        return NULL;
     }
 
-    print_text_output("INITIAL_VALUE", last_value);
+    /*
+     * Cap the bytes too, at a character boundary, so the value is exactly
+     * what gets printed and --delta edits apply to what the reader holds
+     */
+    size_t len = value ? strlen(value) : 0;
+    if (len > MAX_OUTPUT_CHARS) {
+        len = MAX_OUTPUT_CHARS;
+        while (len > 0 && is_utf8_continuation(value[len])) len--;
+        value[len] = '\0';
+    }
 
-    /* Poll for changes */
-    struct timespec start;
-    clock_gettime(CLOCK_MONOTONIC, &start);
+    return value;
+}
 
-    while (running) {
-        struct timespec now;
-        clock_gettime(CLOCK_MONOTONIC, &now);
-        long elapsed_ms = (now.tv_sec - start.tv_sec) * 1000 +
-                          (now.tv_nsec - start.tv_nsec) / 1000000;
-        if (elapsed_ms >= TIMEOUT_SECONDS * 1000) break;
+/* Takes ownership of value */
+static void remember_value(Session *s, char *value, size_t len, uint64_t hash) {
+    s->last_len = len;
+    s->last_hash = hash;
+    g_free(s->last_value);
+    s->last_value = NULL;
+    if (s->monitor->delta) {
+        s->last_value = value;
+    } else {
+        g_free(value);
+    }
+}
 
-        usleep(POLL_INTERVAL_MS * 1000);
+/*
+ * Reports the window's text if it changed. With precheck, the text is only
+ * fetched when the character count or caret offset moved, or on every
+ * FULL_CHECK_EVERY-th check for edits that keep both.
+ */
+static void check_for_change(Session *s, gboolean precheck) {
+    gint count = get_character_count(s->text_iface);
+    if (count < 0) return;
+
+    if (precheck) {
+        gint caret = get_caret_offset(s->text_iface);
+        gboolean unchanged = count == s->last_count && caret == s->last_caret;
+        s->last_caret = caret;
+        if (unchanged && ++s->unchanged_checks % FULL_CHECK_EVERY != 0) return;
+    }
+    s->last_count = count;
 
-        char *current_value = read_text_value(text_iface);
-        if (!current_value) continue;
+    char *current_value = read_text_value(s->text_iface, count, s->window_start, s->window_end);
+    if (!current_value) return;
 
-        if (strcmp(current_value, last_value) != 0) {
-            print_text_output("CHANGED", current_value);
-            g_free(last_value);
-            last_value = current_value;
+    size_t len = strlen(current_value);
+    uint64_t hash = hash_text(current_value, len);
+    if (len == s->last_len && hash == s->last_hash) {
+        g_free(current_value);
+        return;
+    }
+
+    if (s->monitor->delta) {
+        print_delta(s->tag, s->last_value, current_value);
+    } else {
+        print_text_output(s->tag, "CHANGED", current_value);
+    }
+    remember_value(s, current_value, len, hash);
+}
+
+static gboolean on_poll_tick(gpointer data) {
+    check_for_change((Session *)data, TRUE);
+    return G_SOURCE_CONTINUE;
+}
+
+/* Caret moves alone go through the precheck; text-changed events always read */
+static gboolean on_reread(gpointer data) {
+    Session *s = (Session *)data;
+    gboolean text_changed = s->text_changed;
+    s->reread_id = 0;
+    s->text_changed = FALSE;
+    check_for_change(s, !text_changed);
+    return G_SOURCE_REMOVE;
+}
+
+/* Keeps the window on the same text when characters are inserted before or inside it */
+static void follow_insert(Session *s, gint offset, gint length) {
+    if (offset < s->window_start) s->window_start += length;
+    if (offset <= s->window_end) s->window_end += length;
+}
+
+static void follow_delete(Session *s, gint offset, gint length) {
+    gint end = offset + length;
+    s->window_start -= CLAMP(s->window_start, offset, end) - offset;
+    s->window_end -= CLAMP(s->window_end, offset, end) - offset;
+}
+
+/* Events arrive for every application; only the monitored field's matter */
+static void on_text_event(AtspiEvent *event, void *user_data) {
+    Session *s = ((Monitor *)user_data)->session;
+
+    if (s && event->source == s->focused) {
+        if (strncmp(event->type, "object:text-changed:insert", 26) == 0) {
+            follow_insert(s, event->detail1, event->detail2);
+            s->text_changed = TRUE;
+        } else if (strncmp(event->type, "object:text-changed:delete", 26) == 0) {
+            follow_delete(s, event->detail1, event->detail2);
+            s->text_changed = TRUE;
+        }
+
+        if (s->poll_id) {
+            g_source_remove(s->poll_id);
+            s->poll_id = 0;
+        }
+        if (!s->reread_id) {
+            s->reread_id = g_timeout_add(EVENT_COALESCE_MS, on_reread, s);
+        }
+    }
+
+    g_boxed_free(ATSPI_TYPE_EVENT, event);
+}
+
+static gboolean quit_loop(gpointer data) {
+    g_main_loop_quit(((Monitor *)data)->loop);
+    return G_SOURCE_REMOVE;
+}
+
+/* Centres the window on the pasted text, which ends at the caret */
+static void anchor_window(Session *s, long pasted_chars) {
+    gint caret = get_caret_offset(s->text_iface);
+    s->last_caret = caret;
+    if (caret < 0) {
+        s->window_start = 0;
+        s->window_end = MAX_OUTPUT_CHARS;
+        return;
+    }
+
+    gint paste_start = caret - (gint)MIN(pasted_chars, (long)caret);
+    s->window_start = MAX(0, paste_start - WINDOW_MARGIN_CHARS);
+    s->window_end = caret + WINDOW_MARGIN_CHARS;
+}
+
+static AtspiEventListener *register_text_events(Monitor *m) {
+    AtspiEventListener *listener = atspi_event_listener_new(on_text_event, m, NULL);
+    if (!listener) return NULL;
+
+    size_t registered = 0;
+    for (size_t i = 0; i < TEXT_EVENT_COUNT; i++) {
+        GError *error = NULL;
+        if (atspi_event_listener_register(listener, TEXT_EVENTS[i], &error)) {
+            registered++;
+        } else if (error) {
+            fprintf(stderr, "Cannot listen for %s: %s\n", TEXT_EVENTS[i], error->message);
+            g_error_free(error);
+        }
+    }
+
+    if (registered == 0) {
+        g_object_unref(listener);
+        return NULL;
+    }
+    return listener;
+}
+
+static void deregister_text_events(AtspiEventListener *listener) {
+    if (!listener) return;
+    for (size_t i = 0; i < TEXT_EVENT_COUNT; i++) {
+        atspi_event_listener_deregister(listener, TEXT_EVENTS[i], NULL);
+    }
+    g_object_unref(listener);
+}
+
+static void free_session(Session *s) {
+    if (s->poll_id) g_source_remove(s->poll_id);
+    if (s->reread_id) g_source_remove(s->reread_id);
+    if (s->timeout_id) g_source_remove(s->timeout_id);
+    g_free(s->last_value);
+    if (s->text_iface) g_object_unref(s->text_iface);
+    if (s->focused) g_object_unref(s->focused);
+    g_free(s->id);
+    g_free(s);
+}
+
+static void stop_listening(Monitor *m) {
+    deregister_text_events(m->listener);
+    m->listener = NULL;
+}
+
+static void end_session(Monitor *m) {
+    if (!m->session) return;
+
+    free_session(m->session);
+    m->session = NULL;
+    stop_listening(m);
+
+    /* A one-shot monitor has nothing left to do */
+    if (!m->daemon) g_main_loop_quit(m->loop);
+}
+
+static gboolean on_session_timeout(gpointer data) {
+    Session *s = (Session *)data;
+    s->timeout_id = 0;
+    end_session(s->monitor);
+    return G_SOURCE_REMOVE;
+}
+
+typedef enum { SESSION_STARTED, SESSION_NO_ELEMENT, SESSION_NO_VALUE } SessionResult;
+
+/*
+ * Finds the focused field, prints its initial value and starts watching it,
+ * ending any previous session. id is NULL outside --daemon.
+ */
+static SessionResult start_session(Monitor *m, const char *id, const char *original,
+                                   long target_pid) {
+    end_session(m);
+
+    /* Listen before the first read, so an edit in between still triggers a re-read */
+    m->listener = register_text_events(m);
+
+    Session *s = g_malloc0(sizeof(Session));
+    s->monitor = m;
+    if (id) {
+        s->id = g_strdup(id);
+        snprintf(s->tag, sizeof(s->tag), "%s ", id);
+    }
+
+    gint64 lookup_start = g_get_monotonic_time();
+    const char *method = "none";
+    s->focused = find_focused_element(target_pid, m->apps, &method);
+    fprintf(stderr, "%sFocus lookup %s in %lld us (%s, pid %ld)\n", s->tag,
+            s->focused ? "succeeded" : "failed",
+            (long long)(g_get_monotonic_time() - lookup_start), method, target_pid);
+
+    SessionResult result = SESSION_NO_ELEMENT;
+    char *initial = NULL;
+    if (s->focused) {
+        s->text_iface = atspi_accessible_get_text_iface(s->focused);
+        result = SESSION_NO_VALUE;
+    }
+    if (s->text_iface) {
+        anchor_window(s, g_utf8_strlen(original, -1));
+        fprintf(stderr, "%sWatching characters %d-%d\n", s->tag, s->window_start, s->window_end);
+        s->last_count = get_character_count(s->text_iface);
+        initial = read_text_value(s->text_iface, s->last_count, s->window_start, s->window_end);
+        if (initial) result = SESSION_STARTED;
+    }
+
+    if (result != SESSION_STARTED) {
+        print_status(s->tag, result == SESSION_NO_ELEMENT ? "NO_ELEMENT" : "NO_VALUE");
+        free_session(s);
+        stop_listening(m);
+        return result;
+    }
+
+    print_text_output(s->tag, "INITIAL_VALUE", initial);
+    size_t initial_len = strlen(initial);
+    remember_value(s, initial, initial_len, hash_text(initial, initial_len));
+    s->poll_id = g_timeout_add(POLL_INTERVAL_MS, on_poll_tick, s);
+    s->timeout_id = g_timeout_add_seconds(TIMEOUT_SECONDS, on_session_timeout, s);
+    m->session = s;
+    return SESSION_STARTED;
+}
+
+/* START <id> <base64 original> [pid] | STOP <id> */
+static void handle_command(Monitor *m, char *line) {
+    char *save = NULL;
+    char *command = strtok_r(line, " \r\n", &save);
+    char *id = command ? strtok_r(NULL, " \r\n", &save) : NULL;
+    if (!id) return;
+
+    if (strcmp(command, "STOP") == 0) {
+        if (m->session && strcmp(m->session->id, id) == 0) end_session(m);
+        return;
+    }
+    if (strcmp(command, "START") != 0) return;
+
+    char *encoded = strtok_r(NULL, " \r\n", &save);
+    char *pid = encoded ? strtok_r(NULL, " \r\n", &save) : NULL;
+    gsize decoded_len = 0;
+    guchar *decoded = encoded ? g_base64_decode(encoded, &decoded_len) : NULL;
+    char *original = g_strndup(decoded ? (const char *)decoded : "", decoded_len);
+    g_free(decoded);
+
+    start_session(m, id, original, pid ? strtol(pid, NULL, 10) : 0);
+    g_free(original);
+}
+
+static gboolean on_command_input(GIOChannel *channel, GIOCondition condition, gpointer data) {
+    Monitor *m = (Monitor *)data;
+    (void)condition;
+
+    do {
+        char *line = NULL;
+        GIOStatus status = g_io_channel_read_line(channel, &line, NULL, NULL, NULL);
+        if (status == G_IO_STATUS_EOF || status == G_IO_STATUS_ERROR) {
+            g_free(line);
+            g_main_loop_quit(m->loop);
+            return G_SOURCE_REMOVE;
+        }
+        if (line) handle_command(m, line);
+        g_free(line);
+    } while (g_io_channel_get_buffer_condition(channel) & G_IO_IN);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static char *read_stdin_text(void) {
+    size_t len = 0, cap = 4096;
+    char *buf = (char *)malloc(cap);
+    if (!buf) return NULL;
+
+    size_t n;
+    while ((n = fread(buf + len, 1, cap - len - 1, stdin)) > 0) {
+        len += n;
+        if (cap - len - 1 == 0) {
+            char *grown = (char *)realloc(buf, cap * 2);
+            if (!grown) break;
+            buf = grown;
+            cap *= 2;
+        }
+    }
+    if (len > 0 && buf[len - 1] == '\n') len--;
+    buf[len] = '\0';
+    return buf;
+}
+
+int main(int argc, char *argv[]) {
+    Monitor m = { NULL, FALSE, FALSE, NULL, NULL, NULL };
+    long target_pid = 0;
+    int binary_framing = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--delta") == 0) {
+            m.delta = TRUE;
+        } else if (strcmp(argv[i], "--daemon") == 0) {
+            m.daemon = TRUE;
+        } else if (strcmp(argv[i], "--framing=binary") == 0) {
+            binary_framing = 1;
         } else {
-            g_free(current_value);
+            target_pid = strtol(argv[i], NULL, 10);
         }
     }
 
-    g_free(last_value);
-    g_object_unref(text_iface);
-    g_object_unref(focused);
+    helper_output_init(&output, stdout, binary_framing);
+
+    /* The resident monitor goes when OpenWhispr does, even if killed */
+    if (m.daemon) prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+    char *original = m.daemon ? NULL : read_stdin_text();
+
+    int init_result = atspi_init();
+    if (init_result != 0 && init_result != 1) {
+        print_status("", "NO_ELEMENT");
+        free(original);
+        helper_output_close(&output);
+        return 1;
+    }
+
+    m.loop = g_main_loop_new(NULL, FALSE);
+    if (m.daemon) {
+        m.apps = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_object_unref);
+    }
+
+    int exit_code = 0;
+    GIOChannel *commands = NULL;
+    if (m.daemon) {
+        commands = g_io_channel_unix_new(0);
+        g_io_channel_set_encoding(commands, NULL, NULL);
+        g_io_add_watch(commands, G_IO_IN | G_IO_HUP | G_IO_ERR, on_command_input, &m);
+        print_status("", "READY");
+    } else {
+        SessionResult result = start_session(&m, NULL, original ? original : "", target_pid);
+        exit_code = result == SESSION_NO_ELEMENT ? 1 : 0;
+    }
+    free(original);
+
+    if (m.daemon || m.session) {
+        g_unix_signal_add(SIGTERM, quit_loop, &m);
+        g_unix_signal_add(SIGINT, quit_loop, &m);
+        g_main_loop_run(m.loop);
+    }
+
+    if (m.session) free_session(m.session);
+    stop_listening(&m);
+    if (commands) g_io_channel_unref(commands);
+    if (m.apps) g_hash_table_destroy(m.apps);
+    g_main_loop_unref(m.loop);
+    helper_output_close(&output);
 
-    return 0;
+    return exit_code;
 }
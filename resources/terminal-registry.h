@@ -0,0 +1,345 @@
+/**
+ * Terminal registry shared by the native paste helpers
+ *
+ * Terminal emulators paste with Ctrl+Shift+V, so linux-fast-paste and
+ * windows-fast-paste both decide per window whether the target is one. The
+ * patterns live in one table (terminal_registry), each tagged with the
+ * platform it applies to, what it is matched against and whether it must
+ * match the whole string. At startup they are compiled, together with any
+ * user additions, into a single Aho-Corasick automaton over case-folded
+ * bytes, so a window class or executable name is classified in one pass
+ * however many patterns there are.
+ *
+ * Patterns can be added without rebuilding. The file named by
+ * OPENWHISPR_TERMINALS_FILE (the app points it at terminals.conf in its user
+ * data directory; without it $XDG_CONFIG_HOME/OpenWhispr/terminals.conf or
+ * %APPDATA%\OpenWhispr\terminals.conf) holds one "<kind> <pattern>" per line,
+ * with "#" starting a comment:
+ *
+ *   class   myterm          # substring of the window class (WM_CLASS on X11)
+ *   exe     myterm          # substring of the executable name
+ *   class=  MyTermWindow    # whole window class, case-insensitive
+ *   exe=    myterm.exe      # whole executable name, case-insensitive
+ */
+
+#ifndef OPENWHISPR_TERMINAL_REGISTRY_H
+#define OPENWHISPR_TERMINAL_REGISTRY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TERMINAL_MATCH_CLASS      0x01  /* WM_CLASS class/instance, or the Win32 class name */
+#define TERMINAL_MATCH_EXE        0x02  /* executable basename */
+#define TERMINAL_MATCH_EXACT      0x04  /* whole string instead of substring */
+#define TERMINAL_PLATFORM_LINUX   0x10
+#define TERMINAL_PLATFORM_WINDOWS 0x20
+
+#define TERMINAL_REGISTRY_LINE_MAX 512
+
+typedef struct {
+    const char *pattern;
+    unsigned flags;
+} TerminalPattern;
+
+#define LINUX_TERMINAL (TERMINAL_PLATFORM_LINUX | TERMINAL_MATCH_CLASS | TERMINAL_MATCH_EXE)
+#define WINDOWS_TERMINAL_CLASS \
+    (TERMINAL_PLATFORM_WINDOWS | TERMINAL_MATCH_CLASS | TERMINAL_MATCH_EXACT)
+#define WINDOWS_TERMINAL_EXE \
+    (TERMINAL_PLATFORM_WINDOWS | TERMINAL_MATCH_EXE | TERMINAL_MATCH_EXACT)
+
+static const TerminalPattern terminal_registry[] = {
+    /* X11 WM_CLASS and process names. Substrings, as WM_CLASS carries
+       variants such as "org.gnome.Terminal" or "kitty-quick-access". */
+    { "konsole", LINUX_TERMINAL },
+    { "gnome-terminal", LINUX_TERMINAL },
+    { "terminal", LINUX_TERMINAL },
+    { "kitty", LINUX_TERMINAL },
+    { "alacritty", LINUX_TERMINAL },
+    { "terminator", LINUX_TERMINAL },
+    { "xterm", LINUX_TERMINAL },
+    { "urxvt", LINUX_TERMINAL },
+    { "rxvt", LINUX_TERMINAL },
+    { "tilix", LINUX_TERMINAL },
+    { "terminology", LINUX_TERMINAL },
+    { "wezterm", LINUX_TERMINAL },
+    { "foot", LINUX_TERMINAL },
+    { "st", LINUX_TERMINAL },
+    { "yakuake", LINUX_TERMINAL },
+    { "ghostty", LINUX_TERMINAL },
+    { "guake", LINUX_TERMINAL },
+    { "tilda", LINUX_TERMINAL },
+    { "hyper", LINUX_TERMINAL },
+    { "tabby", LINUX_TERMINAL },
+    { "sakura", LINUX_TERMINAL },
+    { "warp", LINUX_TERMINAL },
+    { "termius", LINUX_TERMINAL },
+
+    /* Win32 window classes */
+    { "ConsoleWindowClass", WINDOWS_TERMINAL_CLASS },
+    { "CASCADIA_HOSTING_WINDOW_CLASS", WINDOWS_TERMINAL_CLASS },
+    { "mintty", WINDOWS_TERMINAL_CLASS },
+    { "VirtualConsoleClass", WINDOWS_TERMINAL_CLASS },
+    { "PuTTY", WINDOWS_TERMINAL_CLASS },
+    { "Alacritty", WINDOWS_TERMINAL_CLASS },
+    { "org.wezfurlong.wezterm", WINDOWS_TERMINAL_CLASS },
+    { "Hyper", WINDOWS_TERMINAL_CLASS },
+    { "TMobaXterm", WINDOWS_TERMINAL_CLASS },
+    { "kitty", WINDOWS_TERMINAL_CLASS },
+
+    /* Electron-based terminals share Chrome_WidgetWin_1 as window class,
+       so they are recognised by executable name instead */
+    { "termius.exe", WINDOWS_TERMINAL_EXE },
+    { "tabby.exe", WINDOWS_TERMINAL_EXE },
+    { "wave.exe", WINDOWS_TERMINAL_EXE },
+    { "rio.exe", WINDOWS_TERMINAL_EXE },
+    { NULL, 0 }
+};
+
+/*
+ * Dense automaton: every node has a transition for every alphabet symbol,
+ * with the failure links already folded in. Bytes that occur in no pattern
+ * share symbol 0, which keeps the table a few KB.
+ */
+typedef struct {
+    unsigned char symbol[256];  /* case-folded byte -> alphabet index */
+    int columns;                /* alphabet size, including symbol 0 */
+    int *next;                  /* node * columns + symbol -> node */
+    int *depth;                 /* length of the prefix the node spells */
+    unsigned char *kinds;       /* substring match kinds ending here or at a suffix */
+    unsigned char *exact_kinds; /* whole-string match kinds spelled exactly by the node */
+} TerminalMatcher;
+
+typedef struct {
+    char *text;
+    unsigned flags;
+} TerminalRegistryEntry;
+
+typedef struct {
+    TerminalRegistryEntry *items;
+    int count;
+    int capacity;
+} TerminalRegistryList;
+
+static unsigned char terminal_registry_fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + ('a' - 'A')) : c;
+}
+
+static int terminal_registry_add(TerminalRegistryList *list, const char *text, size_t len,
+                                 unsigned flags) {
+    if (len == 0) return 0;
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 64;
+        TerminalRegistryEntry *items = (TerminalRegistryEntry *)realloc(
+            list->items, (size_t)capacity * sizeof(TerminalRegistryEntry));
+        if (!items) return -1;
+        list->items = items;
+        list->capacity = capacity;
+    }
+    char *copy = (char *)malloc(len + 1);
+    if (!copy) return -1;
+    for (size_t i = 0; i < len; i++) copy[i] = (char)terminal_registry_fold((unsigned char)text[i]);
+    copy[len] = '\0';
+    list->items[list->count].text = copy;
+    list->items[list->count].flags = flags;
+    list->count++;
+    return 0;
+}
+
+static FILE *terminal_registry_open_user_file(void) {
+    const char *path = getenv("OPENWHISPR_TERMINALS_FILE");
+    if (path && *path) return fopen(path, "r");
+
+    char buf[4096];
+#ifdef _WIN32
+    const char *appdata = getenv("APPDATA");
+    if (!appdata || !*appdata) return NULL;
+    snprintf(buf, sizeof(buf), "%s\\OpenWhispr\\terminals.conf", appdata);
+#else
+    const char *config = getenv("XDG_CONFIG_HOME");
+    const char *home = getenv("HOME");
+    if (config && *config) {
+        snprintf(buf, sizeof(buf), "%s/OpenWhispr/terminals.conf", config);
+    } else if (home && *home) {
+        snprintf(buf, sizeof(buf), "%s/.config/OpenWhispr/terminals.conf", home);
+    } else {
+        return NULL;
+    }
+#endif
+    return fopen(buf, "r");
+}
+
+/* Appends the user's patterns; malformed lines are reported on stderr and skipped */
+static int terminal_registry_load_user_file(TerminalRegistryList *list) {
+    FILE *f = terminal_registry_open_user_file();
+    if (!f) return 0;
+
+    char line[TERMINAL_REGISTRY_LINE_MAX];
+    int line_no = 0;
+    int rc = 0;
+    while (rc == 0 && fgets(line, sizeof(line), f)) {
+        line_no++;
+        char *kind = line + strspn(line, " \t");
+        if (*kind == '#' || *kind == '\n' || *kind == '\r' || *kind == '\0') continue;
+
+        size_t kind_len = strcspn(kind, " \t\r\n");
+        char *pattern = kind + kind_len;
+        pattern += strspn(pattern, " \t");
+        size_t pattern_len = strcspn(pattern, "#\r\n");
+        while (pattern_len > 0 && (pattern[pattern_len - 1] == ' ' ||
+                                   pattern[pattern_len - 1] == '\t'))
+            pattern_len--;
+
+        unsigned flags;
+        if (kind_len == 5 && strncmp(kind, "class", 5) == 0) {
+            flags = TERMINAL_MATCH_CLASS;
+        } else if (kind_len == 6 && strncmp(kind, "class=", 6) == 0) {
+            flags = TERMINAL_MATCH_CLASS | TERMINAL_MATCH_EXACT;
+        } else if (kind_len == 3 && strncmp(kind, "exe", 3) == 0) {
+            flags = TERMINAL_MATCH_EXE;
+        } else if (kind_len == 4 && strncmp(kind, "exe=", 4) == 0) {
+            flags = TERMINAL_MATCH_EXE | TERMINAL_MATCH_EXACT;
+        } else {
+            fprintf(stderr, "terminals.conf:%d: unknown kind '%.*s'\n", line_no,
+                    (int)kind_len, kind);
+            continue;
+        }
+        if (pattern_len == 0) {
+            fprintf(stderr, "terminals.conf:%d: missing pattern\n", line_no);
+            continue;
+        }
+        rc = terminal_registry_add(list, pattern, pattern_len, flags);
+    }
+    fclose(f);
+    return rc;
+}
+
+static void terminal_registry_list_free(TerminalRegistryList *list) {
+    for (int i = 0; i < list->count; i++) free(list->items[i].text);
+    free(list->items);
+}
+
+static void terminal_matcher_free(TerminalMatcher *m) {
+    free(m->next);
+    free(m->depth);
+    free(m->kinds);
+    free(m->exact_kinds);
+    memset(m, 0, sizeof(*m));
+}
+
+static int terminal_matcher_compile(TerminalMatcher *m, const TerminalRegistryList *list) {
+    int max_nodes = 1;
+    m->columns = 1;
+    for (int i = 0; i < list->count; i++) {
+        for (const unsigned char *p = (const unsigned char *)list->items[i].text; *p; p++) {
+            if (!m->symbol[*p]) m->symbol[*p] = (unsigned char)m->columns++;
+            max_nodes++;
+        }
+    }
+
+    m->next = (int *)malloc((size_t)max_nodes * m->columns * sizeof(int));
+    m->depth = (int *)calloc((size_t)max_nodes, sizeof(int));
+    m->kinds = (unsigned char *)calloc((size_t)max_nodes, 1);
+    m->exact_kinds = (unsigned char *)calloc((size_t)max_nodes, 1);
+    int *fail = (int *)calloc((size_t)max_nodes, sizeof(int));
+    int *queue = (int *)malloc((size_t)max_nodes * sizeof(int));
+    if (!m->next || !m->depth || !m->kinds || !m->exact_kinds || !fail || !queue) {
+        free(fail);
+        free(queue);
+        return -1;
+    }
+    for (int i = 0; i < max_nodes * m->columns; i++) m->next[i] = -1;
+
+    /* Trie of all patterns */
+    int nodes = 1;
+    for (int i = 0; i < list->count; i++) {
+        int node = 0;
+        for (const unsigned char *p = (const unsigned char *)list->items[i].text; *p; p++) {
+            int *slot = &m->next[node * m->columns + m->symbol[*p]];
+            if (*slot < 0) {
+                m->depth[nodes] = m->depth[node] + 1;
+                *slot = nodes++;
+            }
+            node = *slot;
+        }
+        unsigned kind = list->items[i].flags & (TERMINAL_MATCH_CLASS | TERMINAL_MATCH_EXE);
+        if (list->items[i].flags & TERMINAL_MATCH_EXACT) {
+            m->exact_kinds[node] |= (unsigned char)kind;
+        } else {
+            m->kinds[node] |= (unsigned char)kind;
+        }
+    }
+
+    /* Breadth-first failure links; missing transitions borrow the failure
+       node's, and substring kinds are inherited from the failure node so a
+       match never needs to walk the suffix chain */
+    int head = 0, tail = 0;
+    for (int s = 0; s < m->columns; s++) {
+        int *slot = &m->next[s];
+        if (*slot < 0) {
+            *slot = 0;
+        } else {
+            fail[*slot] = 0;
+            queue[tail++] = *slot;
+        }
+    }
+    while (head < tail) {
+        int node = queue[head++];
+        m->kinds[node] |= m->kinds[fail[node]];
+        for (int s = 0; s < m->columns; s++) {
+            int *slot = &m->next[node * m->columns + s];
+            int via_fail = m->next[fail[node] * m->columns + s];
+            if (*slot < 0) {
+                *slot = via_fail;
+            } else {
+                fail[*slot] = via_fail;
+                queue[tail++] = *slot;
+            }
+        }
+    }
+
+    free(fail);
+    free(queue);
+    return 0;
+}
+
+/*
+ * Builds the matcher from the built-in patterns for platform (one of
+ * TERMINAL_PLATFORM_*) plus the user's file. Returns 0 on success; on
+ * allocation failure the matcher is left empty and matches nothing.
+ */
+static int terminal_matcher_init(TerminalMatcher *m, unsigned platform) {
+    memset(m, 0, sizeof(*m));
+
+    TerminalRegistryList list = { NULL, 0, 0 };
+    int rc = 0;
+    for (int i = 0; rc == 0 && terminal_registry[i].pattern; i++) {
+        if (terminal_registry[i].flags & platform) {
+            rc = terminal_registry_add(&list, terminal_registry[i].pattern,
+                                       strlen(terminal_registry[i].pattern),
+                                       terminal_registry[i].flags);
+        }
+    }
+    if (rc == 0) rc = terminal_registry_load_user_file(&list);
+    if (rc == 0) rc = terminal_matcher_compile(m, &list);
+    terminal_registry_list_free(&list);
+
+    if (rc != 0) terminal_matcher_free(m);
+    return rc;
+}
+
+/* True if s matches a pattern registered for kind (TERMINAL_MATCH_CLASS or _EXE) */
+static int terminal_matcher_match(const TerminalMatcher *m, unsigned kind, const char *s) {
+    if (!s || !m->next) return 0;
+
+    int state = 0;
+    int len = 0;
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++, len++) {
+        state = m->next[state * m->columns + m->symbol[terminal_registry_fold(*p)]];
+        if (m->kinds[state] & kind) return 1;
+    }
+    /* The final state spells the whole string only if its depth is the length */
+    return m->depth[state] == len && (m->exact_kinds[state] & kind) != 0;
+}
+
+#endif
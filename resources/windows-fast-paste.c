@@ -9,6 +9,8 @@
  * Terminal detection uses two strategies:
  *   1. Window class name (fast, works for native terminals)
  *   2. Executable name (fallback, catches Electron-based terminals like Termius)
+ * Both are looked up in the registry shared with linux-fast-paste
+ * (terminal-registry.h), which users can extend through terminals.conf.
  *
  * Compile with: cl /O2 windows-fast-paste.c /Fe:windows-fast-paste.exe user32.lib
  * Or with MinGW: gcc -O2 windows-fast-paste.c -o windows-fast-paste.exe -luser32
@@ -19,37 +21,13 @@
 #include <stdio.h>
 #include <string.h>
 
-static const char* TERMINAL_CLASSES[] = {
-    "ConsoleWindowClass",
-    "CASCADIA_HOSTING_WINDOW_CLASS",
-    "mintty",
-    "VirtualConsoleClass",
-    "PuTTY",
-    "Alacritty",
-    "org.wezfurlong.wezterm",
-    "Hyper",
-    "TMobaXterm",
-    "kitty",
-    NULL
-};
-
-/* Electron-based terminals share Chrome_WidgetWin_1 as window class,
-   so we detect them by executable name instead */
-static const char* TERMINAL_EXES[] = {
-    "termius.exe",
-    "tabby.exe",
-    "wave.exe",
-    "rio.exe",
-    NULL
-};
+#include "terminal-registry.h"
+
+/* Built once in main from terminal_registry and the user's terminals.conf */
+static TerminalMatcher terminalMatcher;
 
 static BOOL IsTerminalClass(const char* className) {
-    for (int i = 0; TERMINAL_CLASSES[i] != NULL; i++) {
-        if (_stricmp(className, TERMINAL_CLASSES[i]) == 0) {
-            return TRUE;
-        }
-    }
-    return FALSE;
+    return terminal_matcher_match(&terminalMatcher, TERMINAL_MATCH_CLASS, className) ? TRUE : FALSE;
 }
 
 static BOOL GetExeName(HWND hwnd, char* exeName, DWORD exeNameSize) {
@@ -76,12 +54,7 @@ static BOOL GetExeName(HWND hwnd, char* exeName, DWORD exeNameSize) {
 }
 
 static BOOL IsTerminalExe(const char* exeName) {
-    for (int i = 0; TERMINAL_EXES[i] != NULL; i++) {
-        if (_stricmp(exeName, TERMINAL_EXES[i]) == 0) {
-            return TRUE;
-        }
-    }
-    return FALSE;
+    return terminal_matcher_match(&terminalMatcher, TERMINAL_MATCH_EXE, exeName) ? TRUE : FALSE;
 }
 
 static int SendPasteNormal(void) {
@@ -138,6 +111,8 @@ static int SendPasteTerminal(void) {
 int main(int argc, char* argv[]) {
     BOOL detectOnly = FALSE;
 
+    terminal_matcher_init(&terminalMatcher, TERMINAL_PLATFORM_WINDOWS);
+
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--detect-only") == 0) {
             detectOnly = TRUE;
@@ -13,6 +13,16 @@
  *   NO_ELEMENT            - Could not get focused element
  *   NO_VALUE              - Focused element has no text value
  *
+ * With --framing=binary the first line is "FRAMING binary 1", and each
+ * message after it is a header line plus raw UTF-8, with no base64 for
+ * multiline values:
+ *   <TYPE> <length>\n<length bytes>
+ * NO_ELEMENT and NO_VALUE frames have length 0. stdout is switched to binary
+ * mode so the CRT does not turn "\n" in a payload into "\r\n".
+ *
+ * Usage:
+ *   windows-text-monitor [--framing=binary]
+ *
  * Input (stdin):
  *   First line: original pasted text (informational)
  *
@@ -25,51 +35,31 @@
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <io.h>
 
 #define COBJMACROS
 #include <windows.h>
 #include <oleauto.h>
 #include <uiautomation.h>
 
+#include "helper-output.h"
+
 #define TIMEOUT_MS 30000
 #define POLL_INTERVAL_MS 500
 #define MAX_OUTPUT_CHARS 10240
 
 static volatile int running = 1;
-static const char BASE64_TABLE[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static HelperOutput output;
+static OutputBuffer utf8_value; /* Reused for every UTF-8 conversion */
 
 void signal_handler(int sig) {
     (void)sig;
     running = 0;
 }
 
-char *base64_encode(const unsigned char *data, size_t len) {
-    size_t out_len = 4 * ((len + 2) / 3);
-    char *out = (char *)malloc(out_len + 1);
-    if (!out) return NULL;
-
-    size_t i = 0, j = 0;
-    while (i < len) {
-        unsigned int octet_a = i < len ? data[i++] : 0;
-        unsigned int octet_b = i < len ? data[i++] : 0;
-        unsigned int octet_c = i < len ? data[i++] : 0;
-        unsigned int triple = (octet_a << 16) | (octet_b << 8) | octet_c;
-
-        out[j++] = BASE64_TABLE[(triple >> 18) & 0x3F];
-        out[j++] = BASE64_TABLE[(triple >> 12) & 0x3F];
-        out[j++] = BASE64_TABLE[(triple >> 6) & 0x3F];
-        out[j++] = BASE64_TABLE[triple & 0x3F];
-    }
-
-    if (len % 3 == 1) {
-        out[out_len - 1] = '=';
-        out[out_len - 2] = '=';
-    } else if (len % 3 == 2) {
-        out[out_len - 1] = '=';
-    }
-
-    out[out_len] = '\0';
-    return out;
+void print_status(const char *status) {
+    helper_output_status(&output, "", status);
 }
 
 void print_text_output(const char *name, const WCHAR *value) {
@@ -79,38 +69,36 @@ void print_text_output(const char *name, const WCHAR *value) {
     int needed = WideCharToMultiByte(CP_UTF8, 0, value, -1, NULL, 0, NULL, NULL);
     if (needed <= 0) return;
 
-    char *utf8 = (char *)malloc((size_t)needed);
-    if (!utf8) return;
+    utf8_value.len = 0;
+    if (output_buffer_reserve(&utf8_value, (size_t)needed) != 0) return;
 
-    int written = WideCharToMultiByte(CP_UTF8, 0, value, -1, utf8, needed, NULL, NULL);
-    if (written <= 0) {
-        free(utf8);
-        return;
-    }
-    utf8[needed - 1] = '\0';
+    int written = WideCharToMultiByte(CP_UTF8, 0, value, -1, utf8_value.data, needed, NULL, NULL);
+    if (written <= 0) return;
+    utf8_value.data[needed - 1] = '\0';
 
-    size_t utf8_len = strlen(utf8);
+    size_t utf8_len = strlen(utf8_value.data);
     size_t limit = utf8_len < MAX_OUTPUT_CHARS ? utf8_len : MAX_OUTPUT_CHARS;
+    helper_output_value(&output, "", name, utf8_value.data, limit);
+}
 
-    if (memchr(utf8, '\n', limit) || memchr(utf8, '\r', limit)) {
-        char *encoded = base64_encode((const unsigned char *)utf8, limit);
-        if (encoded) {
-            printf("%s_B64:%s\n", name, encoded);
-            fflush(stdout);
-            free(encoded);
-        }
-    } else {
-        printf("%s:%.*s\n", name, (int)limit, utf8);
-        fflush(stdout);
-    }
-
-    free(utf8);
+/* Also runs on the early returns in main */
+static void close_output(void) {
+    helper_output_close(&output);
+    output_buffer_free(&utf8_value);
 }
 
-int main(void) {
+int main(int argc, char *argv[]) {
     signal(SIGTERM, signal_handler);
     signal(SIGINT, signal_handler);
 
+    int binary_framing = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--framing=binary") == 0) binary_framing = 1;
+    }
+    if (binary_framing) _setmode(_fileno(stdout), _O_BINARY);
+    helper_output_init(&output, stdout, binary_framing);
+    atexit(close_output);
+
     /* Read original text from stdin (consume but don't use) */
     char stdin_buf[4096];
     if (fgets(stdin_buf, sizeof(stdin_buf), stdin)) {
@@ -121,8 +109,7 @@ int main(void) {
     HRESULT hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
     if (FAILED(hr)) {
         fprintf(stderr, "CoInitializeEx failed: 0x%lx\n", hr);
-        printf("NO_ELEMENT\n");
-        fflush(stdout);
+        print_status("NO_ELEMENT");
         return 1;
     }
 
@@ -134,8 +121,7 @@ int main(void) {
     );
     if (FAILED(hr) || !automation) {
         fprintf(stderr, "Failed to create IUIAutomation: 0x%lx\n", hr);
-        printf("NO_ELEMENT\n");
-        fflush(stdout);
+        print_status("NO_ELEMENT");
         CoUninitialize();
         return 1;
     }
@@ -145,8 +131,7 @@ int main(void) {
     hr = IUIAutomation_GetFocusedElement(automation, &focused);
     if (FAILED(hr) || !focused) {
         fprintf(stderr, "Failed to get focused element: 0x%lx\n", hr);
-        printf("NO_ELEMENT\n");
-        fflush(stdout);
+        print_status("NO_ELEMENT");
         IUIAutomation_Release(automation);
         CoUninitialize();
         return 1;
@@ -167,8 +152,7 @@ int main(void) {
         if (SUCCEEDED(hr) && lastValue) {
             print_text_output("INITIAL_VALUE", lastValue);
         } else {
-            printf("NO_VALUE\n");
-            fflush(stdout);
+            print_status("NO_VALUE");
             IUIAutomationValuePattern_Release(valuePattern);
             IUIAutomationElement_Release(focused);
             IUIAutomation_Release(automation);
@@ -183,8 +167,7 @@ int main(void) {
             /* Element has a name but no editable value — not a text field */
             SysFreeString(name);
         }
-        printf("NO_VALUE\n");
-        fflush(stdout);
+        print_status("NO_VALUE");
         IUIAutomationElement_Release(focused);
         IUIAutomation_Release(automation);
         CoUninitialize();
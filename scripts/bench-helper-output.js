@@ -0,0 +1,85 @@
+#!/usr/bin/env node
+/**
+ * Correctness checks and microbenchmark for resources/helper-output.h, the
+ * output writer and base64 encoders shared by the native text monitors.
+ *
+ * Compiles scripts/bench/helper-output-bench.c, which checks every base64
+ * encoder the CPU supports against the scalar one and the writer's line and
+ * frame output, then times them. Prints the report as JSON and fails if a
+ * check did.
+ *
+ * Usage:
+ *   node scripts/bench-helper-output.js [--runs <n>]
+ *
+ * Report:
+ *   selected               - Encoder the monitors pick on this CPU
+ *   checks                 - Mismatches per encoder and for the writer (all 0)
+ *   base64_mb_per_s        - Input MB/s per encoder, by input size in bytes
+ *   writer_messages_per_s  - 10 KB multiline CHANGED messages per second, flushed
+ *                            one by one (a pipe) or buffered (a regular file)
+ */
+
+const { spawnSync } = require("child_process");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+
+const projectRoot = path.resolve(__dirname, "..");
+const benchSource = path.join(__dirname, "bench", "helper-output-bench.c");
+
+function log(message) {
+  console.error(`[bench-helper-output] ${message}`);
+}
+
+function parseArgs(argv) {
+  const options = { runs: 5 };
+  for (let i = 0; i < argv.length; i++) {
+    const arg = argv[i];
+    if (arg === "--runs") options.runs = Number(argv[++i]);
+    else throw new Error(`Unknown argument ${arg}`);
+  }
+  if (!Number.isInteger(options.runs) || options.runs < 1 || options.runs > 64) {
+    throw new Error("--runs must be an integer between 1 and 64");
+  }
+  return options;
+}
+
+function main() {
+  if (process.platform !== "linux") {
+    log("The helper output benchmark only runs on Linux");
+    process.exit(0);
+  }
+
+  const options = parseArgs(process.argv.slice(2));
+  const workDir = fs.mkdtempSync(path.join(os.tmpdir(), "openwhispr-output-bench-"));
+  try {
+    const binary = path.join(workDir, "helper-output-bench");
+    const compile = spawnSync(
+      "gcc",
+      ["-O2", "-I", path.join(projectRoot, "resources"), benchSource, "-o", binary],
+      { stdio: "inherit" }
+    );
+    if (compile.status !== 0) throw new Error("Failed to compile the benchmark");
+
+    log(`Running ${options.runs} rounds`);
+    const result = spawnSync(binary, ["--runs", String(options.runs)], {
+      stdio: ["ignore", "pipe", "inherit"],
+      encoding: "utf8",
+    });
+    const report = JSON.parse(result.stdout);
+    console.log(JSON.stringify(report, null, 2));
+    if (result.status !== 0) {
+      log("An encoder or the writer produced wrong output");
+      process.exitCode = 1;
+    }
+  } finally {
+    fs.rmSync(workDir, { recursive: true, force: true });
+  }
+}
+
+try {
+  main();
+} catch (error) {
+  log(error.message);
+  process.exit(1);
+}
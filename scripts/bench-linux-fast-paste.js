@@ -0,0 +1,321 @@
+#!/usr/bin/env node
+/**
+ * End-to-end paste latency benchmark for linux-fast-paste.
+ *
+ * Starts a headless Xvfb (no GPU needed) and a minimal paste target
+ * (scripts/bench/linux-paste-target.c), drives resources/bin/linux-fast-paste
+ * --runs times per scenario and prints p50/p95/p99 latencies and the failure
+ * rate as JSON, so regressions in activate_window() timing or key sequencing
+ * show up before release.
+ *
+ * Usage:
+ *   node scripts/bench-linux-fast-paste.js [--runs <n>] [--scenarios xtest,window,uinput]
+ *       [--serve] [--display <:n>] [--wm <command>] [--max-failure-rate <0..1>]
+ *
+ * Scenarios:
+ *   xtest  - XTest keystroke with the helper serving CLIPBOARD (--clipboard-stdin),
+ *            the path OpenWhispr takes on X11
+ *   window - same with --window; the focus is moved to a decoy window first, so
+ *            every paste goes through activate_window()
+ *   uinput - uinput keystroke with the target owning CLIPBOARD. Needs a writable
+ *            /dev/uinput and an X server that reads evdev devices, so it only runs
+ *            against --display, never on Xvfb
+ *
+ * Latencies, in microseconds on CLOCK_MONOTONIC (shared by the helper's --trace
+ * output, the target and process.hrtime):
+ *   inject_to_key_us     - helper's first key down to the target's KeyPress
+ *   inject_to_receipt_us - first key down to the target holding the pasted text
+ *   end_to_end_us        - spawn (or, with --serve, command write) to receipt
+ *
+ * A bare Xvfb has no window manager, so the window scenario measures
+ * activate_window()'s fallback (timeout, then XSetInputFocus) unless --wm
+ * starts one, e.g. --wm openbox.
+ */
+
+const { spawn, spawnSync } = require("child_process");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+const {
+  LineReader,
+  nowUs,
+  parseJsonLine,
+  percentiles,
+  sleep,
+  startXvfb,
+} = require("./lib/bench-utils");
+
+const projectRoot = path.resolve(__dirname, "..");
+const helperBinary = path.join(projectRoot, "resources", "bin", "linux-fast-paste");
+const targetSource = path.join(__dirname, "bench", "linux-paste-target.c");
+
+const PASTE_TIMEOUT_MS = 2000;
+const READY_TIMEOUT_MS = 5000;
+const WM_SETTLE_MS = 500;
+const ALL_SCENARIOS = ["xtest", "window", "uinput"];
+
+function log(message) {
+  console.error(`[bench-linux-fast-paste] ${message}`);
+}
+
+function parseArgs(argv) {
+  const options = {
+    runs: 100,
+    scenarios: ALL_SCENARIOS,
+    serve: false,
+    display: null,
+    wm: null,
+    maxFailureRate: null,
+  };
+  for (let i = 0; i < argv.length; i++) {
+    const arg = argv[i];
+    if (arg === "--runs") options.runs = Number(argv[++i]);
+    else if (arg === "--scenarios") options.scenarios = argv[++i].split(",");
+    else if (arg === "--serve") options.serve = true;
+    else if (arg === "--display") options.display = argv[++i];
+    else if (arg === "--wm") options.wm = argv[++i];
+    else if (arg === "--max-failure-rate") options.maxFailureRate = Number(argv[++i]);
+    else throw new Error(`Unknown argument ${arg}`);
+  }
+  if (!Number.isInteger(options.runs) || options.runs < 1) {
+    throw new Error("--runs must be a positive integer");
+  }
+  for (const scenario of options.scenarios) {
+    if (!ALL_SCENARIOS.includes(scenario)) throw new Error(`Unknown scenario ${scenario}`);
+  }
+  return options;
+}
+
+function parseTrace(line) {
+  const match = line && line.match(/^trace (\{.*\})$/);
+  return match ? parseJsonLine(match[1]) : null;
+}
+
+function compileTarget(workDir) {
+  const output = path.join(workDir, "linux-paste-target");
+  const result = spawnSync("gcc", ["-O2", targetSource, "-o", output, "-lX11"], {
+    stdio: "inherit",
+  });
+  if (result.status !== 0) throw new Error("Failed to compile the paste target (needs libx11-dev)");
+  return output;
+}
+
+/** Runs one paste through a one-shot helper process */
+function pasteOneShot(env, args, clipboardText) {
+  return new Promise((resolve) => {
+    const startedUs = nowUs();
+    const helperArgs = clipboardText !== null ? [...args, "--clipboard-stdin"] : args;
+    const proc = spawn(helperBinary, helperArgs, { env });
+    let stderr = "";
+    proc.stdout.resume();
+    proc.stderr.on("data", (data) => {
+      stderr += data.toString();
+    });
+    if (clipboardText !== null) {
+      proc.stdin.on("error", () => {});
+      proc.stdin.end(clipboardText);
+    }
+    proc.on("error", () => resolve({ startedUs, rc: -1, trace: null }));
+    proc.on("close", (code) => {
+      const trace = stderr.split("\n").map(parseTrace).find(Boolean) || null;
+      resolve({ startedUs, rc: code, trace });
+    });
+  });
+}
+
+/** Runs one paste through a resident --serve helper */
+async function pasteServed(server, args, clipboardText) {
+  server.stderr.clear();
+  const payload = clipboardText !== null ? Buffer.from(clipboardText, "utf8") : null;
+  const commandArgs = payload ? ["--clipboard-bytes", String(payload.length), ...args] : args;
+  const startedUs = nowUs();
+  server.proc.stdin.write(["PASTE", ...commandArgs].join(" ") + "\n");
+  if (payload) server.proc.stdin.write(payload);
+
+  const reply = await server.stdout.take((l) => l !== "READY", PASTE_TIMEOUT_MS);
+  const trace = parseTrace(await server.stderr.take((l) => l.startsWith("trace "), 100));
+  if (reply === null) return { startedUs, rc: -1, trace };
+  const match = reply.match(/^ERR (\d+)/);
+  return { startedUs, rc: match ? Number(match[1]) : 0, trace };
+}
+
+async function runTrial(context, scenario, index) {
+  const { target, ready, options } = context;
+  const text = `openwhispr-bench-${scenario}-${index}`;
+  target.clear();
+
+  const args = [];
+  let clipboardText = text;
+  if (scenario === "window") {
+    target.proc.stdin.write("DECOY\n");
+    await target.take((l) => l.includes('"command":"DECOY"'), READY_TIMEOUT_MS);
+    args.push("--window", String(ready.window));
+  } else if (scenario === "uinput") {
+    target.proc.stdin.write(`OWN ${text}\n`);
+    await target.take((l) => l.includes('"command":"OWN"'), READY_TIMEOUT_MS);
+    args.push("--uinput");
+    clipboardText = null;
+  }
+  args.push("--trace");
+
+  const received = target.take((l) => parseJsonLine(l)?.text === text, PASTE_TIMEOUT_MS);
+  const result = options.serve
+    ? await pasteServed(context.server, args, clipboardText)
+    : await pasteOneShot(context.env, args, clipboardText);
+  const paste = parseJsonLine(await received);
+
+  if (scenario === "window") {
+    target.proc.stdin.write("FOCUS\n");
+    await target.take((l) => l.includes('"command":"FOCUS"'), READY_TIMEOUT_MS);
+  }
+
+  if (result.rc !== 0) return { ok: false, reason: `exit ${result.rc}` };
+  if (!paste) return { ok: false, reason: "text not received" };
+  if (paste.shift) return { ok: false, reason: "terminal keystroke sent" };
+
+  const keyDownUs =
+    result.trace && result.trace.key_down !== undefined
+      ? result.trace.t0_us + result.trace.key_down
+      : null;
+  return {
+    ok: true,
+    injectToKeyUs: keyDownUs !== null ? paste.key_us - keyDownUs : null,
+    injectToReceiptUs: keyDownUs !== null ? paste.received_us - keyDownUs : null,
+    endToEndUs: paste.received_us - result.startedUs,
+  };
+}
+
+async function runScenario(context, scenario) {
+  const trials = [];
+  for (let i = 0; i < context.options.runs; i++) {
+    trials.push(await runTrial(context, scenario, i));
+  }
+
+  const ok = trials.filter((trial) => trial.ok);
+  const errors = {};
+  for (const trial of trials) {
+    if (!trial.ok) errors[trial.reason] = (errors[trial.reason] || 0) + 1;
+  }
+  const collect = (key) => ok.map((trial) => trial[key]).filter((value) => value !== null);
+  return {
+    runs: trials.length,
+    failures: trials.length - ok.length,
+    failure_rate: (trials.length - ok.length) / trials.length,
+    inject_to_key_us: percentiles(collect("injectToKeyUs")),
+    inject_to_receipt_us: percentiles(collect("injectToReceiptUs")),
+    end_to_end_us: percentiles(collect("endToEndUs")),
+    errors,
+  };
+}
+
+function uinputSkipReason(options) {
+  if (!options.display) {
+    return "Xvfb does not read evdev devices; use --display with a real X server";
+  }
+  try {
+    fs.accessSync("/dev/uinput", fs.constants.W_OK);
+    return null;
+  } catch {
+    return "/dev/uinput is not writable";
+  }
+}
+
+async function main() {
+  if (process.platform !== "linux") {
+    log("The paste benchmark only runs on Linux");
+    process.exit(0);
+  }
+
+  const options = parseArgs(process.argv.slice(2));
+  if (!fs.existsSync(helperBinary)) {
+    throw new Error(`${helperBinary} not found; run npm run compile:linux-paste first`);
+  }
+
+  const processes = [];
+  const workDir = fs.mkdtempSync(path.join(os.tmpdir(), "openwhispr-paste-bench-"));
+  const cleanup = () => {
+    for (const proc of processes.reverse()) {
+      try {
+        proc.kill("SIGTERM");
+      } catch {}
+    }
+    fs.rmSync(workDir, { recursive: true, force: true });
+  };
+  process.on("SIGINT", () => {
+    cleanup();
+    process.exit(130);
+  });
+
+  try {
+    const targetBinary = compileTarget(workDir);
+    const display = options.display || (await startXvfb(processes));
+    const env = { ...process.env, DISPLAY: display };
+    delete env.WAYLAND_DISPLAY;
+    log(`Using display ${display}`);
+
+    if (options.wm) {
+      const [command, ...args] = options.wm.split(/\s+/);
+      const wm = spawn(command, args, { env, stdio: "ignore" });
+      wm.on("error", (error) => log(`Window manager failed to start: ${error.message}`));
+      processes.push(wm);
+      await sleep(WM_SETTLE_MS);
+    }
+
+    const targetProc = spawn(targetBinary, [], { env, stdio: ["pipe", "pipe", "inherit"] });
+    processes.push(targetProc);
+    const target = new LineReader(targetProc.stdout);
+    target.proc = targetProc;
+    const ready = parseJsonLine(
+      await target.take((l) => parseJsonLine(l)?.event === "ready", READY_TIMEOUT_MS)
+    );
+    if (!ready) throw new Error("Paste target did not become ready");
+
+    const context = { options, env, target, ready, server: null };
+    if (options.serve) {
+      const proc = spawn(helperBinary, ["--serve"], { env, stdio: ["pipe", "pipe", "pipe"] });
+      processes.push(proc);
+      context.server = {
+        proc,
+        stdout: new LineReader(proc.stdout),
+        stderr: new LineReader(proc.stderr),
+      };
+      if ((await context.server.stdout.take((l) => l === "READY", READY_TIMEOUT_MS)) === null) {
+        throw new Error("linux-fast-paste --serve did not become ready");
+      }
+    }
+
+    const report = {
+      binary: helperBinary,
+      display: options.display ? display : `Xvfb ${display}`,
+      window_manager: options.wm,
+      mode: options.serve ? "serve" : "oneshot",
+      runs: options.runs,
+      scenarios: {},
+    };
+    let worstFailureRate = 0;
+    for (const scenario of options.scenarios) {
+      const skip = scenario === "uinput" ? uinputSkipReason(options) : null;
+      if (skip) {
+        report.scenarios[scenario] = { skipped: skip };
+        continue;
+      }
+      log(`Running ${options.runs} ${scenario} pastes`);
+      const result = await runScenario(context, scenario);
+      report.scenarios[scenario] = result;
+      worstFailureRate = Math.max(worstFailureRate, result.failure_rate);
+    }
+
+    console.log(JSON.stringify(report, null, 2));
+    if (options.maxFailureRate !== null && worstFailureRate > options.maxFailureRate) {
+      log(`Failure rate ${worstFailureRate} exceeds ${options.maxFailureRate}`);
+      process.exitCode = 1;
+    }
+  } finally {
+    cleanup();
+  }
+}
+
+main().catch((error) => {
+  log(error.message);
+  process.exit(1);
+});
@@ -0,0 +1,341 @@
+#!/usr/bin/env node
+/**
+ * Correctness and latency benchmark for linux-key-listener.
+ *
+ * Runs resources/bin/linux-key-listener with one hotkey per scenario, starts
+ * a key injector (scripts/bench/linux-inject-keys.c) next to it and replays a
+ * key sequence --runs times, checking that KEY_DOWN and KEY_UP arrive after
+ * the expected key events and nowhere else. Prints the failure rate and
+ * p50/p95/p99 latencies as JSON.
+ *
+ * Usage:
+ *   node scripts/bench-linux-key-listener.js [--backend xinput|evdev] [--runs <n>]
+ *       [--scenarios key,compound,...] [--display <:n>] [--max-failure-rate <0..1>]
+ *
+ * Backends:
+ *   xinput - The default. XTest key events on a headless Xvfb (or --display)
+ *   evdev  - linux-key-listener --evdev, fed by a uinput virtual keyboard.
+ *            The keyboard is created after the listener is ready, so every
+ *            scenario also covers hot-plug. Needs a writable /dev/uinput and
+ *            readable /dev/input/event*; the keys reach the focused app too
+ *
+ * Scenarios:
+ *   key              - F8 pressed and released
+ *   compound         - Control+Shift+Space, main key released first
+ *   modifier-release - Control+Shift+Space, Control released first
+ *   right-modifier   - RightControl; a left Control tap before it must not count
+ *   modifier-only    - Control+Super
+ *   grabbed          - F9 while another client holds a passive grab on it, the
+ *                      way Electron's globalShortcut does (xinput only)
+ *
+ * Latencies, in microseconds on CLOCK_MONOTONIC:
+ *   key_to_event_us - injector sending the key to the listener's line reaching Node
+ */
+
+const { spawn, spawnSync } = require("child_process");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+const {
+  LineReader,
+  nowUs,
+  parseJsonLine,
+  percentiles,
+  sleep,
+  startXvfb,
+} = require("./lib/bench-utils");
+
+const projectRoot = path.resolve(__dirname, "..");
+const listenerBinary = path.join(projectRoot, "resources", "bin", "linux-key-listener");
+const injectorSource = path.join(__dirname, "bench", "linux-inject-keys.c");
+
+const EVENT_TIMEOUT_MS = 1000;
+const READY_TIMEOUT_MS = 5000;
+// Time allowed for stray output to show up after a sequence
+const QUIET_MS = 20;
+
+// expect maps a step index to the line the listener must print after it
+const SCENARIOS = {
+  key: {
+    hotkey: "F8",
+    steps: ["+F8", "-F8"],
+    expect: { 0: "KEY_DOWN", 1: "KEY_UP" },
+  },
+  compound: {
+    hotkey: "Control+Shift+Space",
+    steps: ["+Control_L", "+Shift_L", "+space", "-space", "-Shift_L", "-Control_L"],
+    expect: { 2: "KEY_DOWN", 3: "KEY_UP" },
+  },
+  "modifier-release": {
+    hotkey: "Control+Shift+Space",
+    steps: ["+Control_L", "+Shift_L", "+space", "-Control_L", "-space", "-Shift_L"],
+    expect: { 2: "KEY_DOWN", 3: "KEY_UP" },
+  },
+  "right-modifier": {
+    hotkey: "RightControl",
+    steps: ["+Control_L", "-Control_L", "+Control_R", "-Control_R"],
+    expect: { 2: "KEY_DOWN", 3: "KEY_UP" },
+  },
+  "modifier-only": {
+    hotkey: "Control+Super",
+    steps: ["+Control_L", "+Super_L", "-Super_L", "-Control_L"],
+    expect: { 1: "KEY_DOWN", 2: "KEY_UP" },
+  },
+  grabbed: {
+    hotkey: "F9",
+    grab: "F9",
+    xinputOnly: true,
+    steps: ["+F9", "-F9"],
+    expect: { 0: "KEY_DOWN", 1: "KEY_UP" },
+  },
+};
+
+function log(message) {
+  console.error(`[bench-linux-key-listener] ${message}`);
+}
+
+function parseArgs(argv) {
+  const options = {
+    backend: "xinput",
+    runs: 50,
+    scenarios: Object.keys(SCENARIOS),
+    display: null,
+    maxFailureRate: null,
+  };
+  for (let i = 0; i < argv.length; i++) {
+    const arg = argv[i];
+    if (arg === "--backend") options.backend = argv[++i];
+    else if (arg === "--runs") options.runs = Number(argv[++i]);
+    else if (arg === "--scenarios") options.scenarios = argv[++i].split(",");
+    else if (arg === "--display") options.display = argv[++i];
+    else if (arg === "--max-failure-rate") options.maxFailureRate = Number(argv[++i]);
+    else throw new Error(`Unknown argument ${arg}`);
+  }
+  if (!["xinput", "evdev"].includes(options.backend)) {
+    throw new Error("--backend must be xinput or evdev");
+  }
+  if (!Number.isInteger(options.runs) || options.runs < 1) {
+    throw new Error("--runs must be a positive integer");
+  }
+  for (const scenario of options.scenarios) {
+    if (!SCENARIOS[scenario]) throw new Error(`Unknown scenario ${scenario}`);
+  }
+  return options;
+}
+
+function compileInjector(workDir) {
+  const output = path.join(workDir, "linux-inject-keys");
+  const result = spawnSync("gcc", ["-O2", injectorSource, "-o", output, "-lX11", "-lXtst"], {
+    stdio: "inherit",
+  });
+  if (result.status !== 0) {
+    throw new Error("Failed to compile the key injector (needs libx11-dev and libxtst-dev)");
+  }
+  return output;
+}
+
+async function sendStep(injector, step) {
+  injector.proc.stdin.write(`${step}\n`);
+  const reply = parseJsonLine(
+    await injector.take((l) => parseJsonLine(l)?.event !== undefined, READY_TIMEOUT_MS)
+  );
+  if (reply?.event !== "sent") throw new Error(`Injector could not send ${step}`);
+  return reply.us;
+}
+
+async function runTrial(listener, injector, scenario) {
+  listener.clear();
+  const latencies = [];
+  let failure = null;
+
+  for (let i = 0; i < scenario.steps.length; i++) {
+    const sentUs = await sendStep(injector, scenario.steps[i]);
+    const expected = scenario.expect[i];
+    if (!expected || failure) continue;
+
+    if (listener.lines.length > 0) {
+      failure = `early ${listener.lines[0]}`;
+      continue;
+    }
+    const line = await listener.take(() => true, EVENT_TIMEOUT_MS);
+    if (line === null) {
+      failure = `missing ${expected}`;
+    } else if (line !== expected) {
+      failure = `${line} instead of ${expected}`;
+    } else {
+      latencies.push(nowUs() - sentUs);
+    }
+  }
+
+  await sleep(QUIET_MS);
+  if (!failure && listener.lines.length > 0) failure = `stray ${listener.lines[0]}`;
+  return failure ? { ok: false, reason: failure } : { ok: true, latencies };
+}
+
+/** Starts the listener, then the injector, and waits until both are ready */
+async function startPair(context, scenario) {
+  const { env, injectorBinary, options, processes } = context;
+  const evdev = options.backend === "evdev";
+
+  const listenerArgs = evdev ? ["--evdev", scenario.hotkey] : [scenario.hotkey];
+  const listenerProc = spawn(listenerBinary, listenerArgs, {
+    env,
+    stdio: ["ignore", "pipe", "pipe"],
+  });
+  processes.push(listenerProc);
+  const listener = new LineReader(listenerProc.stdout);
+  const listenerLog = new LineReader(listenerProc.stderr);
+  if ((await listener.take((l) => l === "READY", READY_TIMEOUT_MS)) === null) {
+    throw new Error(`linux-key-listener ${listenerArgs.join(" ")} did not become ready`);
+  }
+
+  const injectorProc = spawn(injectorBinary, evdev ? ["--uinput"] : [], {
+    env,
+    stdio: ["pipe", "pipe", "inherit"],
+  });
+  processes.push(injectorProc);
+  const injector = new LineReader(injectorProc.stdout);
+  injector.proc = injectorProc;
+  const ready = parseJsonLine(
+    await injector.take((l) => parseJsonLine(l)?.event === "ready", READY_TIMEOUT_MS)
+  );
+  if (!ready) throw new Error("Key injector did not become ready");
+
+  // The listener has to pick the new keyboard up through its inotify watch
+  if (evdev) {
+    const added = await listenerLog.take(
+      (l) => l.startsWith("Added ") && l.includes(ready.device),
+      READY_TIMEOUT_MS
+    );
+    if (added === null) throw new Error("linux-key-listener did not add the uinput keyboard");
+  }
+
+  if (scenario.grab) {
+    injectorProc.stdin.write(`GRAB ${scenario.grab}\n`);
+    await injector.take((l) => parseJsonLine(l)?.command === "GRAB", READY_TIMEOUT_MS);
+  }
+  return { listener, listenerProc, injector, injectorProc };
+}
+
+async function runScenario(context, name) {
+  const scenario = SCENARIOS[name];
+  if (scenario.xinputOnly && context.options.backend !== "xinput") {
+    return { skipped: "xinput only" };
+  }
+
+  const { listener, listenerProc, injector, injectorProc } = await startPair(context, scenario);
+  const trials = [];
+  for (let i = 0; i < context.options.runs; i++) {
+    trials.push(await runTrial(listener, injector, scenario));
+  }
+  injectorProc.stdin.end("QUIT\n");
+  listenerProc.kill("SIGTERM");
+
+  const ok = trials.filter((trial) => trial.ok);
+  const errors = {};
+  for (const trial of trials) {
+    if (!trial.ok) errors[trial.reason] = (errors[trial.reason] || 0) + 1;
+  }
+  return {
+    hotkey: scenario.hotkey,
+    runs: trials.length,
+    failures: trials.length - ok.length,
+    failure_rate: (trials.length - ok.length) / trials.length,
+    key_to_event_us: percentiles(ok.flatMap((trial) => trial.latencies)),
+    errors,
+  };
+}
+
+function evdevSkipReason() {
+  try {
+    fs.accessSync("/dev/uinput", fs.constants.W_OK);
+  } catch {
+    return "/dev/uinput is not writable";
+  }
+  const devices = fs.existsSync("/dev/input") ? fs.readdirSync("/dev/input") : [];
+  const readable = devices
+    .filter((name) => name.startsWith("event"))
+    .some((name) => {
+      try {
+        fs.accessSync(path.join("/dev/input", name), fs.constants.R_OK);
+        return true;
+      } catch {
+        return false;
+      }
+    });
+  return readable ? null : "/dev/input/event* is not readable (not in the input group?)";
+}
+
+async function main() {
+  if (process.platform !== "linux") {
+    log("The key listener benchmark only runs on Linux");
+    process.exit(0);
+  }
+
+  const options = parseArgs(process.argv.slice(2));
+  if (!fs.existsSync(listenerBinary)) {
+    throw new Error(`${listenerBinary} not found; run npm run compile:linux-keys first`);
+  }
+
+  const processes = [];
+  const workDir = fs.mkdtempSync(path.join(os.tmpdir(), "openwhispr-key-bench-"));
+  const cleanup = () => {
+    for (const proc of processes.reverse()) {
+      try {
+        proc.kill("SIGTERM");
+      } catch {}
+    }
+    fs.rmSync(workDir, { recursive: true, force: true });
+  };
+  process.on("SIGINT", () => {
+    cleanup();
+    process.exit(130);
+  });
+
+  try {
+    const injectorBinary = compileInjector(workDir);
+    const env = { ...process.env };
+    let display = null;
+    if (options.backend === "evdev") {
+      const skip = evdevSkipReason();
+      if (skip) {
+        console.log(JSON.stringify({ backend: options.backend, skipped: skip }, null, 2));
+        return;
+      }
+    } else {
+      display = options.display || (await startXvfb(processes));
+      env.DISPLAY = display;
+      delete env.WAYLAND_DISPLAY;
+      log(`Using display ${display}`);
+    }
+
+    const context = { options, env, injectorBinary, processes };
+    const report = {
+      binary: listenerBinary,
+      backend: options.backend,
+      display: display && (options.display ? display : `Xvfb ${display}`),
+      runs: options.runs,
+      scenarios: {},
+    };
+    let worstFailureRate = 0;
+    for (const scenario of options.scenarios) {
+      log(`Running ${options.runs} ${scenario} sequences`);
+      const result = await runScenario(context, scenario);
+      report.scenarios[scenario] = result;
+      if (!result.skipped) worstFailureRate = Math.max(worstFailureRate, result.failure_rate);
+    }
+
+    console.log(JSON.stringify(report, null, 2));
+    if (options.maxFailureRate !== null && worstFailureRate > options.maxFailureRate) {
+      log(`Failure rate ${worstFailureRate} exceeds ${options.maxFailureRate}`);
+      process.exitCode = 1;
+    }
+  } finally {
+    cleanup();
+  }
+}
+
+main().catch((error) => {
+  log(error.message);
+  process.exit(1);
+});
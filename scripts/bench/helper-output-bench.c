@@ -0,0 +1,210 @@
+/**
+ * Microbenchmark for resources/helper-output.h
+ *
+ * Checks every base64 encoder the CPU supports against the scalar one (RFC
+ * 4648 vectors, then random input of every length up to CHECK_MAX_LEN) and
+ * the writer's line and frame output, then times each encoder on field-sized
+ * inputs and the writer with and without a flush per message.
+ * scripts/bench-helper-output.js compiles and runs it.
+ *
+ * Usage:
+ *   helper-output-bench [--runs <n>]
+ *
+ * Output (stdout, one JSON object):
+ *   {"selected":"<encoder>","checks":{...},"base64_mb_per_s":{...},
+ *    "writer_messages_per_s":{...}}
+ * Exits with 1 if a check failed.
+ *
+ * Compile with: gcc -O2 -I resources helper-output-bench.c -o helper-output-bench
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "helper-output.h"
+
+#define CHECK_MAX_LEN 1024
+#define WRITER_MESSAGES 20000
+
+typedef struct {
+    const char *name;
+    Base64BulkEncoder bulk;
+    int available;
+} Encoder;
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ULL;
+
+static unsigned char next_byte(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (unsigned char)rng_state;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t encode_with(const Encoder *e, char *out, const unsigned char *data, size_t len) {
+    size_t done = e->bulk(out, data, len);
+    return done / 3 * 4 + base64_encode_scalar(out + done / 3 * 4, data + done, len - done);
+}
+
+/* Returns the number of mismatches */
+static int check_encoder(const Encoder *e) {
+    static const char *const vectors[][2] = {
+        { "", "" },         { "f", "Zg==" },         { "fo", "Zm8=" },
+        { "foo", "Zm9v" },  { "foob", "Zm9vYg==" },  { "fooba", "Zm9vYmE=" },
+        { "foobar", "Zm9vYmFy" },
+    };
+    int failures = 0;
+    char out[4 * (CHECK_MAX_LEN / 3 + 1) + 1];
+    char expected[sizeof(out)];
+    unsigned char data[CHECK_MAX_LEN];
+
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        size_t n = encode_with(e, out, (const unsigned char *)vectors[i][0], strlen(vectors[i][0]));
+        if (n != strlen(vectors[i][1]) || memcmp(out, vectors[i][1], n) != 0) failures++;
+    }
+    for (size_t len = 0; len <= CHECK_MAX_LEN; len++) {
+        for (size_t i = 0; i < len; i++) data[i] = next_byte();
+        size_t want = base64_encode_scalar(expected, data, len);
+        size_t n = encode_with(e, out, data, len);
+        if (n != want || memcmp(out, expected, n) != 0) failures++;
+    }
+    return failures;
+}
+
+/* Writes through a HelperOutput into a temporary file and compares the bytes */
+static int check_writer(int binary_framing, const char *expected, size_t expected_len) {
+    FILE *f = tmpfile();
+    if (!f) return 1;
+    HelperOutput out;
+    helper_output_init(&out, f, binary_framing);
+    helper_output_value(&out, "7 ", "CHANGED", "a\nb", 3);
+    helper_output_value(&out, "", "INITIAL_VALUE", "plain", 5);
+    helper_output_delta(&out, "", 2, 1, "xy", 2);
+    helper_output_status(&out, "", "NO_VALUE");
+    helper_output_close(&out);
+
+    char got[256];
+    rewind(f);
+    size_t n = fread(got, 1, sizeof(got), f);
+    fclose(f);
+    return n != expected_len || memcmp(got, expected, n) != 0;
+}
+
+static double median(double *values, int count) {
+    for (int i = 1; i < count; i++) {
+        for (int j = i; j > 0 && values[j - 1] > values[j]; j--) {
+            double t = values[j];
+            values[j] = values[j - 1];
+            values[j - 1] = t;
+        }
+    }
+    return values[count / 2];
+}
+
+/* MB/s of input encoded, median over runs */
+static double time_encoder(const Encoder *e, const unsigned char *data, size_t len, int runs) {
+    char *out = (char *)malloc(4 * (len / 3 + 1));
+    size_t iterations = (64u << 20) / len;
+    double rates[64];
+    volatile char sink = 0;
+    for (int r = 0; r < runs; r++) {
+        double start = now_s();
+        for (size_t i = 0; i < iterations; i++) {
+            encode_with(e, out, data, len);
+            sink ^= out[0];
+        }
+        rates[r] = (double)iterations * len / (now_s() - start) / 1e6;
+    }
+    (void)sink;
+    free(out);
+    return median(rates, runs);
+}
+
+/* Messages per second written to /dev/null, median over runs */
+static double time_writer(int interactive, const char *value, size_t len, int runs) {
+    double rates[64];
+    for (int r = 0; r < runs; r++) {
+        FILE *f = fopen("/dev/null", "w");
+        if (!f) return 0;
+        HelperOutput out;
+        helper_output_init(&out, f, 0);
+        out.interactive = interactive;
+        double start = now_s();
+        for (int i = 0; i < WRITER_MESSAGES; i++) {
+            helper_output_value(&out, "", "CHANGED", value, len);
+        }
+        helper_output_close(&out);
+        rates[r] = WRITER_MESSAGES / (now_s() - start);
+        fclose(f);
+    }
+    return median(rates, runs);
+}
+
+int main(int argc, char *argv[]) {
+    int runs = 5;
+    if (argc > 2 && strcmp(argv[1], "--runs") == 0) runs = atoi(argv[2]);
+    if (runs < 1 || runs > 64) {
+        fprintf(stderr, "--runs must be between 1 and 64\n");
+        return 2;
+    }
+
+    base64_select_encoder();
+    Encoder encoders[] = {
+        { "scalar", base64_bulk_none, 1 },
+#ifdef HELPER_OUTPUT_X86
+        { "sse4.1", base64_bulk_sse41, base64_cpu_has_sse41() },
+        { "avx2", base64_bulk_avx2, base64_cpu_has_avx2() },
+#endif
+    };
+    size_t encoder_count = sizeof(encoders) / sizeof(encoders[0]);
+
+    static const char line_output[] =
+        "7 CHANGED_B64:YQpi\nINITIAL_VALUE:plain\nDELTA:2:1:eHk=\nNO_VALUE\n";
+    static const char frame_output[] = "FRAMING binary 1\n7 CHANGED 3\na\nbINITIAL_VALUE 5\nplain"
+                                       "DELTA 6\n2:1:xyNO_VALUE 0\n";
+    int line_failures = check_writer(0, line_output, sizeof(line_output) - 1);
+    int frame_failures = check_writer(1, frame_output, sizeof(frame_output) - 1);
+    int failed = line_failures || frame_failures;
+
+    printf("{\"selected\":\"%s\",\"checks\":{", base64_bulk_name);
+    for (size_t i = 0; i < encoder_count; i++) {
+        if (!encoders[i].available) continue;
+        int failures = check_encoder(&encoders[i]);
+        failed |= failures != 0;
+        printf("\"%s\":%d,", encoders[i].name, failures);
+    }
+    printf("\"writer_lines\":%d,\"writer_frames\":%d},", line_failures, frame_failures);
+
+    static const size_t sizes[] = { 64, 1024, 10240 };
+    printf("\"base64_mb_per_s\":{");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        unsigned char *data = (unsigned char *)malloc(sizes[s]);
+        for (size_t i = 0; i < sizes[s]; i++) data[i] = next_byte();
+        printf("%s\"%zu\":{", s ? "," : "", sizes[s]);
+        int first = 1;
+        for (size_t i = 0; i < encoder_count; i++) {
+            if (!encoders[i].available) continue;
+            printf("%s\"%s\":%.0f", first ? "" : ",", encoders[i].name,
+                   time_encoder(&encoders[i], data, sizes[s], runs));
+            first = 0;
+        }
+        printf("}");
+        free(data);
+    }
+
+    char value[10240];
+    for (size_t i = 0; i < sizeof(value); i++) value[i] = (char)('a' + i % 26);
+    value[100] = '\n';
+    printf("},\"writer_messages_per_s\":{\"flush_per_message\":%.0f,\"buffered\":%.0f}}\n",
+           time_writer(1, value, sizeof(value), runs), time_writer(0, value, sizeof(value), runs));
+    return failed ? 1 : 0;
+}
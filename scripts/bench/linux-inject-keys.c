@@ -0,0 +1,195 @@
+/**
+ * Key injector for the linux-key-listener benchmark
+ *
+ * Presses and releases keys on request, so scripts/bench-linux-key-listener.js
+ * can drive the listener without a person at the keyboard: through XTest on
+ * an X server (e.g. a headless Xvfb), or with --uinput through a virtual
+ * keyboard the kernel exposes as a new /dev/input/event* device, which is
+ * what linux-key-listener --evdev reads. Keys are named by X keysym ("F8",
+ * "Control_L", "space"); uinput only knows the names in uinput_keys.
+ * Timestamps are CLOCK_MONOTONIC microseconds, like Node's process.hrtime.
+ *
+ * Usage:
+ *   linux-inject-keys [--uinput]
+ *
+ * Protocol (stdin):
+ *   +<keysym>     - Press the key
+ *   -<keysym>     - Release the key
+ *   GRAB <keysym> - Passively grab the key on the root window (with any
+ *                   modifiers), the way a global shortcut does. XTest only
+ *   QUIT
+ *
+ * Protocol (stdout, one JSON object per line):
+ *   {"event":"ready","device":"<name>"}
+ *   {"event":"sent","us":<t>}    - Taken right before sending, per +/- line
+ *   {"event":"ack","command":"GRAB"}
+ *   {"event":"error","line":"..."}
+ *
+ * Compile with: gcc -O2 linux-inject-keys.c -o linux-inject-keys -lX11 -lXtst
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/XTest.h>
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#define UINPUT_DEVICE_NAME "OpenWhispr bench keyboard"
+
+typedef struct {
+    const char *name;
+    unsigned short code;
+} UinputKey;
+
+static const UinputKey uinput_keys[] = {
+    { "F8", KEY_F8 },
+    { "F9", KEY_F9 },
+    { "space", KEY_SPACE },
+    { "Control_L", KEY_LEFTCTRL },
+    { "Control_R", KEY_RIGHTCTRL },
+    { "Shift_L", KEY_LEFTSHIFT },
+    { "Shift_R", KEY_RIGHTSHIFT },
+    { "Alt_L", KEY_LEFTALT },
+    { "Alt_R", KEY_RIGHTALT },
+    { "Super_L", KEY_LEFTMETA },
+    { "Super_R", KEY_RIGHTMETA },
+};
+
+typedef struct {
+    Display *dpy;   /* XTest */
+    int uinput_fd;  /* --uinput, -1 otherwise */
+} Injector;
+
+static long long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int uinput_code_for(const char *name) {
+    for (size_t i = 0; i < sizeof(uinput_keys) / sizeof(uinput_keys[0]); i++) {
+        if (strcmp(uinput_keys[i].name, name) == 0) return uinput_keys[i].code;
+    }
+    return 0;
+}
+
+static KeyCode keycode_for(Display *dpy, const char *name) {
+    KeySym sym = XStringToKeysym(name);
+    return sym != NoSymbol ? XKeysymToKeycode(dpy, sym) : 0;
+}
+
+static int uinput_open(void) {
+    int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    ioctl(fd, UI_SET_EVBIT, EV_KEY);
+    ioctl(fd, UI_SET_EVBIT, EV_SYN);
+    for (size_t i = 0; i < sizeof(uinput_keys) / sizeof(uinput_keys[0]); i++) {
+        ioctl(fd, UI_SET_KEYBIT, uinput_keys[i].code);
+    }
+
+    struct uinput_setup setup;
+    memset(&setup, 0, sizeof(setup));
+    setup.id.bustype = BUS_VIRTUAL;
+    snprintf(setup.name, sizeof(setup.name), "%s", UINPUT_DEVICE_NAME);
+    if (ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void uinput_emit(int fd, unsigned short type, unsigned short code, int value) {
+    struct input_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = type;
+    ev.code = code;
+    ev.value = value;
+    if (write(fd, &ev, sizeof(ev)) != (ssize_t)sizeof(ev)) perror("uinput write");
+}
+
+/* Returns 0 if the key is unknown */
+static int send_key(Injector *inj, const char *name, int press) {
+    if (inj->uinput_fd >= 0) {
+        int code = uinput_code_for(name);
+        if (!code) return 0;
+        printf("{\"event\":\"sent\",\"us\":%lld}\n", now_us());
+        uinput_emit(inj->uinput_fd, EV_KEY, (unsigned short)code, press);
+        uinput_emit(inj->uinput_fd, EV_SYN, SYN_REPORT, 0);
+        return 1;
+    }
+
+    KeyCode kc = keycode_for(inj->dpy, name);
+    if (!kc) return 0;
+    long long sent_us = now_us();
+    XTestFakeKeyEvent(inj->dpy, kc, press, CurrentTime);
+    XSync(inj->dpy, False);
+    printf("{\"event\":\"sent\",\"us\":%lld}\n", sent_us);
+    return 1;
+}
+
+static int grab_key(Injector *inj, const char *name) {
+    if (inj->uinput_fd >= 0) return 0;
+    KeyCode kc = keycode_for(inj->dpy, name);
+    if (!kc) return 0;
+    XGrabKey(inj->dpy, kc, AnyModifier, DefaultRootWindow(inj->dpy), False, GrabModeAsync,
+             GrabModeAsync);
+    XSync(inj->dpy, False);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    Injector inj = { NULL, -1 };
+
+    if (argc > 1 && strcmp(argv[1], "--uinput") == 0) {
+        inj.uinput_fd = uinput_open();
+        if (inj.uinput_fd < 0) {
+            perror("Cannot create a uinput keyboard");
+            return 1;
+        }
+        printf("{\"event\":\"ready\",\"device\":\"%s\"}\n", UINPUT_DEVICE_NAME);
+    } else {
+        inj.dpy = XOpenDisplay(NULL);
+        if (!inj.dpy) {
+            fprintf(stderr, "Cannot open X display\n");
+            return 1;
+        }
+        int event, error, major, minor;
+        if (!XTestQueryExtension(inj.dpy, &event, &error, &major, &minor)) {
+            fprintf(stderr, "X server has no XTest extension\n");
+            return 1;
+        }
+        puts("{\"event\":\"ready\",\"device\":\"XTest\"}");
+    }
+    fflush(stdout);
+
+    char line[256];
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strcmp(line, "QUIT") == 0) break;
+
+        int ok;
+        if (strncmp(line, "GRAB ", 5) == 0) {
+            ok = grab_key(&inj, line + 5);
+            if (ok) puts("{\"event\":\"ack\",\"command\":\"GRAB\"}");
+        } else if (line[0] == '+' || line[0] == '-') {
+            ok = send_key(&inj, line + 1, line[0] == '+');
+        } else {
+            ok = line[0] == '\0';
+        }
+        if (!ok) printf("{\"event\":\"error\",\"line\":\"%s\"}\n", line);
+        fflush(stdout);
+    }
+
+    if (inj.uinput_fd >= 0) {
+        ioctl(inj.uinput_fd, UI_DEV_DESTROY);
+        close(inj.uinput_fd);
+    }
+    if (inj.dpy) XCloseDisplay(inj.dpy);
+    return 0;
+}
@@ -0,0 +1,257 @@
+/**
+ * Paste target for the linux-fast-paste benchmark
+ *
+ * A minimal X11 client for scripts/bench-linux-fast-paste.js. It maps a
+ * window, keeps the input focus on it and, for every Ctrl+V (matched on the
+ * XKB keysym, so any layout works), converts CLIPBOARD to UTF8_STRING and
+ * reports what it received. Timestamps are CLOCK_MONOTONIC microseconds, the
+ * clock linux-fast-paste --trace and Node's process.hrtime also use.
+ *
+ * Usage:
+ *   linux-paste-target
+ *
+ * Protocol (stdin):
+ *   OWN <text>  - Take CLIPBOARD with <text>, for backends that do not serve
+ *                 the clipboard themselves (uinput)
+ *   DECOY       - Move the focus to a second window, so a --window paste has
+ *                 to activate the target first
+ *   FOCUS       - Focus the target window
+ *   QUIT
+ *
+ * Protocol (stdout, one JSON object per line):
+ *   {"event":"ready","window":<id>,"decoy":<id>}
+ *   {"event":"ack","command":"<command>"}
+ *   {"event":"paste","key_us":<t>,"shift":<bool>,"received_us":<t>,"text":"..."}
+ *
+ * Compile with: gcc -O2 linux-paste-target.c -o linux-paste-target -lX11
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <X11/XKBlib.h>
+#include <X11/keysym.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+#define OWNED_TEXT_MAX 4096
+
+typedef struct {
+    Display *dpy;
+    Window win;
+    Window decoy;
+    Atom clipboard;
+    Atom utf8_string;
+    Atom targets;
+    Atom property;
+    char owned[OWNED_TEXT_MAX];
+    size_t owned_len;
+    long long pending_key_us;   /* -1 unless a conversion is in flight */
+    int pending_shift;
+} Target;
+
+static long long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void print_json_string(const char *s, size_t len) {
+    putchar('"');
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        } else if (c < 0x20) {
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
+        }
+    }
+    putchar('"');
+}
+
+static Window create_window(Display *dpy, const char *name) {
+    Window win = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy), 0, 0, 320, 120, 0,
+                                     BlackPixel(dpy, DefaultScreen(dpy)),
+                                     WhitePixel(dpy, DefaultScreen(dpy)));
+    XStoreName(dpy, win, name);
+    XClassHint hint = { (char *)name, (char *)"OpenWhisprBench" };
+    XSetClassHint(dpy, win, &hint);
+    XSelectInput(dpy, win, KeyPressMask | FocusChangeMask | StructureNotifyMask);
+    XMapWindow(dpy, win);
+    return win;
+}
+
+static void wait_for_map(Display *dpy, Window win) {
+    XEvent ev;
+    do {
+        XWindowEvent(dpy, win, StructureNotifyMask, &ev);
+    } while (ev.type != MapNotify);
+}
+
+static void handle_key(Target *t, XKeyEvent *key) {
+    KeySym sym = XkbKeycodeToKeysym(t->dpy, key->keycode, XkbGroupForCoreState(key->state), 0);
+    if ((sym != XK_v && sym != XK_V) || !(key->state & ControlMask)) return;
+
+    t->pending_key_us = now_us();
+    t->pending_shift = (key->state & ShiftMask) != 0;
+    XDeleteProperty(t->dpy, t->win, t->property);
+    XConvertSelection(t->dpy, t->clipboard, t->utf8_string, t->property, t->win, key->time);
+    XFlush(t->dpy);
+}
+
+static void handle_selection_notify(Target *t, XSelectionEvent *sel) {
+    if (t->pending_key_us < 0) return;
+
+    unsigned char *data = NULL;
+    unsigned long nitems = 0, bytes_after;
+    Atom actual_type;
+    int actual_format;
+    if (sel->property != None) {
+        XGetWindowProperty(t->dpy, t->win, t->property, 0, OWNED_TEXT_MAX / 4, True,
+                           AnyPropertyType, &actual_type, &actual_format, &nitems,
+                           &bytes_after, &data);
+    }
+
+    printf("{\"event\":\"paste\",\"key_us\":%lld,\"shift\":%s,\"received_us\":%lld,\"text\":",
+           t->pending_key_us, t->pending_shift ? "true" : "false", now_us());
+    if (data) {
+        print_json_string((const char *)data, nitems);
+        XFree(data);
+    } else {
+        fputs("null", stdout);
+    }
+    puts("}");
+    fflush(stdout);
+    t->pending_key_us = -1;
+}
+
+static void handle_selection_request(Target *t, XSelectionRequestEvent *req) {
+    XSelectionEvent reply;
+    memset(&reply, 0, sizeof(reply));
+    reply.type = SelectionNotify;
+    reply.requestor = req->requestor;
+    reply.selection = req->selection;
+    reply.target = req->target;
+    reply.time = req->time;
+    reply.property = req->property != None ? req->property : req->target;
+
+    if (req->target == t->targets) {
+        Atom supported[] = { t->targets, t->utf8_string, XA_STRING };
+        XChangeProperty(t->dpy, req->requestor, reply.property, XA_ATOM, 32, PropModeReplace,
+                        (unsigned char *)supported, 3);
+    } else if (req->target == t->utf8_string || req->target == XA_STRING) {
+        XChangeProperty(t->dpy, req->requestor, reply.property, req->target, 8,
+                        PropModeReplace, (unsigned char *)t->owned, (int)t->owned_len);
+    } else {
+        reply.property = None;
+    }
+    XSendEvent(t->dpy, req->requestor, False, NoEventMask, (XEvent *)&reply);
+    XFlush(t->dpy);
+}
+
+static void focus(Target *t, Window win) {
+    XSetInputFocus(t->dpy, win, RevertToParent, CurrentTime);
+    XSync(t->dpy, False);
+}
+
+/* Returns 0 once QUIT (or EOF) is seen */
+static int handle_command(Target *t, char *line) {
+    if (strncmp(line, "OWN ", 4) == 0) {
+        size_t len = strlen(line + 4);
+        if (len >= OWNED_TEXT_MAX) len = OWNED_TEXT_MAX - 1;
+        memcpy(t->owned, line + 4, len);
+        t->owned_len = len;
+        XSetSelectionOwner(t->dpy, t->clipboard, t->win, CurrentTime);
+        XSync(t->dpy, False);
+    } else if (strcmp(line, "DECOY") == 0) {
+        focus(t, t->decoy);
+    } else if (strcmp(line, "FOCUS") == 0) {
+        focus(t, t->win);
+    } else if (strcmp(line, "QUIT") == 0) {
+        return 0;
+    } else {
+        return 1;
+    }
+    printf("{\"event\":\"ack\",\"command\":\"%.*s\"}\n", (int)strcspn(line, " "), line);
+    fflush(stdout);
+    return 1;
+}
+
+int main(void) {
+    Target t;
+    memset(&t, 0, sizeof(t));
+    t.pending_key_us = -1;
+
+    int xkb_major = XkbMajorVersion, xkb_minor = XkbMinorVersion;
+    t.dpy = XkbOpenDisplay(NULL, NULL, NULL, &xkb_major, &xkb_minor, NULL);
+    if (!t.dpy) {
+        fprintf(stderr, "Cannot open X display with XKB\n");
+        return 1;
+    }
+
+    t.clipboard = XInternAtom(t.dpy, "CLIPBOARD", False);
+    t.utf8_string = XInternAtom(t.dpy, "UTF8_STRING", False);
+    t.targets = XInternAtom(t.dpy, "TARGETS", False);
+    t.property = XInternAtom(t.dpy, "OPENWHISPR_BENCH", False);
+
+    t.decoy = create_window(t.dpy, "openwhispr-bench-decoy");
+    t.win = create_window(t.dpy, "openwhispr-bench-target");
+    wait_for_map(t.dpy, t.decoy);
+    wait_for_map(t.dpy, t.win);
+    focus(&t, t.win);
+
+    printf("{\"event\":\"ready\",\"window\":%lu,\"decoy\":%lu}\n", t.win, t.decoy);
+    fflush(stdout);
+
+    char buf[OWNED_TEXT_MAX + 64];
+    size_t buffered = 0;
+    int running = 1;
+    while (running) {
+        while (XPending(t.dpy)) {
+            XEvent ev;
+            XNextEvent(t.dpy, &ev);
+            if (ev.type == KeyPress && ev.xkey.window == t.win) {
+                handle_key(&t, &ev.xkey);
+            } else if (ev.type == SelectionNotify) {
+                handle_selection_notify(&t, &ev.xselection);
+            } else if (ev.type == SelectionRequest) {
+                handle_selection_request(&t, &ev.xselectionrequest);
+            } else if (ev.type == MappingNotify) {
+                XRefreshKeyboardMapping(&ev.xmapping);
+            }
+        }
+
+        struct pollfd fds[2] = {
+            { .fd = ConnectionNumber(t.dpy), .events = POLLIN },
+            { .fd = STDIN_FILENO, .events = POLLIN },
+        };
+        if (poll(fds, 2, -1) < 0) break;
+        if (!(fds[1].revents & (POLLIN | POLLHUP))) continue;
+
+        ssize_t n = read(STDIN_FILENO, buf + buffered, sizeof(buf) - 1 - buffered);
+        if (n <= 0) break;
+        buffered += (size_t)n;
+        buf[buffered] = '\0';
+
+        char *line = buf;
+        char *newline;
+        while (running && (newline = strchr(line, '\n'))) {
+            *newline = '\0';
+            running = handle_command(&t, line);
+            line = newline + 1;
+        }
+        buffered = strlen(line);
+        memmove(buf, line, buffered);
+        if (buffered == sizeof(buf) - 1) buffered = 0;
+    }
+
+    XCloseDisplay(t.dpy);
+    return 0;
+}
@@ -12,9 +12,14 @@ if (!isLinux) {
 
 const projectRoot = path.resolve(__dirname, "..");
 const cSource = path.join(projectRoot, "resources", "linux-fast-paste.c");
+const registryHeader = path.join(projectRoot, "resources", "terminal-registry.h");
+const outputHeader = path.join(projectRoot, "resources", "helper-output.h");
 const outputDir = path.join(projectRoot, "resources", "bin");
 const outputBinary = path.join(outputDir, "linux-fast-paste");
 const hashFile = path.join(outputDir, ".linux-fast-paste.hash");
+const protocolDir = path.join(projectRoot, "resources", "linux", "protocols");
+const protocolGenDir = path.join(outputDir, "linux-fast-paste-protocols");
+const waylandProtocols = ["virtual-keyboard-unstable-v1", "wlr-data-control-unstable-v1"];
 
 function log(message) {
   console.log(`[linux-fast-paste] ${message}`);
@@ -37,8 +42,10 @@ let needsBuild = true;
 if (fs.existsSync(outputBinary)) {
   try {
     const binaryStat = fs.statSync(outputBinary);
-    const sourceStat = fs.statSync(cSource);
-    if (binaryStat.mtimeMs >= sourceStat.mtimeMs) {
+    const sourceMtime = Math.max(
+      ...[cSource, registryHeader, outputHeader].map((file) => fs.statSync(file).mtimeMs)
+    );
+    if (binaryStat.mtimeMs >= sourceMtime) {
       needsBuild = false;
     }
   } catch {
@@ -62,9 +69,37 @@ function hasUinputHeaders() {
 
 const uinputAvailable = hasUinputHeaders();
 
+function pkgConfig(args) {
+  try {
+    const result = spawnSync("pkg-config", args, { encoding: "utf8", env: process.env });
+    if (result.status === 0) return result.stdout.trim();
+  } catch {}
+  return null;
+}
+
+function hasWaylandScanner() {
+  try {
+    return spawnSync("wayland-scanner", ["--version"], { stdio: "ignore" }).status === 0;
+  } catch {
+    return false;
+  }
+}
+
+const waylandAvailable = pkgConfig(["--exists", "wayland-client"]) !== null && hasWaylandScanner();
+
 function computeBuildHash() {
-  const sourceContent = fs.readFileSync(cSource, "utf8");
-  const flags = uinputAvailable ? "uinput" : "nouinput";
+  let sourceContent = [cSource, registryHeader, outputHeader]
+    .map((file) => fs.readFileSync(file, "utf8"))
+    .join("");
+  if (waylandAvailable) {
+    for (const protocol of waylandProtocols) {
+      sourceContent += fs.readFileSync(path.join(protocolDir, `${protocol}.xml`), "utf8");
+    }
+  }
+  const flags = [
+    uinputAvailable ? "uinput" : "nouinput",
+    waylandAvailable ? "wayland" : "nowayland",
+  ].join(",");
   return crypto
     .createHash("sha256")
     .update(sourceContent + flags)
@@ -102,6 +137,26 @@ function attemptCompile(command, args) {
   });
 }
 
+// Generates the client glue for each vendored protocol; returns the .c files to compile
+function generateWaylandProtocols() {
+  ensureDir(protocolGenDir);
+  const sources = [];
+  for (const protocol of waylandProtocols) {
+    const xml = path.join(protocolDir, `${protocol}.xml`);
+    const header = path.join(protocolGenDir, `${protocol}-client-protocol.h`);
+    const code = path.join(protocolGenDir, `${protocol}-protocol.c`);
+    for (const [mode, output] of [
+      ["client-header", header],
+      ["private-code", code],
+    ]) {
+      const result = spawnSync("wayland-scanner", [mode, xml, output], { stdio: "inherit" });
+      if (result.status !== 0) return null;
+    }
+    sources.push(code);
+  }
+  return sources;
+}
+
 const compileArgs = ["-O2", cSource, "-o", outputBinary, "-lX11", "-lXtst"];
 
 if (uinputAvailable) {
@@ -111,6 +166,20 @@ if (uinputAvailable) {
   log("uinput headers not found, building without uinput support");
 }
 
+const waylandSources = waylandAvailable ? generateWaylandProtocols() : null;
+if (waylandSources) {
+  log("wayland-client found, enabling Wayland virtual keyboard and clipboard support");
+  const waylandFlags = pkgConfig(["--cflags", "--libs", "wayland-client"]) || "-lwayland-client";
+  compileArgs.push(
+    "-DHAVE_WAYLAND",
+    `-I${protocolGenDir}`,
+    ...waylandSources,
+    ...waylandFlags.split(/\s+/).filter(Boolean)
+  );
+} else {
+  log("wayland-client or wayland-scanner not found, building without Wayland support");
+}
+
 let result = attemptCompile("gcc", compileArgs);
 
 if (result.status !== 0) {
@@ -119,7 +188,7 @@ if (result.status !== 0) {
 
 if (result.status !== 0) {
   console.warn(
-    "[linux-fast-paste] Failed to compile Linux fast-paste binary. Install libx11-dev and libxtst-dev to enable native paste. Falling back to system tools."
+    "[linux-fast-paste] Failed to compile Linux fast-paste binary. Install libx11-dev and libxtst-dev (and libwayland-dev for the Wayland backend) to enable native paste. Falling back to system tools."
   );
   process.exit(0);
 }
@@ -22,6 +22,7 @@ if (!isLinux) {
 
 const projectRoot = path.resolve(__dirname, "..");
 const cSource = path.join(projectRoot, "resources", "linux-text-monitor.c");
+const outputHeader = path.join(projectRoot, "resources", "helper-output.h");
 const outputDir = path.join(projectRoot, "resources", "bin");
 const outputBinary = path.join(outputDir, "linux-text-monitor");
 const hashFile = path.join(outputDir, ".linux-text-monitor.hash");
@@ -36,6 +37,10 @@ function ensureDir(dirPath) {
   }
 }
 
+function readSources() {
+  return fs.readFileSync(cSource, "utf8") + fs.readFileSync(outputHeader, "utf8");
+}
+
 function isBinaryUpToDate() {
   if (!fs.existsSync(outputBinary)) {
     return false;
@@ -47,8 +52,8 @@ function isBinaryUpToDate() {
 
   try {
     const binaryStat = fs.statSync(outputBinary);
-    const sourceStat = fs.statSync(cSource);
-    if (binaryStat.mtimeMs < sourceStat.mtimeMs) {
+    const sourceMtime = Math.max(fs.statSync(cSource).mtimeMs, fs.statSync(outputHeader).mtimeMs);
+    if (binaryStat.mtimeMs < sourceMtime) {
       return false;
     }
   } catch {
@@ -59,7 +64,7 @@ function isBinaryUpToDate() {
   try {
     const pkgFlags = getPkgConfigFlags();
     const flagStr = pkgFlags ? pkgFlags.join(" ") : "";
-    const sourceContent = fs.readFileSync(cSource, "utf8");
+    const sourceContent = readSources();
     const currentHash = crypto
       .createHash("sha256")
       .update(sourceContent + flagStr)
@@ -165,7 +170,7 @@ function tryCompile() {
   }
 
   try {
-    const sourceContent = fs.readFileSync(cSource, "utf8");
+    const sourceContent = readSources();
     const flagStr = pkgFlags.join(" ");
     const hash = crypto
       .createHash("sha256")
@@ -22,6 +22,7 @@ if (!isWindows) {
 
 const projectRoot = path.resolve(__dirname, "..");
 const cSource = path.join(projectRoot, "resources", "windows-fast-paste.c");
+const registryHeader = path.join(projectRoot, "resources", "terminal-registry.h");
 const outputDir = path.join(projectRoot, "resources", "bin");
 const outputBinary = path.join(outputDir, "windows-fast-paste.exe");
 
@@ -46,8 +47,8 @@ function isBinaryUpToDate() {
 
   try {
     const binaryStat = fs.statSync(outputBinary);
-    const sourceStat = fs.statSync(cSource);
-    return binaryStat.mtimeMs >= sourceStat.mtimeMs;
+    const sourceMtime = Math.max(fs.statSync(cSource).mtimeMs, fs.statSync(registryHeader).mtimeMs);
+    return binaryStat.mtimeMs >= sourceMtime;
   } catch {
     return false;
   }
@@ -21,6 +21,7 @@ if (!isWindows) {
 
 const projectRoot = path.resolve(__dirname, "..");
 const cSource = path.join(projectRoot, "resources", "windows-text-monitor.c");
+const outputHeader = path.join(projectRoot, "resources", "helper-output.h");
 const outputDir = path.join(projectRoot, "resources", "bin");
 const outputBinary = path.join(outputDir, "windows-text-monitor.exe");
 
@@ -45,8 +46,8 @@ function isBinaryUpToDate() {
 
   try {
     const binaryStat = fs.statSync(outputBinary);
-    const sourceStat = fs.statSync(cSource);
-    return binaryStat.mtimeMs >= sourceStat.mtimeMs;
+    const sourceMtime = Math.max(fs.statSync(cSource).mtimeMs, fs.statSync(outputHeader).mtimeMs);
+    return binaryStat.mtimeMs >= sourceMtime;
   } catch {
     return false;
   }
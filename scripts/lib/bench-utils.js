@@ -0,0 +1,98 @@
+const { spawn } = require("child_process");
+
+const XVFB_READY_TIMEOUT_MS = 5000;
+
+/**
+ * Microseconds on CLOCK_MONOTONIC, the clock the native helpers' --trace
+ * output and the bench fixtures in scripts/bench report.
+ */
+function nowUs() {
+  return Number(process.hrtime.bigint() / 1000n);
+}
+
+function sleep(ms) {
+  return new Promise((resolve) => setTimeout(resolve, ms));
+}
+
+function parseJsonLine(line) {
+  try {
+    return JSON.parse(line);
+  } catch {
+    return null;
+  }
+}
+
+/** Buffers the lines of a stream and hands them out to whoever waits for one */
+class LineReader {
+  constructor(stream) {
+    this.lines = [];
+    this.waiters = [];
+    this.buffer = "";
+    stream.setEncoding("utf8");
+    stream.on("data", (chunk) => {
+      this.buffer += chunk;
+      const lines = this.buffer.split("\n");
+      this.buffer = lines.pop();
+      for (const line of lines) this._push(line);
+    });
+  }
+
+  _push(line) {
+    const index = this.waiters.findIndex((waiter) => waiter.predicate(line));
+    if (index === -1) {
+      this.lines.push(line);
+      return;
+    }
+    const [waiter] = this.waiters.splice(index, 1);
+    clearTimeout(waiter.timeoutId);
+    waiter.resolve(line);
+  }
+
+  clear() {
+    this.lines = [];
+  }
+
+  /** Resolves with the first line matching predicate, or null after timeoutMs */
+  take(predicate, timeoutMs) {
+    const index = this.lines.findIndex(predicate);
+    if (index !== -1) return Promise.resolve(this.lines.splice(index, 1)[0]);
+
+    return new Promise((resolve) => {
+      const waiter = { predicate, resolve, timeoutId: null };
+      waiter.timeoutId = setTimeout(() => {
+        this.waiters.splice(this.waiters.indexOf(waiter), 1);
+        resolve(null);
+      }, timeoutMs);
+      this.waiters.push(waiter);
+    });
+  }
+}
+
+/** Starts a headless Xvfb, adds it to processes and resolves with its display name */
+async function startXvfb(processes) {
+  const args = ["-displayfd", "3", "-screen", "0", "1280x800x24", "-nolisten", "tcp"];
+  const xvfb = spawn("Xvfb", args, { stdio: ["ignore", "ignore", "pipe", "pipe"] });
+  processes.push(xvfb);
+  xvfb.on("error", () => {});
+
+  const displayfd = new LineReader(xvfb.stdio[3]);
+  const line = await displayfd.take(() => true, XVFB_READY_TIMEOUT_MS);
+  if (line === null) throw new Error("Xvfb did not start (is it installed?)");
+  return `:${line.trim()}`;
+}
+
+function percentiles(values) {
+  if (values.length === 0) return null;
+  const sorted = [...values].sort((a, b) => a - b);
+  const rank = (p) => sorted[Math.min(sorted.length - 1, Math.ceil(p * sorted.length) - 1)];
+  return { p50: rank(0.5), p95: rank(0.95), p99: rank(0.99), max: sorted[sorted.length - 1] };
+}
+
+module.exports = {
+  LineReader,
+  nowUs,
+  parseJsonLine,
+  percentiles,
+  sleep,
+  startXvfb,
+};
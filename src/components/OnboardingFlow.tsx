@@ -146,7 +146,7 @@ export default function OnboardingFlow({ onComplete }: OnboardingFlowProps) {
     const checkHotkeyMode = async () => {
       try {
         const info = await window.electronAPI?.getHotkeyModeInfo();
-        if (info?.isUsingGnome) {
+        if (info?.isUsingGnome && !info.hasNativePushToTalk) {
           setIsUsingGnomeHotkeys(true);
           setActivationMode("tap");
         }
@@ -875,7 +875,7 @@ export default function SettingsPage({ activeSection = "general" }: SettingsPage
     const checkHotkeyMode = async () => {
       try {
         const info = await window.electronAPI?.getHotkeyModeInfo();
-        if (info?.isUsingGnome) {
+        if (info?.isUsingGnome && !info.hasNativePushToTalk) {
           setIsUsingGnomeHotkeys(true);
           setActivationMode("tap");
         }
@@ -4,6 +4,7 @@ const { killProcess } = require("../utils/process");
 const path = require("path");
 const fs = require("fs");
 const debugLogger = require("./debugLogger");
+const LinuxFastPasteServer = require("./linuxFastPasteServer");
 
 const CACHE_TTL_MS = 30000;
 
@@ -51,6 +52,10 @@ const PASTE_DELAYS = {
   linux: 50,
 };
 
+// Transcripts up to this length are typed by linux-fast-paste --type instead
+// of pasted, skipping the clipboard write, keystroke and delayed restore
+const LINUX_TYPE_MAX_CHARS = 64;
+
 const RESTORE_DELAYS = {
   darwin: 450,
   win32_nircmd: 80,
@@ -78,6 +83,16 @@ class ClipboardManager {
     this.winFastPasteChecked = false;
     this.linuxFastPastePath = null;
     this.linuxFastPasteChecked = false;
+    this.linuxFastPasteServer = null;
+    // Set once the compositor turns out not to offer zwp_virtual_keyboard_manager_v1
+    this.waylandVirtualKeyboardUnsupported = false;
+    // Set once the compositor turns out not to offer wlr-data-control
+    this.waylandDataControlUnsupported = false;
+    // Result of `linux-fast-paste --probe`, replacing per-paste spawnSync checks
+    this.linuxProbe = null;
+    this.linuxProbePromise = null;
+    // _NET_WM_PID of the window the last paste went to, for the text monitor
+    this.lastLinuxTargetPid = null;
   }
 
   _isWayland() {
@@ -86,7 +101,50 @@ class ClipboardManager {
     return isWayland;
   }
 
-  _writeClipboardWayland(text, webContents) {
+  // Resident linux-fast-paste for wlr-data-control, or null where it cannot help
+  _getWaylandClipboardServer() {
+    if (this.waylandDataControlUnsupported) return null;
+    const server = this._getLinuxFastPasteServer();
+    return server && (server.isRunning() || server.start()) ? server : null;
+  }
+
+  // Exit codes 7/9: no Wayland support built in, or the compositor lacks data-control
+  _noteWaylandDataControlFailure(error) {
+    if (error?.code === 7 || error?.code === 9) {
+      this.waylandDataControlUnsupported = true;
+    }
+    debugLogger.debug(
+      "Native Wayland clipboard unavailable",
+      { error: error?.message, unsupported: this.waylandDataControlUnsupported },
+      "clipboard"
+    );
+  }
+
+  async _readClipboardWayland() {
+    const server = this._getWaylandClipboardServer();
+    if (server) {
+      try {
+        return await server.readClipboard();
+      } catch (error) {
+        this._noteWaylandDataControlFailure(error);
+      }
+    }
+    return clipboard.readText();
+  }
+
+  async _writeClipboardWayland(text, webContents) {
+    // The resident helper owns and serves the selection itself, so there is
+    // no wl-copy spawn blocking the main process
+    const server = this._getWaylandClipboardServer();
+    if (server) {
+      try {
+        await server.copy(text);
+        return;
+      } catch (error) {
+        this._noteWaylandDataControlFailure(error);
+      }
+    }
+
     if (this.commandExists("wl-copy")) {
       try {
         const result = spawnSync("wl-copy", ["--", text], { timeout: 2000 });
@@ -219,7 +277,137 @@ class ClipboardManager {
     );
   }
 
+  _getLinuxFastPasteServer() {
+    const binary = this.resolveLinuxFastPasteBinary();
+    if (!binary) return null;
+    if (!this.linuxFastPasteServer || this.linuxFastPasteServer.binaryPath !== binary) {
+      this.linuxFastPasteServer?.stop();
+      this.linuxFastPasteServer = new LinuxFastPasteServer(binary);
+    }
+    return this.linuxFastPasteServer;
+  }
+
+  stopLinuxFastPasteServer() {
+    if (this.linuxFastPasteServer) {
+      this.linuxFastPasteServer.stop();
+      this.linuxFastPasteServer = null;
+    }
+  }
+
+  /**
+   * Active X11 window via `linux-fast-paste --query-active` (QUERY on the
+   * resident server). Resolves with the window, null when there is none,
+   * or undefined when the native query itself is unavailable.
+   */
+  async _queryLinuxActiveWindow() {
+    const binary = this.resolveLinuxFastPasteBinary();
+    if (!binary) return undefined;
+
+    try {
+      const server = this._getLinuxFastPasteServer();
+      if (server && (server.isRunning() || server.start())) {
+        return this._rememberLinuxTarget(await server.queryActive());
+      }
+      const result = await new Promise((resolve, reject) => {
+        const proc = spawn(binary, ["--query-active"]);
+        let stdout = "";
+        proc.stdout.on("data", (data) => {
+          stdout += data.toString();
+        });
+        proc.on("error", reject);
+        proc.on("close", (code) => {
+          if (code !== 0) return reject(new Error(`--query-active exited with ${code}`));
+          resolve(stdout);
+        });
+      });
+      return this._rememberLinuxTarget(JSON.parse(result));
+    } catch (error) {
+      debugLogger.debug(
+        "Native active-window query failed",
+        { error: error?.message },
+        "clipboard"
+      );
+      return undefined;
+    }
+  }
+
+  _rememberLinuxTarget(activeWindow) {
+    this.lastLinuxTargetPid = activeWindow?.pid > 0 ? activeWindow.pid : null;
+    return activeWindow;
+  }
+
+  // Must match the cache.env key linux-fast-paste --probe reports
+  _linuxProbeEnvKey() {
+    const env = process.env;
+    return [env.DISPLAY, env.WAYLAND_DISPLAY, env.XDG_SESSION_TYPE, env.XDG_CURRENT_DESKTOP]
+      .map((value) => value || "")
+      .join("|");
+  }
+
+  async refreshLinuxProbe() {
+    if (this.linuxProbePromise) return this.linuxProbePromise;
+
+    const binary = this.resolveLinuxFastPasteBinary();
+    if (!binary) return null;
+
+    const runProbe = async () => {
+      const server = this._getLinuxFastPasteServer();
+      if (server && (server.isRunning() || server.start())) {
+        return server.probe();
+      }
+      return new Promise((resolve, reject) => {
+        const proc = spawn(binary, ["--probe"]);
+        let stdout = "";
+        proc.stdout.on("data", (data) => {
+          stdout += data.toString();
+        });
+        proc.on("error", reject);
+        proc.on("close", (code) => {
+          if (code !== 0) return reject(new Error(`linux-fast-paste --probe exited with ${code}`));
+          try {
+            resolve(JSON.parse(stdout));
+          } catch (error) {
+            reject(error);
+          }
+        });
+      });
+    };
+
+    this.linuxProbePromise = runProbe()
+      .then((data) => {
+        this.linuxProbe = {
+          data,
+          envKey: data.cache?.env,
+          expiresAt: Date.now() + (data.cache?.ttl_ms ?? CACHE_TTL_MS),
+        };
+        debugLogger.debug("Linux capability probe", data, "clipboard");
+        return data;
+      })
+      .catch((error) => {
+        debugLogger.debug("Linux capability probe failed", { error: error?.message }, "clipboard");
+        return null;
+      })
+      .finally(() => {
+        this.linuxProbePromise = null;
+      });
+    return this.linuxProbePromise;
+  }
+
+  // Cached probe result, or null (and a background refresh) when stale or the session changed
+  _getLinuxProbe() {
+    if (process.platform !== "linux") return null;
+    const probe = this.linuxProbe;
+    if (probe && Date.now() < probe.expiresAt && probe.envKey === this._linuxProbeEnvKey()) {
+      return probe.data;
+    }
+    this.refreshLinuxProbe();
+    return null;
+  }
+
   _isYdotoolDaemonRunning() {
+    const probe = this._getLinuxProbe();
+    if (probe?.ydotool) return probe.ydotool.alive === true;
+
     const uid = process.getuid?.();
     const socketPaths = [
       process.env.YDOTOOL_SOCKET,
@@ -246,6 +434,9 @@ class ClipboardManager {
     if (this._uinputCache && now < this._uinputCache.expiresAt) {
       return this._uinputCache.accessible;
     }
+    const probe = this._getLinuxProbe();
+    if (probe?.uinput) return probe.uinput.writable === true;
+
     let accessible = false;
     try {
       fs.accessSync("/dev/uinput", fs.constants.W_OK);
@@ -310,6 +501,11 @@ class ClipboardManager {
   }
 
   commandExists(cmd) {
+    const probedTools = this._getLinuxProbe()?.tools;
+    if (probedTools && typeof probedTools[cmd] === "boolean") {
+      return probedTools[cmd];
+    }
+
     const now = Date.now();
     const cached = this.commandAvailabilityCache.get(cmd);
     if (cached && now < cached.expiresAt) {
@@ -339,20 +535,41 @@ class ClipboardManager {
     const platform = process.platform;
     let method = "unknown";
     const webContents = options.webContents;
+    this.lastLinuxTargetPid = null;
 
     try {
-      const originalClipboard = clipboard.readText();
+      if (platform === "linux" && (await this._typeTextLinux(text))) {
+        this.safeLog("✅ Paste operation complete", {
+          platform,
+          method: "linux-type",
+          elapsedMs: Date.now() - startTime,
+          textLength: text.length,
+        });
+        return;
+      }
+
+      const originalClipboard =
+        platform === "linux" && this._isWayland()
+          ? await this._readClipboardWayland()
+          : clipboard.readText();
       this.safeLog(
         "💾 Saved original clipboard content:",
         originalClipboard.substring(0, 50) + "..."
       );
 
+      // On X11 the native helper can own CLIPBOARD itself and serve the text
+      // directly, so the clipboard is only written here if it cannot.
+      const deferLinuxClipboard =
+        platform === "linux" && !this._isWayland() && !!this.resolveLinuxFastPasteBinary();
+
       if (platform === "linux" && this._isWayland()) {
-        this._writeClipboardWayland(text, webContents);
-      } else {
+        await this._writeClipboardWayland(text, webContents);
+      } else if (!deferLinuxClipboard) {
         clipboard.writeText(text);
       }
-      this.safeLog("📋 Text copied to clipboard:", text.substring(0, 50) + "...");
+      if (!deferLinuxClipboard) {
+        this.safeLog("📋 Text copied to clipboard:", text.substring(0, 50) + "...");
+      }
 
       if (platform === "darwin") {
         method = this.resolveFastPasteBinary() ? "cgevent" : "applescript";
@@ -386,7 +603,10 @@ class ClipboardManager {
         await this.pasteWindows(originalClipboard);
       } else {
         method = this.resolveLinuxFastPasteBinary() ? "linux-xtest" : "linux-tools";
-        await this.pasteLinux(originalClipboard, options);
+        await this.pasteLinux(originalClipboard, {
+          ...options,
+          pendingClipboardText: deferLinuxClipboard ? text : null,
+        });
       }
 
       this.safeLog("✅ Paste operation complete", {
@@ -406,6 +626,83 @@ class ClipboardManager {
     }
   }
 
+  /**
+   * Types short text with linux-fast-paste --type so the clipboard is never
+   * touched. Resolves true once typed, false when the text is too long, holds
+   * control characters (a typed newline would submit in a terminal), or no
+   * typing backend worked, in which case the caller pastes as usual.
+   */
+  async _typeTextLinux(text) {
+    const binary = this.resolveLinuxFastPasteBinary();
+    if (!binary || !text || text.length > LINUX_TYPE_MAX_CHARS) return false;
+    // eslint-disable-next-line no-control-regex
+    if (/[\u0000-\u001f\u007f]/.test(text)) return false;
+
+    const isWayland = this._isWayland();
+    const attempts = [];
+    if (isWayland) {
+      if (!this.waylandVirtualKeyboardUnsupported) attempts.push(["--wayland"]);
+      if (this._canAccessUinput()) attempts.push(["--uinput"]);
+    } else {
+      const activeWindow = await this._queryLinuxActiveWindow();
+      attempts.push(activeWindow ? ["--window", String(activeWindow.id)] : []);
+    }
+
+    const server = this._getLinuxFastPasteServer();
+    for (const args of attempts) {
+      if (debugLogger.isEnabled()) args.push("--trace");
+      try {
+        if (server && (server.isRunning() || server.start())) {
+          await server.type(args, text);
+        } else {
+          await this._execLinuxFastPasteType(binary, args, text);
+        }
+        debugLogger.info(
+          "Text typed without the clipboard",
+          { tool: "linux-fast-paste", args, textLength: text.length },
+          "clipboard"
+        );
+        return true;
+      } catch (error) {
+        if (args[0] === "--wayland") this._noteWaylandVirtualKeyboardFailure(error);
+        debugLogger.debug(
+          "linux-fast-paste --type failed, trying next",
+          { args, error: error?.message },
+          "clipboard"
+        );
+      }
+    }
+    return false;
+  }
+
+  _execLinuxFastPasteType(binary, args, text) {
+    return new Promise((resolve, reject) => {
+      // process.hrtime is CLOCK_MONOTONIC, the clock --trace reports t0_us on
+      const spawnedAtUs = Number(process.hrtime.bigint() / 1000n);
+      const proc = spawn(binary, [...args, "--type"]);
+      let stderr = "";
+      proc.stderr?.on("data", (data) => {
+        stderr += data.toString();
+      });
+      proc.stdin.on("error", () => {});
+      proc.stdin.end(text);
+
+      const timeoutId = setTimeout(() => killProcess(proc, "SIGKILL"), 2000);
+      proc.on("close", (code) => {
+        clearTimeout(timeoutId);
+        stderr = LinuxFastPasteServer.forwardTraceLines(stderr, "oneshot", spawnedAtUs);
+        if (code === 0) return resolve();
+        reject(
+          new Error(`linux-fast-paste exited with code ${code}${stderr ? `: ${stderr}` : ""}`)
+        );
+      });
+      proc.on("error", (error) => {
+        clearTimeout(timeoutId);
+        reject(error);
+      });
+    });
+  }
+
   async pasteMacOS(originalClipboard, options = {}) {
     const fastPasteBinary = this.resolveFastPasteBinary();
     const useFastPaste = !!fastPasteBinary;
@@ -806,6 +1103,15 @@ class ClipboardManager {
       "clipboard"
     );
 
+    const pendingClipboardText = options.pendingClipboardText ?? null;
+    let clipboardWritten = pendingClipboardText === null;
+    // Paths other than the native CLIPBOARD owner need the text on the clipboard
+    const ensureClipboardText = () => {
+      if (clipboardWritten) return;
+      clipboardWritten = true;
+      clipboard.writeText(pendingClipboardText);
+    };
+
     const restoreClipboard = () => {
       setTimeout(() => {
         if (isWayland) {
@@ -867,8 +1173,24 @@ class ClipboardManager {
       }
     };
 
-    const targetWindowId = preDetectTargetWindow();
-    let detectedWindowClass = preDetectWindowClass(targetWindowId);
+    // One native query (zero spawns with the resident server) replaces the
+    // xdotool getactivewindow + getwindowclassname pair
+    const activeWindow =
+      linuxFastPaste && (!isWayland || xwaylandAvailable)
+        ? await this._queryLinuxActiveWindow()
+        : undefined;
+    const nativeTerminal = activeWindow?.terminal === true;
+
+    let targetWindowId;
+    let detectedWindowClass;
+    if (activeWindow !== undefined) {
+      targetWindowId = activeWindow ? String(activeWindow.id) : null;
+      detectedWindowClass = activeWindow?.class ? activeWindow.class.toLowerCase() : null;
+      debugLogger.debug("Active window from linux-fast-paste", { activeWindow }, "clipboard");
+    } else {
+      targetWindowId = preDetectTargetWindow();
+      detectedWindowClass = preDetectWindowClass(targetWindowId);
+    }
 
     if (!detectedWindowClass && isKde) {
       detectedWindowClass = this._detectKdeWindowClass();
@@ -878,20 +1200,39 @@ class ClipboardManager {
     }
 
     if (linuxFastPaste) {
-      const earlyIsTerminal = detectedWindowClass
-        ? terminalClasses.some((t) => detectedWindowClass.includes(t))
-        : false;
+      const earlyIsTerminal =
+        nativeTerminal ||
+        (detectedWindowClass
+          ? terminalClasses.some((t) => detectedWindowClass.includes(t))
+          : false);
+
+      const pasteServer = this._getLinuxFastPasteServer();
 
-      const spawnFastPaste = (args, label) =>
+      const execFastPaste = (args, label, clipboardText = null) =>
         new Promise((resolve, reject) => {
           debugLogger.debug(
             `Attempting native linux-fast-paste (${label})`,
             { linuxFastPaste, args, targetWindowId, detectedWindowClass, earlyIsTerminal },
             "clipboard"
           );
-          const proc = spawn(linuxFastPaste, args);
+          // process.hrtime is CLOCK_MONOTONIC, the clock --trace reports t0_us on
+          const spawnedAtUs = Number(process.hrtime.bigint() / 1000n);
+          const proc = spawn(
+            linuxFastPaste,
+            clipboardText !== null ? [...args, "--clipboard-stdin"] : args
+          );
+          let stdout = "";
           let stderr = "";
 
+          proc.stdout?.on("data", (data) => {
+            stdout += data.toString();
+          });
+
+          if (clipboardText !== null) {
+            proc.stdin.on("error", () => {});
+            proc.stdin.end(clipboardText);
+          }
+
           proc.stderr?.on("data", (data) => {
             stderr += data.toString();
           });
@@ -905,8 +1246,9 @@ class ClipboardManager {
           proc.on("close", (code) => {
             if (timedOut) return reject(new Error("linux-fast-paste timed out"));
             clearTimeout(timeoutId);
+            stderr = LinuxFastPasteServer.forwardTraceLines(stderr, "oneshot", spawnedAtUs);
             if (code === 0) {
-              resolve();
+              resolve(LinuxFastPasteServer.parseClipboardResult(stdout));
             } else {
               reject(
                 new Error(
@@ -923,9 +1265,43 @@ class ClipboardManager {
           });
         });
 
+      // Prefer the resident server; fall back to a one-shot exec if it cannot start
+      const spawnFastPaste = async (args, label, clipboardText = null) => {
+        if (pasteServer && (pasteServer.isRunning() || pasteServer.start())) {
+          debugLogger.debug(
+            `Attempting native linux-fast-paste server (${label})`,
+            { args, targetWindowId, detectedWindowClass, earlyIsTerminal },
+            "clipboard"
+          );
+          return pasteServer.paste(args, clipboardText);
+        }
+        return execFastPaste(args, label, clipboardText);
+      };
+
+      if (isWayland && !this.waylandVirtualKeyboardUnsupported) {
+        const waylandArgs = ["--wayland"];
+        if (earlyIsTerminal) waylandArgs.push("--terminal");
+        if (debugLogger.isEnabled()) waylandArgs.push("--trace");
+
+        try {
+          await spawnFastPaste(waylandArgs, "Wayland virtual keyboard");
+          this.safeLog("✅ Paste successful using native linux-fast-paste (virtual keyboard)");
+          debugLogger.info(
+            "Paste successful",
+            { tool: "linux-fast-paste", method: "wayland-virtual-keyboard" },
+            "clipboard"
+          );
+          restoreClipboard();
+          return;
+        } catch (error) {
+          this._noteWaylandVirtualKeyboardFailure(error);
+        }
+      }
+
       if (isWayland) {
         const uinputArgs = ["--uinput"];
         if (earlyIsTerminal) uinputArgs.push("--terminal");
+        if (debugLogger.isEnabled()) uinputArgs.push("--trace");
 
         try {
           await spawnFastPaste(uinputArgs, "uinput");
@@ -944,6 +1320,7 @@ class ClipboardManager {
             const xtestArgs = [];
             if (targetWindowId) xtestArgs.push("--window", targetWindowId);
             if (earlyIsTerminal) xtestArgs.push("--terminal");
+            if (debugLogger.isEnabled()) xtestArgs.push("--trace");
 
             try {
               await spawnFastPaste(xtestArgs, "XTest/XWayland fallback");
@@ -972,6 +1349,44 @@ class ClipboardManager {
         const xtestArgs = [];
         if (targetWindowId) xtestArgs.push("--window", targetWindowId);
         if (earlyIsTerminal) xtestArgs.push("--terminal");
+        if (debugLogger.isEnabled()) xtestArgs.push("--trace");
+
+        if (pendingClipboardText !== null) {
+          try {
+            const result = await spawnFastPaste(
+              xtestArgs,
+              "XTest + CLIPBOARD owner",
+              pendingClipboardText
+            );
+            this.safeLog("✅ Paste successful using native linux-fast-paste (CLIPBOARD owner)");
+            debugLogger.info(
+              "Paste successful",
+              {
+                tool: "linux-fast-paste",
+                method: "xtest-selection-owner",
+                consumedMs: result?.consumedMs ?? null,
+              },
+              "clipboard"
+            );
+            if (result?.consumed) {
+              // The target already has the text, so nothing can race the restore
+              clipboard.writeText(originalClipboard);
+            } else {
+              // Nothing fetched it in time; leave the text on the clipboard for a
+              // slow app and restore on the usual delay
+              ensureClipboardText();
+              restoreClipboard();
+            }
+            return;
+          } catch (error) {
+            debugLogger.warn(
+              "Native CLIPBOARD owner paste failed, writing clipboard and retrying",
+              { error: error?.message },
+              "clipboard"
+            );
+            ensureClipboardText();
+          }
+        }
 
         try {
           await spawnFastPaste(xtestArgs, "XTest");
@@ -996,10 +1411,13 @@ class ClipboardManager {
       }
     }
 
+    ensureClipboardText();
+
     // Terminals use Ctrl+Shift+V instead of Ctrl+V
     const isTerminal = () => {
-      if (!detectedWindowClass) return false;
-      const isTerminalWindow = terminalClasses.some((term) => detectedWindowClass.includes(term));
+      if (!detectedWindowClass) return nativeTerminal;
+      const isTerminalWindow =
+        nativeTerminal || terminalClasses.some((term) => detectedWindowClass.includes(term));
       if (isTerminalWindow) {
         this.safeLog(`🖥️ Terminal detected: ${detectedWindowClass}`);
       }
@@ -1383,9 +1801,44 @@ Would you like to open System Settings now?`;
     tryNextCommand();
   }
 
+  // Exit codes 7/8: no Wayland support built in, or the compositor lacks the protocol
+  _noteWaylandVirtualKeyboardFailure(error) {
+    const code = error?.code ?? Number(error?.message?.match(/exited with code (\d+)/)?.[1]);
+    if (code === 7 || code === 8) {
+      this.waylandVirtualKeyboardUnsupported = true;
+    }
+    debugLogger.debug(
+      "Wayland virtual keyboard unavailable",
+      { error: error?.message, unsupported: this.waylandVirtualKeyboardUnsupported },
+      "clipboard"
+    );
+  }
+
   preWarmAccessibility() {
     if (process.platform === "linux") {
-      this.resolveLinuxFastPasteBinary();
+      this.refreshLinuxProbe();
+      const pasteServer = this._getLinuxFastPasteServer();
+      if (!pasteServer?.start() || !this._isWayland()) return;
+
+      const prepareUinput = () => {
+        if (!this._canAccessUinput()) return;
+        pasteServer.prepare(["--uinput"]).catch((error) => {
+          debugLogger.debug(
+            "uinput pre-registration failed",
+            { error: error?.message },
+            "clipboard"
+          );
+        });
+      };
+
+      if (this.waylandVirtualKeyboardUnsupported) {
+        prepareUinput();
+        return;
+      }
+      pasteServer.prepare(["--wayland"]).catch((error) => {
+        this._noteWaylandVirtualKeyboardFailure(error);
+        prepareUinput();
+      });
       return;
     }
     if (process.platform !== "darwin") return;
@@ -1394,12 +1847,15 @@ Would you like to open System Settings now?`;
   }
 
   async readClipboard() {
+    if (process.platform === "linux" && this._isWayland()) {
+      return this._readClipboardWayland();
+    }
     return clipboard.readText();
   }
 
   async writeClipboard(text, webContents = null) {
     if (process.platform === "linux" && this._isWayland()) {
-      this._writeClipboardWayland(text, webContents);
+      await this._writeClipboardWayland(text, webContents);
     } else {
       clipboard.writeText(text);
     }
@@ -0,0 +1,80 @@
+/**
+ * HelperOutputDecoder - Incremental parser for native helper stdout
+ *
+ * Helpers print one message per line by default. Started with
+ * --framing=binary, a helper that supports it first prints FRAMING_HEADER and
+ * then writes every message as a header line ending in a byte count, followed
+ * by that many raw bytes:
+ *
+ *   <head> <length>\n<length bytes>
+ *
+ * Binaries without framing support ignore the flag and keep printing lines, so
+ * the decoder starts in line mode and only switches on seeing the header.
+ * Chunks may split lines and payloads anywhere; nothing is emitted until it is
+ * complete.
+ */
+
+const FRAMING_HEADER = "FRAMING binary 1";
+const FRAME_HEADER_RE = /^(.+) (\d+)$/;
+
+class HelperOutputDecoder {
+  /**
+   * @param {object} handlers
+   * @param {(line: string) => void} handlers.onLine - A line in line mode
+   * @param {(head: string, payload: Buffer) => void} handlers.onFrame - A binary frame
+   */
+  constructor({ onLine, onFrame }) {
+    this.onLine = onLine;
+    this.onFrame = onFrame;
+    this.binary = false;
+    this._buffer = Buffer.alloc(0);
+    // Header of a frame whose payload has not fully arrived yet
+    this._pending = null;
+  }
+
+  push(chunk) {
+    const buffer = this._buffer.length ? Buffer.concat([this._buffer, chunk]) : chunk;
+    let offset = 0;
+
+    for (;;) {
+      if (this._pending) {
+        const { head, length } = this._pending;
+        if (buffer.length - offset < length) break;
+        const payload = buffer.subarray(offset, offset + length);
+        offset += length;
+        this._pending = null;
+        this.onFrame(head, payload);
+        continue;
+      }
+
+      const newline = buffer.indexOf(0x0a, offset);
+      if (newline === -1) break;
+      const line = buffer.toString("utf8", offset, newline).replace(/\r$/, "");
+      offset = newline + 1;
+      if (!line) continue;
+
+      if (!this.binary) {
+        if (line === FRAMING_HEADER) {
+          this.binary = true;
+        } else {
+          this.onLine(line);
+        }
+        continue;
+      }
+
+      const match = FRAME_HEADER_RE.exec(line);
+      if (match) {
+        this._pending = { head: match[1], length: Number(match[2]) };
+      } else {
+        // Not a frame header; nothing better to do than treat it as a line
+        this.onLine(line);
+      }
+    }
+
+    // Copy the remainder so a small tail does not pin a large chunk
+    this._buffer = offset < buffer.length ? Buffer.from(buffer.subarray(offset)) : Buffer.alloc(0);
+  }
+}
+
+module.exports = HelperOutputDecoder;
+module.exports.FRAMING_HEADER = FRAMING_HEADER;
@@ -1,6 +1,7 @@
 const { globalShortcut } = require("electron");
 const debugLogger = require("./debugLogger");
 const GnomeShortcutManager = require("./gnomeShortcut");
+const { detectLinuxKeyBackend } = require("./linuxKeyManager");
 const { i18nMain } = require("./i18nMain");
 
 // Delay to ensure localStorage is accessible after window load
@@ -191,6 +192,13 @@ class HotkeyManager {
         return { success: true, hotkey };
       }
 
+      // ...and the Linux key listener (XInput2 on X11, evdev on Wayland)
+      if (isModifierOnlyHotkey(hotkey) && detectLinuxKeyBackend() !== null) {
+        this.currentHotkey = hotkey;
+        debugLogger.log(`[HotkeyManager] Modifier-only "${hotkey}" set - using Linux key listener`);
+        return { success: true, hotkey };
+      }
+
       const accelerator = normalizeToAccelerator(hotkey);
 
       const alreadyRegistered = globalShortcut.isRegistered(accelerator);
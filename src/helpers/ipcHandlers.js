@@ -9,6 +9,7 @@ const GnomeShortcutManager = require("./gnomeShortcut");
 const AssemblyAiStreaming = require("./assemblyAiStreaming");
 const { i18nMain, changeLanguage } = require("./i18nMain");
 const DeepgramStreaming = require("./deepgramStreaming");
+const LinuxLiveTyping = require("./linuxLiveTyping");
 
 const MISTRAL_TRANSCRIPTION_URL = "https://api.mistral.ai/v1/audio/transcriptions";
 
@@ -96,12 +97,14 @@ class IPCHandlers {
     this.windowManager = managers.windowManager;
     this.updateManager = managers.updateManager;
     this.windowsKeyManager = managers.windowsKeyManager;
+    this.linuxKeyManager = managers.linuxKeyManager;
     this.textEditMonitor = managers.textEditMonitor;
     this.getTrayManager = managers.getTrayManager;
     this.whisperCudaManager = managers.whisperCudaManager;
     this.sessionId = crypto.randomUUID();
     this.assemblyAiStreaming = null;
     this.deepgramStreaming = null;
+    this.linuxLiveTyping = new LinuxLiveTyping(this.clipboardManager);
     this._autoLearnEnabled = true; // Default on, synced from renderer
     this._autoLearnDebounceTimer = null;
     this._autoLearnLatestData = null;
@@ -116,6 +119,11 @@ class IPCHandlers {
     }
   }
 
+  _isMainWindowFocused() {
+    const mainWindow = this.windowManager?.mainWindow;
+    return !!mainWindow && !mainWindow.isDestroyed() && mainWindow.isFocused();
+  }
+
   _getDictionarySafe() {
     try {
       return this.databaseManager.getDictionary();
@@ -609,11 +617,17 @@ class IPCHandlers {
           await new Promise((resolve) => setTimeout(resolve, 80));
         }
       }
-      const result = await this.clipboardManager.pasteText(text, {
-        ...options,
-        webContents: event.sender,
-      });
-      const targetPid = this.textEditMonitor?.lastTargetPid || null;
+      // Live typing has already put the streamed transcript into the target app.
+      // Any open session is reconciled, also when the renderer fell back to batch
+      const typedLive = await this.linuxLiveTyping.finish(text);
+      const result = typedLive
+        ? undefined
+        : await this.clipboardManager.pasteText(text, {
+            ...options,
+            webContents: event.sender,
+          });
+      const targetPid =
+        this.textEditMonitor?.lastTargetPid || this.clipboardManager.lastLinuxTargetPid || null;
       debugLogger.debug("[AutoLearn] Paste completed", {
         autoLearnEnabled: this._autoLearnEnabled,
         hasMonitor: !!this.textEditMonitor,
@@ -1014,6 +1028,12 @@ class IPCHandlers {
           this.windowsKeyManager.stop();
         }
 
+        // On X11, stop the Linux key listener
+        if (process.platform === "linux" && this.linuxKeyManager?.isSupported) {
+          debugLogger.log("[IPC] Stopping Linux key listener for hotkey capture mode");
+          this.linuxKeyManager.stop();
+        }
+
         // On GNOME Wayland, unregister the keybinding during capture
         if (hotkeyManager.isUsingGnome() && hotkeyManager.gnomeManager) {
           debugLogger.log("[IPC] Unregistering GNOME keybinding for hotkey capture mode");
@@ -1057,6 +1077,20 @@ class IPCHandlers {
           }
         }
 
+        if (process.platform === "linux" && this.linuxKeyManager?.isSupported) {
+          const activationMode = this.windowManager.getActivationMode();
+          const needsListener =
+            effectiveHotkey &&
+            effectiveHotkey !== "GLOBE" &&
+            (activationMode === "push" ||
+              isModifierOnlyHotkey(effectiveHotkey) ||
+              isRightSideModifier(effectiveHotkey));
+          if (needsListener) {
+            debugLogger.log(`[IPC] Restarting Linux key listener for hotkey: ${effectiveHotkey}`);
+            this.linuxKeyManager.start(effectiveHotkey);
+          }
+        }
+
         // On GNOME Wayland, re-register the keybinding with the effective hotkey
         if (hotkeyManager.isUsingGnome() && hotkeyManager.gnomeManager && effectiveHotkey) {
           const gnomeHotkey = GnomeShortcutManager.convertToGnomeFormat(effectiveHotkey);
@@ -1076,6 +1110,8 @@ class IPCHandlers {
     ipcMain.handle("get-hotkey-mode-info", async () => {
       return {
         isUsingGnome: this.windowManager.isUsingGnomeHotkeys(),
+        // GNOME shortcuts only toggle; the evdev key listener can still do push-to-talk
+        hasNativePushToTalk: Boolean(this.linuxKeyManager?.isAvailable()),
       };
     });
 
@@ -2545,18 +2581,21 @@ class IPCHandlers {
 
         // Set up callbacks to forward events to renderer
         this.assemblyAiStreaming.onPartialTranscript = (text) => {
+          this.linuxLiveTyping.onPartial(text);
           if (win && !win.isDestroyed()) {
             win.webContents.send("assemblyai-partial-transcript", text);
           }
         };
 
         this.assemblyAiStreaming.onFinalTranscript = (text) => {
+          this.linuxLiveTyping.onFinal(text);
           if (win && !win.isDestroyed()) {
             win.webContents.send("assemblyai-final-transcript", text);
           }
         };
 
         this.assemblyAiStreaming.onError = (error) => {
+          this.linuxLiveTyping.abort();
           if (win && !win.isDestroyed()) {
             win.webContents.send("assemblyai-error", error.message);
           }
@@ -2570,6 +2609,7 @@ class IPCHandlers {
 
         await this.assemblyAiStreaming.connect({ ...options, token });
         debugLogger.debug("AssemblyAI streaming started", {}, "streaming");
+        await this.linuxLiveTyping.begin({ panelFocused: this._isMainWindowFocused() });
 
         return {
           success: true,
@@ -2609,9 +2649,13 @@ class IPCHandlers {
           this.assemblyAiStreaming = null;
         }
 
+        // Without a final transcript there is nothing to reconcile the typed partials with
+        if (result?.text) this.linuxLiveTyping.end();
+        else await this.linuxLiveTyping.abort();
         return { success: true, text: result?.text || "" };
       } catch (error) {
         debugLogger.error("AssemblyAI streaming stop error", { error: error.message });
+        await this.linuxLiveTyping.abort();
         return { success: false, error: error.message };
       }
     });
@@ -2788,18 +2832,21 @@ class IPCHandlers {
         }
 
         this.deepgramStreaming.onPartialTranscript = (text) => {
+          this.linuxLiveTyping.onPartial(text);
           if (win && !win.isDestroyed()) {
             win.webContents.send("deepgram-partial-transcript", text);
           }
         };
 
         this.deepgramStreaming.onFinalTranscript = (text) => {
+          this.linuxLiveTyping.onFinal(text);
           if (win && !win.isDestroyed()) {
             win.webContents.send("deepgram-final-transcript", text);
           }
         };
 
         this.deepgramStreaming.onError = (error) => {
+          this.linuxLiveTyping.abort();
           if (win && !win.isDestroyed()) {
             win.webContents.send("deepgram-error", error.message);
           }
@@ -2813,6 +2860,7 @@ class IPCHandlers {
 
         await this.deepgramStreaming.connect({ ...options, token });
         debugLogger.debug("Deepgram streaming started", {}, "streaming");
+        await this.linuxLiveTyping.begin({ panelFocused: this._isMainWindowFocused() });
 
         return {
           success: true,
@@ -2852,9 +2900,13 @@ class IPCHandlers {
           result = await this.deepgramStreaming.disconnect(true);
         }
 
+        // Without a final transcript there is nothing to reconcile the typed partials with
+        if (result?.text) this.linuxLiveTyping.end();
+        else await this.linuxLiveTyping.abort();
         return { success: true, text: result?.text || "", model, audioBytesSent };
       } catch (error) {
         debugLogger.error("Deepgram streaming stop error", { error: error.message });
+        await this.linuxLiveTyping.abort();
         return { success: false, error: error.message };
       }
     });
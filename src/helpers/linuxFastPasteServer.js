@@ -0,0 +1,360 @@
+/**
+ * LinuxFastPasteServer - Keeps linux-fast-paste resident in --serve mode
+ *
+ * Spawning the helper per paste pays process startup, XOpenDisplay, the XTest
+ * query and keycode lookups every time. The resident server does that once
+ * and then answers one status line per newline-framed command on stdin.
+ */
+
+const { spawn } = require("child_process");
+const { killProcess } = require("../utils/process");
+const debugLogger = require("./debugLogger");
+
+const REQUEST_TIMEOUT_MS = 2000;
+// TYPE and REVISE send a key per character (and REVISE a BackSpace per erased
+// one); settle profiles pace keys at up to 15 ms, uinput at 1 ms
+const TYPE_KEY_TIMEOUT_MS = 20;
+// Covers activation plus the helper's own 1 s wait for the target to fetch CLIPBOARD
+const CLIPBOARD_REQUEST_TIMEOUT_MS = 3000;
+// Time to let the server hand a Wayland clipboard it still owns to a background child
+const STOP_GRACE_MS = 500;
+
+// Base timeout plus a per-key budget that covers an explicit --key-delay
+function typingTimeoutMs(args, keys) {
+  const delayIndex = args.indexOf("--key-delay");
+  const keyDelayMs = delayIndex === -1 ? 0 : Number(args[delayIndex + 1]) || 0;
+  return REQUEST_TIMEOUT_MS + keys * Math.max(TYPE_KEY_TIMEOUT_MS, keyDelayMs + 5);
+}
+
+class LinuxFastPasteServer {
+  constructor(binaryPath) {
+    this.binaryPath = binaryPath;
+    this.process = null;
+    this.pending = [];
+    this._stdoutBuffer = "";
+    this._stderrBuffer = "";
+    // Characters the server's current REVISE stream has typed, for timeouts
+    this._revisedChars = 0;
+  }
+
+  isRunning() {
+    return !!this.process;
+  }
+
+  start() {
+    if (this.process) return true;
+
+    try {
+      this.process = spawn(this.binaryPath, ["--serve"], {
+        stdio: ["pipe", "pipe", "pipe"],
+      });
+    } catch (error) {
+      debugLogger.warn(
+        "[LinuxFastPasteServer] Failed to spawn server",
+        { error: error.message },
+        "clipboard"
+      );
+      this.process = null;
+      return false;
+    }
+
+    const proc = this.process;
+    this._stdoutBuffer = "";
+    this._stderrBuffer = "";
+    this._revisedChars = 0;
+
+    proc.stdout.setEncoding("utf8");
+    proc.stdout.on("data", (chunk) => this._handleStdoutChunk(chunk));
+
+    proc.stderr.setEncoding("utf8");
+    proc.stderr.on("data", (chunk) => this._handleStderrChunk(chunk));
+
+    proc.stdin.on("error", () => {});
+
+    proc.on("error", (error) => {
+      if (this.process !== proc) return;
+      debugLogger.warn(
+        "[LinuxFastPasteServer] Process error",
+        { error: error.message },
+        "clipboard"
+      );
+      this._handleExit(error);
+    });
+
+    proc.on("exit", (code, signal) => {
+      if (this.process !== proc) return;
+      debugLogger.debug("[LinuxFastPasteServer] Process exited", { code, signal }, "clipboard");
+      this._handleExit(
+        new Error(`linux-fast-paste server exited (code ${code}, signal ${signal})`)
+      );
+    });
+
+    debugLogger.debug(
+      "[LinuxFastPasteServer] Started",
+      { binaryPath: this.binaryPath },
+      "clipboard"
+    );
+    return true;
+  }
+
+  stop() {
+    const proc = this.process;
+    if (!proc) return;
+    this._handleExit(new Error("linux-fast-paste server stopped"));
+    try {
+      proc.stdin.end("QUIT\n");
+    } catch {}
+    // QUIT lets the server fork off a child that keeps serving a Wayland
+    // clipboard it still owns; only force it down if it does not exit.
+    const killTimer = setTimeout(() => killProcess(proc, "SIGTERM"), STOP_GRACE_MS);
+    killTimer.unref?.();
+  }
+
+  /**
+   * Send one command line and resolve with the server's reply line.
+   * Rejects if the server dies or does not answer in time. With
+   * awaitLateReply a timeout only rejects: the server is taken to be still
+   * busy (typing), and its reply is dropped in order when it arrives.
+   */
+  request(line, timeoutMs = REQUEST_TIMEOUT_MS, payload = null, awaitLateReply = false) {
+    if (!this.process && !this.start()) {
+      return Promise.reject(new Error("linux-fast-paste server unavailable"));
+    }
+
+    return new Promise((resolve, reject) => {
+      const entry = { resolve, reject, timeoutId: null };
+      entry.timeoutId = setTimeout(() => {
+        reject(new Error("linux-fast-paste server timed out"));
+        if (awaitLateReply) {
+          // Restarting would kill the helper mid-edit and lose what it typed
+          entry.resolve = () => {};
+          entry.reject = () => {};
+          return;
+        }
+        const index = this.pending.indexOf(entry);
+        if (index !== -1) this.pending.splice(index, 1);
+        // Replies are matched in order, so a lost reply desynchronizes the
+        // stream; restart the server rather than guess.
+        this.stop();
+      }, timeoutMs);
+
+      this.pending.push(entry);
+      try {
+        this.process.stdin.write(line + "\n");
+        if (payload) this.process.stdin.write(payload);
+      } catch (error) {
+        this._handleExit(error);
+      }
+    });
+  }
+
+  /**
+   * Run a paste through the server. Resolves on OK, rejects with the same
+   * message shape as a failed one-shot exec on ERR. With clipboardText the
+   * helper serves CLIPBOARD itself; the text is sent length-framed after the
+   * command line and the promise resolves with { consumed, consumedMs }.
+   */
+  paste(args, clipboardText = null) {
+    if (clipboardText === null) {
+      return this._runCommand("PASTE", args);
+    }
+    const payload = Buffer.from(clipboardText, "utf8");
+    return this._runCommand("PASTE", ["--clipboard-bytes", String(payload.length), ...args], {
+      payload,
+      timeoutMs: CLIPBOARD_REQUEST_TIMEOUT_MS,
+    });
+  }
+
+  /**
+   * Type text instead of pasting it, leaving the clipboard alone. The text is
+   * sent length-framed after the command line; rejects with code 10 when it
+   * cannot be typed on the current layout.
+   */
+  type(args, text) {
+    const payload = Buffer.from(text, "utf8");
+    return this._runCommand("TYPE", ["--text-bytes", String(payload.length), ...args], {
+      payload,
+      timeoutMs: typingTimeoutMs(args, Array.from(text).length),
+      awaitLateReply: true,
+    });
+  }
+
+  /**
+   * Edit the text earlier revisions typed into `text` (REVISE): the helper
+   * backspaces past the common prefix and types the rest. begin starts a new
+   * stream, forgetting what was typed before.
+   */
+  revise(args, text, { begin = false } = {}) {
+    const payload = Buffer.from(text, "utf8");
+    const flags = ["--text-bytes", String(payload.length), ...args];
+    if (begin) flags.unshift("--begin");
+    // Erasing what the stream typed before counts too; the estimate may be high
+    const chars = Array.from(text).length;
+    const keys = (begin ? 0 : this._revisedChars) + chars;
+    this._revisedChars = chars;
+    return this._runCommand("REVISE", flags, {
+      payload,
+      timeoutMs: typingTimeoutMs(args, keys),
+      awaitLateReply: true,
+    });
+  }
+
+  /**
+   * Open a backend ahead of the first paste, e.g. ["--uinput"] registers the
+   * virtual keyboard so the first dictation does not wait for udev.
+   */
+  prepare(args) {
+    return this._runCommand("PREPARE", args);
+  }
+
+  /**
+   * Query the active X11 window; resolves with { id, class, instance, pid,
+   * exe, terminal } or null when there is none.
+   */
+  async queryActive() {
+    const reply = await this.request("QUERY");
+    if (reply !== "null" && !reply.startsWith("{")) return this._throwReplyError(reply);
+    return JSON.parse(reply);
+  }
+
+  /**
+   * Run the capability probe inside the server; resolves with the parsed
+   * JSON document that `linux-fast-paste --probe` prints.
+   */
+  async probe() {
+    const reply = await this.request("PROBE");
+    if (!reply.startsWith("{")) return this._throwReplyError(reply);
+    return JSON.parse(reply);
+  }
+
+  /**
+   * Set the Wayland clipboard through wlr-data-control. The server keeps
+   * serving the text until another client replaces the selection.
+   */
+  copy(text) {
+    const payload = Buffer.from(text, "utf8");
+    return this._runCommand("COPY", ["--clipboard-bytes", String(payload.length)], { payload });
+  }
+
+  /**
+   * Read the current Wayland clipboard as text; resolves with "" when it
+   * holds none.
+   */
+  async readClipboard() {
+    const reply = await this.request("READ");
+    if (reply === "EMPTY") return "";
+    const match = reply.match(/^DATA ([A-Za-z0-9+/=]*)$/);
+    if (match) return Buffer.from(match[1], "base64").toString("utf8");
+    return this._throwReplyError(reply);
+  }
+
+  async _runCommand(
+    verb,
+    args,
+    { payload = null, timeoutMs = REQUEST_TIMEOUT_MS, awaitLateReply = false } = {}
+  ) {
+    const reply = await this.request([verb, ...args].join(" "), timeoutMs, payload, awaitLateReply);
+    if (reply === "OK") return null;
+
+    const clipboardResult = LinuxFastPasteServer.parseClipboardResult(reply);
+    if (clipboardResult) return clipboardResult;
+
+    return this._throwReplyError(reply);
+  }
+
+  _throwReplyError(reply) {
+    const match = reply.match(/^ERR (\d+)\s*(.*)$/);
+    const error = new Error(
+      match
+        ? `linux-fast-paste exited with code ${match[1]}: ${match[2]}`
+        : `linux-fast-paste unexpected reply: ${reply}`
+    );
+    error.code = match ? Number(match[1]) : null;
+    error.fromServer = true;
+    throw error;
+  }
+
+  /**
+   * Parses the "CONSUMED <ms>" / "TIMEOUT" line a clipboard-owner paste
+   * reports, in serve mode and on one-shot stdout alike.
+   */
+  static parseClipboardResult(line) {
+    const match = line.trim().match(/^CONSUMED (\d+)$/);
+    if (match) return { consumed: true, consumedMs: Number(match[1]) };
+    if (line.trim() === "TIMEOUT") return { consumed: false, consumedMs: null };
+    return null;
+  }
+
+  /**
+   * Forwards the "trace {...}" lines a --trace paste prints on stderr to
+   * debugLogger as flat records of per-phase microsecond timestamps, and
+   * returns the rest of the text. Given the monotonic time the helper was
+   * spawned at, the record also carries startup_us (spawn to main()).
+   */
+  static forwardTraceLines(text, mode, spawnedAtUs = null) {
+    const rest = [];
+    for (const line of text.split(/\r?\n/)) {
+      const match = line.match(/^trace (\{.*\})$/);
+      let record = null;
+      try {
+        record = match ? JSON.parse(match[1]) : null;
+      } catch {}
+      if (!record) {
+        rest.push(line);
+        continue;
+      }
+      record.mode = mode;
+      if (spawnedAtUs !== null) record.startup_us = record.t0_us - spawnedAtUs;
+      debugLogger.debug("linux-fast-paste trace", record, "clipboard");
+    }
+    return rest.join("\n").trim();
+  }
+
+  _handleStderrChunk(chunk) {
+    this._stderrBuffer += chunk;
+    const end = this._stderrBuffer.lastIndexOf("\n");
+    if (end === -1) return;
+    const complete = this._stderrBuffer.slice(0, end);
+    this._stderrBuffer = this._stderrBuffer.slice(end + 1);
+
+    const rest = LinuxFastPasteServer.forwardTraceLines(complete, "serve");
+    if (rest) debugLogger.debug("[LinuxFastPasteServer] stderr", { data: rest }, "clipboard");
+  }
+
+  _handleStdoutChunk(chunk) {
+    this._stdoutBuffer += chunk;
+    const lines = this._stdoutBuffer.split(/\r?\n/);
+    this._stdoutBuffer = lines.pop() || "";
+
+    for (const rawLine of lines) {
+      const line = rawLine.trim();
+      if (!line) continue;
+      if (line === "READY") {
+        debugLogger.debug("[LinuxFastPasteServer] Ready", {}, "clipboard");
+        continue;
+      }
+
+      const entry = this.pending.shift();
+      if (!entry) {
+        debugLogger.debug("[LinuxFastPasteServer] Unsolicited output", { line }, "clipboard");
+        continue;
+      }
+      clearTimeout(entry.timeoutId);
+      entry.resolve(line);
+    }
+  }
+
+  _handleExit(error) {
+    this.process = null;
+    this._stdoutBuffer = "";
+    this._stderrBuffer = "";
+    const pending = this.pending;
+    this.pending = [];
+    for (const entry of pending) {
+      clearTimeout(entry.timeoutId);
+      entry.reject(error);
+    }
+  }
+}
+
+module.exports = LinuxFastPasteServer;
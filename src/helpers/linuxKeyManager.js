@@ -0,0 +1,233 @@
+/**
+ * LinuxKeyManager - Handles key up/down detection for Push-to-Talk on Linux
+ *
+ * Runs the native linux-key-listener, which reports the hotkey's presses and
+ * releases from XInput2 raw key events on X11, or with --evdev from the
+ * kernel's input devices on Wayland. Electron's globalShortcut and the GNOME
+ * shortcut bridge only see presses, so this is what makes Push-to-Talk work.
+ */
+
+const { spawn } = require("child_process");
+const path = require("path");
+const EventEmitter = require("events");
+const fs = require("fs");
+const debugLogger = require("./debugLogger");
+
+const INPUT_DIR = "/dev/input";
+
+/**
+ * Picks the listener backend: XInput2 when an X server sees global key events,
+ * evdev on Wayland when the user can read the input devices (input group).
+ * Returns null when neither works.
+ */
+function detectLinuxKeyBackend() {
+  if (process.platform !== "linux") return null;
+  if (process.env.XDG_SESSION_TYPE !== "wayland" && process.env.DISPLAY) return "xinput";
+
+  let devices;
+  try {
+    devices = fs.readdirSync(INPUT_DIR).filter((name) => name.startsWith("event"));
+  } catch {
+    return null;
+  }
+  const readable = devices.some((name) => {
+    try {
+      fs.accessSync(path.join(INPUT_DIR, name), fs.constants.R_OK);
+      return true;
+    } catch {
+      return false;
+    }
+  });
+  return readable ? "evdev" : null;
+}
+
+class LinuxKeyManager extends EventEmitter {
+  constructor() {
+    super();
+    this.process = null;
+    this.backend = detectLinuxKeyBackend();
+    this.isSupported = this.backend !== null;
+    this.hasReportedError = false;
+    this.currentKey = null;
+    this.isReady = false;
+  }
+
+  /**
+   * Start listening for the specified key
+   * @param {string} key - The key to listen for (e.g., "`", "F8", "RightControl", "Control+Super")
+   */
+  start(key = "`") {
+    if (!this.isSupported) {
+      return;
+    }
+
+    if (this.process && this.currentKey === key) {
+      return;
+    }
+
+    this.stop();
+
+    const listenerPath = this.resolveListenerBinary();
+    if (!listenerPath) {
+      this.emit("unavailable", new Error("Linux key listener binary not found"));
+      return;
+    }
+
+    this.hasReportedError = false;
+    this.isReady = false;
+    this.currentKey = key;
+
+    debugLogger.debug("[LinuxKeyManager] Starting key listener", {
+      key,
+      backend: this.backend,
+      binaryPath: listenerPath,
+    });
+
+    const args = this.backend === "evdev" ? ["--evdev", key] : [key];
+    let proc;
+    try {
+      proc = spawn(listenerPath, args, { stdio: ["ignore", "pipe", "pipe"] });
+    } catch (error) {
+      debugLogger.error("[LinuxKeyManager] Failed to spawn process", { error: error.message });
+      this.reportError(error);
+      return;
+    }
+    this.process = proc;
+
+    let buffer = "";
+    proc.stdout.setEncoding("utf8");
+    proc.stdout.on("data", (chunk) => {
+      buffer += chunk;
+      const lines = buffer.split("\n");
+      buffer = lines.pop();
+      for (const line of lines.map((l) => l.trim()).filter(Boolean)) {
+        if (line === "READY") {
+          debugLogger.debug("[LinuxKeyManager] Listener ready", { key });
+          this.isReady = true;
+          this.emit("ready");
+        } else if (line === "KEY_DOWN") {
+          debugLogger.debug("[LinuxKeyManager] KEY_DOWN detected", { key });
+          this.emit("key-down", key);
+        } else if (line === "KEY_UP") {
+          debugLogger.debug("[LinuxKeyManager] KEY_UP detected", { key });
+          this.emit("key-up", key);
+        } else {
+          debugLogger.debug("[LinuxKeyManager] Unknown output", { line });
+        }
+      }
+    });
+
+    proc.stderr.setEncoding("utf8");
+    proc.stderr.on("data", (data) => {
+      const message = data.toString().trim();
+      if (message.length > 0) {
+        debugLogger.debug("[LinuxKeyManager] Native stderr", { message });
+      }
+    });
+
+    proc.on("error", (error) => {
+      if (this.process !== proc) return;
+      this.reportError(error);
+      this.process = null;
+    });
+
+    proc.on("exit", (code, signal) => {
+      // A listener replaced by start() or stop() exits by our own SIGTERM
+      if (this.process !== proc) return;
+      this.process = null;
+      this.isReady = false;
+      if (code !== 0) {
+        const error = new Error(
+          `Linux key listener exited with code ${code ?? "null"} signal ${signal ?? "null"}`
+        );
+        this.reportError(error);
+      }
+    });
+  }
+
+  /**
+   * Stop the key listener
+   */
+  stop() {
+    if (this.process) {
+      debugLogger.debug("[LinuxKeyManager] Stopping key listener");
+      const proc = this.process;
+      this.process = null;
+      try {
+        proc.kill();
+      } catch {
+        // Ignore kill errors
+      }
+    }
+    this.isReady = false;
+    this.currentKey = null;
+  }
+
+  /**
+   * Check if the listener is available
+   */
+  isAvailable() {
+    return this.isSupported && this.resolveListenerBinary() !== null;
+  }
+
+  /**
+   * Report an error (only once per session to avoid log spam)
+   */
+  reportError(error) {
+    if (this.hasReportedError) {
+      return;
+    }
+    this.hasReportedError = true;
+
+    if (this.process) {
+      const proc = this.process;
+      this.process = null;
+      try {
+        proc.kill();
+      } catch {
+        // Ignore
+      }
+    }
+
+    debugLogger.warn("[LinuxKeyManager] Error occurred", { error: error.message });
+    this.emit("error", error);
+  }
+
+  /**
+   * Find the listener binary in various possible locations
+   */
+  resolveListenerBinary() {
+    const binaryName = "linux-key-listener";
+    const candidates = new Set([
+      path.join(__dirname, "..", "..", "resources", "bin", binaryName),
+      path.join(__dirname, "..", "..", "resources", binaryName),
+    ]);
+
+    if (process.resourcesPath) {
+      [
+        path.join(process.resourcesPath, binaryName),
+        path.join(process.resourcesPath, "bin", binaryName),
+        path.join(process.resourcesPath, "resources", binaryName),
+        path.join(process.resourcesPath, "resources", "bin", binaryName),
+        path.join(process.resourcesPath, "app.asar.unpacked", "resources", binaryName),
+        path.join(process.resourcesPath, "app.asar.unpacked", "resources", "bin", binaryName),
+      ].forEach((candidate) => candidates.add(candidate));
+    }
+
+    for (const candidate of candidates) {
+      try {
+        const stats = fs.statSync(candidate);
+        if (stats.isFile()) {
+          return candidate;
+        }
+      } catch {
+        continue;
+      }
+    }
+
+    return null;
+  }
+}
+
+module.exports = LinuxKeyManager;
+module.exports.detectLinuxKeyBackend = detectLinuxKeyBackend;
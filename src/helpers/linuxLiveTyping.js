@@ -0,0 +1,198 @@
+/**
+ * LinuxLiveTyping - Types streaming transcripts into the target app as they arrive
+ *
+ * Every partial or final result from the streaming providers becomes a REVISE
+ * of the whole transcript so far, which linux-fast-paste turns into the
+ * minimal backspace-plus-insert edit against what it has already typed. One
+ * revision is in flight at a time and the newest target replaces any that
+ * queued up behind it, so a burst of partials costs a single edit.
+ *
+ * Opt in with LIVE_TYPING_ENABLED=true. When the session ends, the final paste
+ * is reconciled against the typed text instead of pasting it a second time.
+ * A session that no paste reconciles (a failed stream, a cancelled or empty
+ * dictation) is erased.
+ */
+
+const debugLogger = require("./debugLogger");
+
+// The final transcript is applied as one more revision only if the edit stays
+// this small; a larger rewrite (e.g. after AI processing) is erased and pasted
+const MAX_FINAL_INSERT_CHARS = 200;
+// How long a stopped session waits for its final paste before it is erased
+const FINISH_GRACE_MS = 15000;
+
+const commonPrefixLength = (a, b) => {
+  let i = 0;
+  while (i < a.length && i < b.length && a[i] === b[i]) i++;
+  return i;
+};
+
+class LinuxLiveTyping {
+  constructor(clipboardManager) {
+    this.clipboardManager = clipboardManager;
+    this.session = null;
+  }
+
+  isEnabled() {
+    return process.platform === "linux" && process.env.LIVE_TYPING_ENABLED === "true";
+  }
+
+  /**
+   * Starts a live typing session for a streaming dictation. The target is
+   * whatever has focus now, unless that is our own panel; on X11 every
+   * revision re-targets that window so edits never land in another app.
+   */
+  async begin({ panelFocused = false } = {}) {
+    await this.abort();
+    if (!this.isEnabled() || panelFocused) return;
+
+    const server = this.clipboardManager._getLinuxFastPasteServer();
+    if (!server || !(server.isRunning() || server.start())) return;
+
+    let args;
+    if (this.clipboardManager._isWayland()) {
+      if (!this.clipboardManager.waylandVirtualKeyboardUnsupported) {
+        args = ["--wayland"];
+      } else if (this.clipboardManager._canAccessUinput()) {
+        args = ["--uinput"];
+      } else {
+        return;
+      }
+    } else {
+      const activeWindow = await this.clipboardManager._queryLinuxActiveWindow();
+      if (!activeWindow || activeWindow.pid === process.pid) return;
+      args = ["--window", String(activeWindow.id)];
+    }
+    if (debugLogger.isEnabled()) args.push("--trace");
+
+    this.session = {
+      server,
+      args,
+      finalText: "",
+      partialText: "",
+      typed: "",
+      begun: false,
+      failed: false,
+      ended: false,
+      graceTimer: null,
+      pending: null,
+      pumping: null,
+    };
+    debugLogger.debug("Live typing session started", { args }, "clipboard");
+  }
+
+  onPartial(text) {
+    if (!this.session || this.session.ended) return;
+    this.session.partialText = text.trim();
+    this._schedule(this.session);
+  }
+
+  // text is the accumulated final transcript, which supersedes the partial
+  onFinal(text) {
+    if (!this.session || this.session.ended) return;
+    this.session.finalText = text.trim();
+    this.session.partialText = "";
+    this._schedule(this.session);
+  }
+
+  /**
+   * Ends the session and brings the typed text to the final transcript.
+   * Resolves true when the target app now holds exactly `text`; otherwise
+   * whatever was typed has been erased and the caller should paste as usual.
+   */
+  async finish(text) {
+    const session = this.session;
+    this.session = null;
+    if (!session) return false;
+
+    clearTimeout(session.graceTimer);
+    session.pending = null;
+    await session.pumping;
+    if (!session.begun) return false;
+
+    const insertChars = text.length - commonPrefixLength(session.typed, text);
+    const typeable =
+      !session.failed &&
+      insertChars <= MAX_FINAL_INSERT_CHARS &&
+      // eslint-disable-next-line no-control-regex
+      !/[\u0000-\u001f\u007f]/.test(text);
+    const target = typeable ? text : "";
+
+    try {
+      await session.server.revise(session.args, target);
+    } catch (error) {
+      debugLogger.warn("Live typing final revision failed", { error: error?.message }, "clipboard");
+      return false;
+    }
+    debugLogger.debug(
+      "Live typing session finished",
+      { typedFinal: typeable, textLength: text.length },
+      "clipboard"
+    );
+    return typeable;
+  }
+
+  /**
+   * Called when the stream stops: no more transcripts are typed, and the
+   * session waits for the final paste to finish() it. If none arrives within
+   * FINISH_GRACE_MS the dictation produced nothing to paste, so it is erased.
+   */
+  end() {
+    const session = this.session;
+    if (!session || session.ended) return;
+    session.ended = true;
+    session.graceTimer = setTimeout(() => {
+      if (this.session !== session) return;
+      debugLogger.debug("Live typing session not pasted, erasing it", {}, "clipboard");
+      this.abort();
+    }, FINISH_GRACE_MS);
+  }
+
+  /** Ends the session without a final paste, erasing whatever was typed */
+  async abort() {
+    const session = this.session;
+    this.session = null;
+    if (!session) return;
+
+    clearTimeout(session.graceTimer);
+    session.pending = null;
+    await session.pumping;
+    if (!session.begun) return;
+
+    try {
+      await session.server.revise(session.args, "");
+    } catch (error) {
+      debugLogger.warn("Live typing erase failed", { error: error?.message }, "clipboard");
+    }
+  }
+
+  _schedule(session) {
+    if (session.failed) return;
+    session.pending = [session.finalText, session.partialText].filter(Boolean).join(" ");
+    if (!session.pumping) {
+      session.pumping = this._pump(session).finally(() => {
+        session.pumping = null;
+      });
+    }
+  }
+
+  async _pump(session) {
+    while (session.pending !== null && !session.failed) {
+      const target = session.pending;
+      session.pending = null;
+      if (session.begun && target === session.typed) continue;
+
+      try {
+        await session.server.revise(session.args, target, { begin: !session.begun });
+        session.begun = true;
+        session.typed = target;
+      } catch (error) {
+        // Typed text is left as is; finish() or abort() erases it
+        session.failed = true;
+        debugLogger.warn("Live typing revision failed", { error: error?.message }, "clipboard");
+      }
+    }
+  }
+}
+
+module.exports = LinuxLiveTyping;
@@ -3,6 +3,7 @@ const path = require("path");
 const EventEmitter = require("events");
 const fs = require("fs");
 const debugLogger = require("./debugLogger");
+const HelperOutputDecoder = require("./helperOutputDecoder");
 
 const POLL_INTERVAL_MS = 500;
 const INITIAL_QUERY_DELAY_MS = 500; // Wait for paste to settle in target app
@@ -51,8 +52,15 @@ class TextEditMonitor extends EventEmitter {
     this.timeout = null;
     this._pollInterval = null;
     this._lastValue = null;
-    this._stdoutBuffer = "";
+    // Field value as last reported, the base DELTA messages apply to
+    this._fieldValue = null;
     this.lastTargetPid = null;
+    // Resident `linux-text-monitor --daemon`, shared by every Linux session
+    this._linuxDaemon = null;
+    this._linuxDaemonReady = false;
+    this._linuxDaemonUnsupported = false;
+    this._linuxSession = null;
+    this._linuxSessionId = 0;
   }
 
   /**
@@ -105,7 +113,24 @@ class TextEditMonitor extends EventEmitter {
       return;
     }
 
-    const { command, args } = resolved;
+    const { command } = resolved;
+
+    if (process.platform === "linux" && command !== "python3" && !this._linuxDaemonUnsupported) {
+      this._startLinuxSession(command, originalText, timeoutMs, options);
+      return;
+    }
+
+    const args = [...resolved.args];
+    if (command !== "python3") {
+      // Raw length-prefixed values instead of base64; older binaries ignore the flag
+      args.push("--framing=binary");
+    }
+    if (process.platform === "linux" && command !== "python3") {
+      // Edits instead of full snapshots; older binaries ignore the flag and send CHANGED
+      args.push("--delta");
+      // The native Linux monitor searches the target app's accessibility tree first
+      if (options.targetPid) args.push(String(options.targetPid));
+    }
     debugLogger.debug("[TextEditMonitor] Resolved binary", { command, args });
 
     // For native binaries, verify executable permission
@@ -131,12 +156,7 @@ class TextEditMonitor extends EventEmitter {
     this.process.stdin.write(originalText + "\n");
     this.process.stdin.end();
 
-    this._stdoutBuffer = "";
-    this.process.stdout.setEncoding("utf8");
-    this.process.stdout.on("data", (chunk) => {
-      debugLogger.debug("[TextEditMonitor] stdout", { data: chunk.trim() });
-      this._handleProcessStdoutChunk(chunk);
-    });
+    this._watchProcessStdout(this.process);
 
     this.process.stderr.setEncoding("utf8");
     this.process.stderr.on("data", (data) => {
@@ -167,7 +187,13 @@ class TextEditMonitor extends EventEmitter {
       this._pollInterval = null;
     }
     this._lastValue = null;
-    this._stdoutBuffer = "";
+    this._fieldValue = null;
+    if (this._linuxSession) {
+      if (this._linuxDaemon?.stdin.writable) {
+        this._linuxDaemon.stdin.write(`STOP ${this._linuxSession.id}\n`);
+      }
+      this._linuxSession = null;
+    }
     if (this.process) {
       try {
         this.process.kill();
@@ -179,15 +205,131 @@ class TextEditMonitor extends EventEmitter {
     this.currentOriginalText = null;
   }
 
-  _handleProcessStdoutChunk(chunk) {
-    this._stdoutBuffer += chunk;
-    const lines = this._stdoutBuffer.split(/\r?\n/);
-    this._stdoutBuffer = lines.pop() || "";
+  /**
+   * Linux: monitor through the resident linux-text-monitor --daemon, which keeps
+   * its AT-SPI connection and application cache between pastes, so a session
+   * costs one START line instead of a spawn. Output lines and frames carry the
+   * session id; late ones from an earlier session are dropped.
+   */
+  _startLinuxSession(command, originalText, timeoutMs, options) {
+    const daemon = this._ensureLinuxDaemon(command);
+    if (!daemon) {
+      this.currentOriginalText = null;
+      return;
+    }
+
+    this._linuxSessionId += 1;
+    this._linuxSession = { id: this._linuxSessionId, originalText, timeoutMs, options };
+    const encoded = Buffer.from(originalText, "utf8").toString("base64");
+    const pid = options.targetPid ? ` ${options.targetPid}` : "";
+    debugLogger.debug("[TextEditMonitor] Starting daemon session", {
+      id: this._linuxSessionId,
+      textPreview: originalText.substring(0, 80),
+    });
+    daemon.stdin.write(`START ${this._linuxSessionId} ${encoded}${pid}\n`);
+
+    // Safety net timeout (the daemon also ends sessions after its own timeout)
+    this.timeout = setTimeout(() => this.stopMonitoring(), timeoutMs);
+  }
+
+  _ensureLinuxDaemon(command) {
+    if (this._linuxDaemon) return this._linuxDaemon;
+
+    let proc;
+    try {
+      proc = spawn(command, ["--daemon", "--delta", "--framing=binary"], {
+        stdio: ["pipe", "pipe", "pipe"],
+      });
+    } catch (err) {
+      debugLogger.debug("[TextEditMonitor] Daemon spawn failed", { error: err.message });
+      return null;
+    }
+    this._linuxDaemon = proc;
+    this._linuxDaemonReady = false;
+
+    const decoder = new HelperOutputDecoder({
+      onLine: (line) => this._handleDaemonLine(proc, line),
+      onFrame: (head, payload) => this._handleDaemonFrame(head, payload),
+    });
+    proc.stdout.on("data", (chunk) => decoder.push(chunk));
+
+    proc.stderr.setEncoding("utf8");
+    proc.stderr.on("data", (data) => {
+      debugLogger.debug("[TextEditMonitor] stderr", { data: data.trim() });
+    });
+
+    // Writes after the daemon died would otherwise throw EPIPE
+    proc.stdin.on("error", () => {});
+
+    const forget = () => {
+      if (this._linuxDaemon === proc) this._linuxDaemon = null;
+    };
+    proc.on("error", (err) => {
+      debugLogger.debug("[TextEditMonitor] Daemon error", { error: err.message });
+      forget();
+    });
+    proc.on("exit", (code, signal) => {
+      debugLogger.debug("[TextEditMonitor] Daemon exited", { code, signal });
+      forget();
+    });
+
+    return proc;
+  }
+
+  _handleDaemonLine(proc, line) {
+    if (line === "READY") {
+      this._linuxDaemonReady = true;
+      return;
+    }
+
+    const match = /^(\d+) (.*)$/.exec(line);
+    if (!match) {
+      // Binaries predating --daemon ignore it and monitor once, untagged
+      if (!this._linuxDaemonReady) this._fallBackFromLinuxDaemon(proc);
+      return;
+    }
+
+    if (Number(match[1]) !== this._linuxSession?.id) return;
+    debugLogger.debug("[TextEditMonitor] stdout", { data: line });
+    this._handleProcessLine(match[2]);
+  }
+
+  _handleDaemonFrame(head, payload) {
+    if (head === "READY") {
+      this._linuxDaemonReady = true;
+      return;
+    }
+
+    // Untagged frames come before READY, e.g. NO_ELEMENT when AT-SPI is unavailable
+    const match = /^(\d+) (.*)$/.exec(head);
+    if (match && Number(match[1]) !== this._linuxSession?.id) return;
+    if (!match && !this._linuxSession) return;
+    this._handleFrame(match ? match[2] : head, payload);
+  }
 
-    for (const rawLine of lines) {
-      if (!rawLine) continue;
-      this._handleProcessLine(rawLine);
+  _fallBackFromLinuxDaemon(proc) {
+    debugLogger.debug("[TextEditMonitor] No --daemon support, spawning a monitor per paste");
+    this._linuxDaemonUnsupported = true;
+    if (this._linuxDaemon === proc) this._linuxDaemon = null;
+    try {
+      proc.kill();
+    } catch {
+      // ignore
     }
+
+    const session = this._linuxSession;
+    if (session) this.startMonitoring(session.originalText, session.timeoutMs, session.options);
+  }
+
+  _watchProcessStdout(proc) {
+    const decoder = new HelperOutputDecoder({
+      onLine: (line) => {
+        debugLogger.debug("[TextEditMonitor] stdout", { data: line });
+        this._handleProcessLine(line);
+      },
+      onFrame: (type, payload) => this._handleFrame(type, payload),
+    });
+    proc.stdout.on("data", (chunk) => decoder.push(chunk));
   }
 
   _decodeBase64Payload(encoded) {
@@ -206,6 +348,7 @@ class TextEditMonitor extends EventEmitter {
       return;
     }
 
+    this._fieldValue = newFieldValue;
     debugLogger.debug("[TextEditMonitor] Text changed", {
       newFieldValue: newFieldValue.substring(0, 80),
     });
@@ -215,26 +358,72 @@ class TextEditMonitor extends EventEmitter {
     });
   }
 
-  _handleProcessLine(line) {
-    if (line.startsWith("CHANGED_B64:")) {
-      const decoded = this._decodeBase64Payload(line.slice("CHANGED_B64:".length));
-      if (decoded !== null) {
-        this._emitTextEdited(decoded);
-      }
+  /**
+   * Applies a DELTA edit, "<offset>:<deleted>:<inserted text>", to the last
+   * field value. Offsets are UTF-16 code units, so they index the JS string
+   * directly.
+   */
+  _applyDelta(edit) {
+    const match = /^(\d+):(\d+):/.exec(edit);
+    if (!match || this._fieldValue === null) {
+      debugLogger.debug("[TextEditMonitor] Dropping DELTA without a base value");
       return;
     }
 
-    if (line.startsWith("CHANGED:")) {
-      this._emitTextEdited(line.slice("CHANGED:".length));
+    const offset = Number(match[1]);
+    const deleted = Number(match[2]);
+    const inserted = edit.slice(match[0].length);
+    const value = this._fieldValue;
+    this._emitTextEdited(value.slice(0, offset) + inserted + value.slice(offset + deleted));
+  }
+
+  /** Handles one monitor message, whichever framing it arrived in */
+  _handleMessage(type, value) {
+    if (type === "DELTA") {
+      if (value !== null) this._applyDelta(value);
+      return;
+    }
+
+    if (type === "INITIAL_VALUE") {
+      this._fieldValue = value;
       return;
     }
 
-    if (line === "NO_ELEMENT" || line === "NO_VALUE") {
-      debugLogger.debug("[TextEditMonitor] No target element", { status: line });
+    if (type === "CHANGED") {
+      if (value !== null) this._emitTextEdited(value);
+      return;
+    }
+
+    if (type === "NO_ELEMENT" || type === "NO_VALUE") {
+      debugLogger.debug("[TextEditMonitor] No target element", { status: type });
       this.stopMonitoring();
     }
   }
 
+  _handleFrame(type, payload) {
+    debugLogger.debug("[TextEditMonitor] stdout frame", { type, bytes: payload.length });
+    this._handleMessage(type, payload.toString("utf8"));
+  }
+
+  /** Line protocol: "TYPE:<text>", "TYPE_B64:<base64>", DELTA:<o>:<d>:<base64> or a status */
+  _handleProcessLine(line) {
+    const delta = /^DELTA:(\d+:\d+:)(.*)$/.exec(line);
+    if (delta) {
+      const inserted = this._decodeBase64Payload(delta[2]);
+      this._handleMessage("DELTA", inserted === null ? null : delta[1] + inserted);
+      return;
+    }
+
+    const match = /^(INITIAL_VALUE|CHANGED)(_B64)?:(.*)$/s.exec(line);
+    if (match) {
+      const value = match[2] ? this._decodeBase64Payload(match[3]) : match[3];
+      this._handleMessage(match[1], value);
+      return;
+    }
+
+    this._handleMessage(line, null);
+  }
+
   /**
    * macOS: tell the target app that an assistive technology is present.
    * This causes Chromium/Electron apps to build their accessibility tree.
@@ -297,12 +486,7 @@ class TextEditMonitor extends EventEmitter {
     this.process.stdin.write(originalText + "\n");
     this.process.stdin.end();
 
-    this._stdoutBuffer = "";
-    this.process.stdout.setEncoding("utf8");
-    this.process.stdout.on("data", (chunk) => {
-      debugLogger.debug("[TextEditMonitor] stdout", { data: chunk.trim() });
-      this._handleProcessStdoutChunk(chunk);
-    });
+    this._watchProcessStdout(this.process);
 
     this.process.stderr.setEncoding("utf8");
     this.process.stderr.on("data", (data) => {
@@ -24,7 +24,7 @@ class WindowManager {
     this.isMainWindowInteractive = false;
     this.loadErrorShown = false;
     this.macCompoundPushState = null;
-    this.winPushState = null;
+    this.nativePushState = null;
     this._cachedActivationMode = "tap";
     this._floatingIconAutoHide = false;
 
@@ -176,6 +176,15 @@ class WindowManager {
         return;
       }
 
+      // Linux push mode: same, once the native listener is up (X11 or evdev)
+      if (
+        process.platform === "linux" &&
+        activationMode === "push" &&
+        this.linuxKeyManager?.isReady
+      ) {
+        return;
+      }
+
       const now = Date.now();
       if (now - lastToggleTime < DEBOUNCE_MS) {
         return;
@@ -321,8 +330,9 @@ class WindowManager {
     return required;
   }
 
-  startWindowsPushToTalk() {
-    if (this.winPushState?.active) {
+  // Push-to-talk driven by a native key listener's key-down/key-up (Windows, Linux)
+  startNativePushToTalk() {
+    if (this.nativePushState?.active) {
       return;
     }
 
@@ -331,31 +341,31 @@ class WindowManager {
 
     this.showDictationPanel();
 
-    this.winPushState = {
+    this.nativePushState = {
       active: true,
       downTime,
       isRecording: false,
     };
 
     setTimeout(() => {
-      if (!this.winPushState || this.winPushState.downTime !== downTime) {
+      if (!this.nativePushState || this.nativePushState.downTime !== downTime) {
         return;
       }
 
-      if (!this.winPushState.isRecording) {
-        this.winPushState.isRecording = true;
+      if (!this.nativePushState.isRecording) {
+        this.nativePushState.isRecording = true;
         this.sendStartDictation();
       }
     }, MIN_HOLD_DURATION_MS);
   }
 
-  handleWindowsPushKeyUp() {
-    if (!this.winPushState?.active) {
+  handleNativePushKeyUp() {
+    if (!this.nativePushState?.active) {
       return;
     }
 
-    const wasRecording = this.winPushState.isRecording;
-    this.winPushState = null;
+    const wasRecording = this.nativePushState.isRecording;
+    this.nativePushState = null;
 
     if (wasRecording) {
       this.sendStopDictation();
@@ -364,8 +374,8 @@ class WindowManager {
     }
   }
 
-  resetWindowsPushState() {
-    this.winPushState = null;
+  resetNativePushState() {
+    this.nativePushState = null;
   }
 
   sendStartDictation() {